@@ -3,6 +3,7 @@
 
 #define BUILDING_LIBFITYK
 #include "CMPfit.h"
+#include <algorithm>
 #include "logic.h"
 #include "var.h"
 
@@ -54,6 +55,41 @@ int MPfit::calculate(int /*m*/, int npar, double *par, double *deviates,
     return 0;
 }
 
+int MPfit::calculate_streamed(const double *par, double *deviates,
+                              const vector<int>* ifree, RowBlockQR *qr)
+{
+    if (mp_conf_.maxiter != MP_NO_ITER) {
+        int stop = on_iteration();
+        if (stop)
+            return -1;
+    }
+
+    vector<realt> A(par, par+na_);
+    if (F_->get_verbosity() >= 1)
+        output_tried_parameters(A);
+    if (qr == NULL)
+        compute_deviates(A, deviates);
+    else
+        compute_derivatives_qr(A, fitted_datas_, *ifree, qr);
+    return 0;
+}
+
+namespace {
+// passes calls from mpfit_streamed() to MPfit
+class StreamedCallback : public MPstreamFunc
+{
+public:
+    StreamedCallback(MPfit* mpfit) : mpfit_(mpfit) {}
+    virtual int deviates(const double *par, double *dev)
+        { return mpfit_->calculate_streamed(par, dev, NULL, NULL); }
+    virtual int jacobian(const double *par, const vector<int>& ifree,
+                         RowBlockQR *qr)
+        { return mpfit_->calculate_streamed(par, NULL, &ifree, qr); }
+private:
+    MPfit* mpfit_;
+};
+} // anonymous namespace
+
 static
 const char* mpstatus_to_string(int n)
 {
@@ -179,18 +215,34 @@ int MPfit::run_mpfit(const vector<Data*>& datas,
         }
 #endif
 
+    // MPFIT keeps the whole Jacobian (m x nfree) in memory. For large
+    // problems the streamed variant, which keeps only nfree x nfree
+    // triangular matrix, is used.
+    int m = count_points(datas);
+    int nfree = count(param_usage.begin(), param_usage.end(), true);
+    double jac_mb = double(m) * nfree * sizeof(double) / (1024. * 1024.);
+    bool streamed = (jac_mb > F_->get_settings()->mpfit_max_jacobian);
+#ifndef NDEBUG
+    if (debug_deriv_in_mpfit)
+        streamed = false;
+#endif
+
     // datas cannot be easily passed to the calculate_for_mpfit() callback
     // in a different way than through member variable (fitted_datas_).
-    int status;
-    if (&datas != &fitted_datas_) {
-        vector<Data*> saved = datas;
-        fitted_datas_.swap(saved);
-        status = mpfit(calculate_for_mpfit, count_points(datas),
-                       parameters.size(), a, pars, &mp_conf_, this, &result_);
+    vector<Data*> saved = datas;
+    bool swap_datas = (&datas != &fitted_datas_);
+    if (swap_datas)
         fitted_datas_.swap(saved);
+    int status;
+    if (streamed) {
+        StreamedCallback callback(this);
+        status = mpfit_streamed(&callback, m, parameters.size(), a, pars,
+                                &mp_conf_, &result_);
     } else
-        status = mpfit(calculate_for_mpfit, count_points(datas),
+        status = mpfit(calculate_for_mpfit, m,
                        parameters.size(), a, pars, &mp_conf_, this, &result_);
+    if (swap_datas)
+        fitted_datas_.swap(saved);
     soft_assert(status == result_.status);
     delete [] pars;
     if (final_a == NULL)
@@ -3,12 +3,15 @@
 
 /// wrapper around MPFIT (cmpfit) library,
 /// http://www.physics.wisc.edu/~craigm/idl/cmpfit.html
-/// which is Levenberg-Marquardt implementation based on MINPACK-1
+/// which is Levenberg-Marquardt implementation based on MINPACK-1.
+/// If the Jacobian would be too large (see option mpfit_max_jacobian),
+/// mpfit_streamed() from MPstream.h is used instead of mpfit().
 
 #ifndef FITYK_MPFIT_H_
 #define FITYK_MPFIT_H_
 #include "fit.h"
 #include "cmpfit/mpfit.h"
+#include "MPstream.h"
 
 namespace fityk {
 
@@ -22,6 +25,8 @@ public:
     // implementation (must be public to be called inside callback function)
     int calculate(int m, int npar, double *par, double *deviates,
                   double **derivs);
+    int calculate_streamed(const double *par, double *deviates,
+                           const std::vector<int>* ifree, RowBlockQR *qr);
     int on_iteration();
 
     virtual std::vector<double>
@@ -75,19 +75,23 @@ GAfit::~GAfit() {}
 
 double GAfit::run_method(std::vector<realt>* best_a)
 {
-    pop = &pop1;
-    opop = &pop2;
-    pop->resize (popsize);
-    vector<Individual>::iterator best = pop->begin();
-    for (vector<Individual>::iterator i = pop->begin(); i != pop->end(); ++i) {
-        i->g.resize(na_);
-        for (int j = 0; j < na_; ++j)
-            i->g[j] = draw_a_from_distribution(j);
-        compute_wssr_for_ind (i);
-        if (i->raw_score < best->raw_score)
-            best = i;
+    // when resuming, the population from the last run is used
+    if (!resuming_ || pop == NULL || size(*pop) != popsize) {
+        pop = &pop1;
+        opop = &pop2;
+        pop->resize (popsize);
+        vector<Individual>::iterator best = pop->begin();
+        for (vector<Individual>::iterator i = pop->begin(); i != pop->end();
+                                                                        ++i) {
+            i->g.resize(na_);
+            for (int j = 0; j < na_; ++j)
+                i->g[j] = draw_a_from_distribution(j);
+            compute_wssr_for_ind (i);
+            if (i->raw_score < best->raw_score)
+                best = i;
+        }
+        best_indiv = *best;
     }
-    best_indiv = *best;
 
     assert (pop && opop);
     if (elitism >= popsize) {
@@ -103,12 +107,12 @@ double GAfit::run_method(std::vector<realt>* best_a)
     }
 
     *best_a = best_indiv.g;
-    return best_indiv.raw_score;
+    return polish_screened(best_a, best_indiv.raw_score);
 }
 
 void GAfit::compute_wssr_for_ind (vector<Individual>::iterator ind)
 {
-    ind->raw_score = compute_wssr(ind->g, fitted_datas_);
+    ind->raw_score = compute_wssr_screening(ind->g);
 }
 
 void GAfit::autoplot_in_run()
@@ -25,6 +25,8 @@ public:
     GAfit(Full* F, const char* name);
     ~GAfit();
     virtual double run_method(std::vector<realt>* best_a);
+protected:
+    virtual bool can_resume() const { return true; }
 private:
     int popsize;
     int elitism; // = 0, 1, ... popsize
@@ -12,6 +12,8 @@
 #include "settings.h"
 #include "logic.h"
 #include "numfuncs.h"
+#include "mgr.h"
+#include "var.h"
 
 using namespace std;
 
@@ -24,10 +26,13 @@ double LMfit::run_method(std::vector<realt>* best_a)
     const realt stop_rel = F_->get_settings()->lm_stop_rel_change;
     const realt max_lambda = F_->get_settings()->lm_max_lambda;
 
-    double lambda = F_->get_settings()->lm_lambda_start;
+    // when resuming, alpha_ and beta_ were computed for a_orig_,
+    // unless stale_derivs_ is set
+    double lambda = resuming_ ? lambda_ : F_->get_settings()->lm_lambda_start;
     alpha_.resize(na_*na_);
     beta_.resize(na_);
     *best_a = a_orig_;
+    set_bounds();
 
     if (F_->get_verbosity() >= 2) {
         F_->ui()->mesg(format_matrix(a_orig_, 1, na_, "Initial A"));
@@ -38,7 +43,14 @@ double LMfit::run_method(std::vector<realt>* best_a)
     }
 
     realt chi2 = initial_wssr_;
-    compute_derivatives(a_orig_, fitted_datas_, alpha_, beta_);
+    bool moved = clip_to_bounds(*best_a);
+    if (moved) {
+        F_->msg("Initial parameters moved into their domains.");
+        chi2 = compute_wssr(*best_a, fitted_datas_);
+    }
+    if (!resuming_ || moved || stale_derivs_)
+        compute_derivatives(*best_a, fitted_datas_, alpha_, beta_);
+    stale_derivs_ = false;
 
     int small_change_counter = 0;
     for (int iter = 0; !common_termination_criteria(); iter++) {
@@ -57,6 +69,7 @@ double LMfit::run_method(std::vector<realt>* best_a)
             if (rel_change < stop_rel || chi2 == 0) {
                 small_change_counter++;
                 if (small_change_counter >= 2 || chi2 == 0) {
+                    stale_derivs_ = true;
                     F_->msg("... converged.");
                     break;
                 }
@@ -79,6 +92,7 @@ double LMfit::run_method(std::vector<realt>* best_a)
 
         iteration_plot(*best_a, chi2);
     }
+    lambda_ = lambda;
     return chi2;
 }
 
@@ -97,16 +111,110 @@ void LMfit::prepare_next_parameters(double lambda, const vector<realt> &a)
     }
 
     // Matrix solution (Ax=b)  temp_alpha_ * da == temp_beta_
-    jordan_solve(temp_alpha_, temp_beta_, na_);
+    if (lo_.empty())
+        jordan_solve(temp_alpha_, temp_beta_, na_);
+    else
+        solve_with_bounds(a);
 
     for (int i = 0; i < na_; i++)
         // put new a[] into temp_beta_[]
         temp_beta_[i] = a[i] + temp_beta_[i];
+    // da of parameters fixed at bounds is (bound - a), that can be rounded
+    clip_to_bounds(temp_beta_);
 
     if (F_->get_verbosity() >= 2)
         output_tried_parameters(temp_beta_);
 }
 
+// sets lo_ and hi_ from domains of fitted parameters
+void LMfit::set_bounds()
+{
+    lo_.clear();
+    hi_.clear();
+    if (!F_->get_settings()->box_constraints)
+        return;
+    bool has_bounds = false;
+    vector<realt> lo(na_, -HUGE_VAL), hi(na_, HUGE_VAL);
+    for (int i = 0; i < na_; ++i) {
+        if (!par_usage()[i])
+            continue;
+        const RealRange& d = F_->mgr.gpos_to_var(i)->domain;
+        if (!d.lo_inf() || !d.hi_inf()) {
+            lo[i] = d.lo;
+            hi[i] = d.hi;
+            has_bounds = true;
+        }
+    }
+    if (has_bounds) {
+        lo_.swap(lo);
+        hi_.swap(hi);
+    }
+}
+
+// moves parameters that are outside of bounds to the bounds,
+// returns true if any parameter was changed
+bool LMfit::clip_to_bounds(vector<realt> &a) const
+{
+    bool changed = false;
+    for (size_t i = 0; i < lo_.size(); ++i) {
+        if (a[i] < lo_[i]) {
+            a[i] = lo_[i];
+            changed = true;
+        } else if (a[i] > hi_[i]) {
+            a[i] = hi_[i];
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Solves temp_alpha_ * da = temp_beta_ (result in temp_beta_) so that a + da
+// is within the bounds. Parameters at a bound with the step pointing outside,
+// and parameters that would cross a bound, are fixed at the bound (da is
+// known) and the system is solved again for the other parameters.
+// Each pass fixes at least one parameter, so there are at most na_+1 passes.
+void LMfit::solve_with_bounds(const vector<realt> &a)
+{
+    vector<bool> fixed(na_, false);
+    vector<realt> da(na_, 0.);
+    for (int i = 0; i < na_; ++i)
+        if ((a[i] <= lo_[i] && temp_beta_[i] < 0) ||
+                (a[i] >= hi_[i] && temp_beta_[i] > 0))
+            fixed[i] = true;
+    vector<realt> A, b;
+    for (;;) {
+        A = temp_alpha_;
+        b = temp_beta_;
+        for (int i = 0; i < na_; ++i) {
+            if (!fixed[i])
+                continue;
+            for (int j = 0; j < na_; ++j) {
+                b[j] -= A[na_*j+i] * da[i];
+                A[na_*j+i] = A[na_*i+j] = 0.;
+            }
+            A[na_*i+i] = 1.;
+            b[i] = da[i];
+        }
+        jordan_solve(A, b, na_);
+        bool inside = true;
+        for (int i = 0; i < na_; ++i) {
+            if (fixed[i])
+                continue;
+            if (a[i] + b[i] < lo_[i]) {
+                fixed[i] = true;
+                da[i] = lo_[i] - a[i];
+                inside = false;
+            } else if (a[i] + b[i] > hi_[i]) {
+                fixed[i] = true;
+                da[i] = hi_[i] - a[i];
+                inside = false;
+            }
+        }
+        if (inside)
+            break;
+    }
+    temp_beta_.swap(b);
+}
 
 vector<double> LMfit::get_covariance_matrix(const vector<Data*>& datas)
 {
@@ -3,6 +3,8 @@
 
 /// Simple implementation of the Levenberg-Marquardt method,
 /// uses Jordan elimination with partial pivoting.
+/// Domains of variables are honoured (if the box_constraints option is set)
+/// by fixing parameters at their bounds (active set) when solving for a step.
 
 #ifndef FITYK_LMFIT_H_
 #define FITYK_LMFIT_H_
@@ -15,7 +17,8 @@ namespace fityk {
 class LMfit : public Fit
 {
 public:
-    LMfit(Full* F, const char* fname) : Fit(F, fname) {}
+    LMfit(Full* F, const char* fname)
+        : Fit(F, fname), lambda_(0.), stale_derivs_(false) {}
     virtual double run_method(std::vector<realt>* best_a);
 
     // the same methods that were used for all methods up to ver. 1.2.1
@@ -25,14 +28,27 @@ public:
     virtual std::vector<double>
         get_standard_errors(const std::vector<Data*>& datas);
 
+protected:
+    virtual bool can_resume() const { return true; }
+
 private:
     std::vector<realt> alpha_; // matrix
     std::vector<realt> beta_;  // and vector
+    realt lambda_; // the last lambda, kept for resuming
+    // set if the last run stopped before alpha_ and beta_ were computed
+    // for the final parameters
+    bool stale_derivs_;
 
     // working arrays in do_iteration()
     std::vector<realt> temp_alpha_, temp_beta_;
 
+    // bounds of fitted parameters; empty if there are no constraints
+    std::vector<realt> lo_, hi_;
+
     void prepare_next_parameters(double lambda, const std::vector<realt> &a);
+    void set_bounds();
+    bool clip_to_bounds(std::vector<realt> &a) const;
+    void solve_with_bounds(const std::vector<realt> &a);
 };
 
 } // namespace fityk
@@ -0,0 +1,791 @@
+// This file is part of fityk program. Copyright 2001-2013 Marcin Wojdyr
+// Licence: GNU General Public License ver. 2+
+
+// The numerical part (qrfac, qrsolv, lmpar, covar and the main loop)
+// is translated from CMPFIT, which in turn is based on MINPACK-1.
+// Variable names and the order of operations are kept, so that both
+// implementations can be compared line by line.
+
+#define BUILDING_LIBFITYK
+#include "MPstream.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace std;
+
+namespace fityk {
+
+void RowBlockQR::clear()
+{
+    fill(r_.begin(), r_.end(), 0.);
+    fill(qtb_.begin(), qtb_.end(), 0.);
+}
+
+// For each column j, the Householder reflection with vector
+// v = (r_jj - alpha, a[0..nrows-1, j]) zeroes column j of the block.
+// Since the block has no other non-zero elements above the row j of R,
+// only row j of R and the block are changed.
+void RowBlockQR::add_rows(int nrows, double *a, double *b)
+{
+    for (int j = 0; j < n_; ++j) {
+        double *aj = a + j * nrows;
+        double s = 0.;
+        for (int i = 0; i < nrows; ++i)
+            s += aj[i] * aj[i];
+        if (s == 0.)
+            continue;
+        double& rjj = r_[j * n_ + j];
+        double norm = sqrt(rjj * rjj + s);
+        double alpha = (rjj > 0 ? -norm : norm);
+        double v0 = rjj - alpha;
+        // v^T v / 2 = norm * (norm + |r_jj|); dividing by norm and the sum
+        // separately avoids overflow when a column has only tiny values
+        double d = norm + fabs(rjj);
+        for (int k = j+1; k < n_; ++k) {
+            double *ak = a + k * nrows;
+            double& rjk = r_[k * n_ + j];
+            double t = v0 * rjk;
+            for (int i = 0; i < nrows; ++i)
+                t += aj[i] * ak[i];
+            t = t / norm / d;
+            rjk -= t * v0;
+            for (int i = 0; i < nrows; ++i)
+                ak[i] -= t * aj[i];
+        }
+        double t = v0 * qtb_[j];
+        for (int i = 0; i < nrows; ++i)
+            t += aj[i] * b[i];
+        t = t / norm / d;
+        qtb_[j] -= t * v0;
+        for (int i = 0; i < nrows; ++i)
+            b[i] -= t * aj[i];
+        rjj = alpha;
+    }
+}
+
+static
+double enorm(int n, const double *x)
+{
+    // scaled to avoid overflow and underflow, simpler than MINPACK's enorm
+    double xmax = 0.;
+    for (int i = 0; i < n; ++i) {
+        if (x[i] != x[i]) // NaN
+            return x[i];
+        xmax = max(xmax, fabs(x[i]));
+    }
+    if (xmax == 0. || !(xmax < HUGE_VAL))
+        return xmax;
+    double s = 0.;
+    for (int i = 0; i < n; ++i) {
+        double t = x[i] / xmax;
+        s += t * t;
+    }
+    return xmax * sqrt(s);
+}
+
+// QR factorization with column pivoting of square matrix a (n x n),
+// see mp_qrfac() in cmpfit/mpfit.c.
+static
+void qrfac(int n, double *a, int *ipvt,
+           double *rdiag, double *acnorm, double *wa)
+{
+    for (int j = 0; j < n; ++j) {
+        acnorm[j] = enorm(n, &a[n*j]);
+        rdiag[j] = acnorm[j];
+        wa[j] = rdiag[j];
+        ipvt[j] = j;
+    }
+    for (int j = 0; j < n; ++j) {
+        // bring the column of largest norm into the pivot position
+        int kmax = j;
+        for (int k = j; k < n; ++k)
+            if (rdiag[k] > rdiag[kmax])
+                kmax = k;
+        if (kmax != j) {
+            for (int i = 0; i < n; ++i)
+                swap(a[i+n*j], a[i+n*kmax]);
+            rdiag[kmax] = rdiag[j];
+            wa[kmax] = wa[j];
+            swap(ipvt[j], ipvt[kmax]);
+        }
+        // compute the Householder transformation to reduce the j-th column
+        // of a to a multiple of the j-th unit vector
+        double ajnorm = enorm(n-j, &a[j+n*j]);
+        if (ajnorm != 0.) {
+            if (a[j+n*j] < 0.)
+                ajnorm = -ajnorm;
+            for (int i = j; i < n; ++i)
+                a[i+n*j] /= ajnorm;
+            a[j+n*j] += 1.;
+            // apply the transformation to the remaining columns
+            // and update the norms
+            for (int k = j+1; k < n; ++k) {
+                double sum = 0.;
+                for (int i = j; i < n; ++i)
+                    sum += a[i+n*j] * a[i+n*k];
+                double temp = sum / a[j+n*j];
+                for (int i = j; i < n; ++i)
+                    a[i+n*k] -= temp * a[i+n*j];
+                if (rdiag[k] != 0.) {
+                    temp = a[j+n*k] / rdiag[k];
+                    rdiag[k] *= sqrt(max(0., 1. - temp*temp));
+                    temp = rdiag[k] / wa[k];
+                    if (0.05 * temp * temp <= MP_MACHEP0) {
+                        rdiag[k] = enorm(n-j-1, &a[j+1+n*k]);
+                        wa[k] = rdiag[k];
+                    }
+                }
+            }
+        }
+        rdiag[j] = -ajnorm;
+    }
+}
+
+// see mp_qrsolv() in cmpfit/mpfit.c
+static
+void qrsolv(int n, double *r, const int *ipvt, const double *diag,
+            const double *qtb, double *x, double *sdiag, double *wa)
+{
+    // copy r and (q transpose)*b to preserve input and initialize s
+    for (int j = 0; j < n; ++j) {
+        for (int i = j; i < n; ++i)
+            r[i+n*j] = r[j+n*i];
+        x[j] = r[j+n*j];
+        wa[j] = qtb[j];
+    }
+    // eliminate the diagonal matrix d using a Givens rotation
+    for (int j = 0; j < n; ++j) {
+        int l = ipvt[j];
+        if (diag[l] != 0.) {
+            for (int k = j; k < n; ++k)
+                sdiag[k] = 0.;
+            sdiag[j] = diag[l];
+            double qtbpj = 0.;
+            for (int k = j; k < n; ++k) {
+                if (sdiag[k] == 0.)
+                    continue;
+                double& rkk = r[k+n*k];
+                double cosx, sinx;
+                if (fabs(rkk) < fabs(sdiag[k])) {
+                    double cotan = rkk / sdiag[k];
+                    sinx = 0.5 / sqrt(0.25 + 0.25*cotan*cotan);
+                    cosx = sinx * cotan;
+                } else {
+                    double tanx = sdiag[k] / rkk;
+                    cosx = 0.5 / sqrt(0.25 + 0.25*tanx*tanx);
+                    sinx = cosx * tanx;
+                }
+                rkk = cosx * rkk + sinx * sdiag[k];
+                double temp = cosx * wa[k] + sinx * qtbpj;
+                qtbpj = -sinx * wa[k] + cosx * qtbpj;
+                wa[k] = temp;
+                for (int i = k+1; i < n; ++i) {
+                    temp = cosx * r[i+n*k] + sinx * sdiag[i];
+                    sdiag[i] = -sinx * r[i+n*k] + cosx * sdiag[i];
+                    r[i+n*k] = temp;
+                }
+            }
+        }
+        sdiag[j] = r[j+n*j];
+        r[j+n*j] = x[j];
+    }
+    // solve the triangular system; if it is singular,
+    // obtain a least squares solution
+    int nsing = n;
+    for (int j = 0; j < n; ++j) {
+        if (sdiag[j] == 0. && nsing == n)
+            nsing = j;
+        if (nsing < n)
+            wa[j] = 0.;
+    }
+    for (int j = nsing-1; j >= 0; --j) {
+        double sum = 0.;
+        for (int i = j+1; i < nsing; ++i)
+            sum += r[i+n*j] * wa[i];
+        wa[j] = (wa[j] - sum) / sdiag[j];
+    }
+    for (int j = 0; j < n; ++j)
+        x[ipvt[j]] = wa[j];
+}
+
+// see mp_lmpar() in cmpfit/mpfit.c
+static
+void lmpar(int n, double *r, const int *ipvt, const int *ifree,
+           const double *diag, const double *qtb, double delta, double *par,
+           double *x, double *sdiag, double *wa1, double *wa2)
+{
+    // compute and store in x the Gauss-Newton direction
+    int nsing = n;
+    for (int j = 0; j < n; ++j) {
+        wa1[j] = qtb[j];
+        if (r[j+n*j] == 0. && nsing == n)
+            nsing = j;
+        if (nsing < n)
+            wa1[j] = 0.;
+    }
+    for (int j = nsing-1; j >= 0; --j) {
+        wa1[j] /= r[j+n*j];
+        double temp = wa1[j];
+        for (int i = 0; i < j; ++i)
+            wa1[i] -= r[i+n*j] * temp;
+    }
+    for (int j = 0; j < n; ++j)
+        x[ipvt[j]] = wa1[j];
+
+    // evaluate the function at the origin, and test
+    // for acceptance of the Gauss-Newton direction
+    int iter = 0;
+    for (int j = 0; j < n; ++j)
+        wa2[j] = diag[ifree[j]] * x[j];
+    double dxnorm = enorm(n, wa2);
+    double fp = dxnorm - delta;
+    if (fp <= 0.1 * delta) {
+        *par = 0.;
+        return;
+    }
+
+    // lower bound, parl, for the zero of the function
+    double parl = 0.;
+    if (nsing >= n) {
+        for (int j = 0; j < n; ++j) {
+            int l = ipvt[j];
+            wa1[j] = diag[ifree[l]] * (wa2[l] / dxnorm);
+        }
+        for (int j = 0; j < n; ++j) {
+            double sum = 0.;
+            for (int i = 0; i < j; ++i)
+                sum += r[i+n*j] * wa1[i];
+            wa1[j] = (wa1[j] - sum) / r[j+n*j];
+        }
+        double temp = enorm(n, wa1);
+        parl = ((fp / delta) / temp) / temp;
+    }
+
+    // upper bound, paru, for the zero of the function
+    for (int j = 0; j < n; ++j) {
+        double sum = 0.;
+        for (int i = 0; i <= j; ++i)
+            sum += r[i+n*j] * qtb[i];
+        wa1[j] = sum / diag[ifree[ipvt[j]]];
+    }
+    double gnorm = enorm(n, wa1);
+    double paru = gnorm / delta;
+    if (paru == 0.)
+        paru = MP_DWARF / min(delta, 0.1);
+
+    // if the input par lies outside of the interval (parl,paru),
+    // set par to the closer endpoint
+    *par = max(*par, parl);
+    *par = min(*par, paru);
+    if (*par == 0.)
+        *par = gnorm / dxnorm;
+
+    for (;;) {
+        ++iter;
+        // evaluate the function at the current value of par
+        if (*par == 0.)
+            *par = max(MP_DWARF, 0.001 * paru);
+        double temp = sqrt(*par);
+        for (int j = 0; j < n; ++j)
+            wa1[j] = temp * diag[ifree[j]];
+        qrsolv(n, r, ipvt, wa1, qtb, x, sdiag, wa2);
+        for (int j = 0; j < n; ++j)
+            wa2[j] = diag[ifree[j]] * x[j];
+        dxnorm = enorm(n, wa2);
+        temp = fp;
+        fp = dxnorm - delta;
+
+        // if the function is small enough, accept the current value of par
+        if (fabs(fp) <= 0.1 * delta
+                || (parl == 0. && fp <= temp && temp < 0.)
+                || iter == 10)
+            break;
+
+        // compute the Newton correction
+        for (int j = 0; j < n; ++j) {
+            int l = ipvt[j];
+            wa1[j] = diag[ifree[l]] * (wa2[l] / dxnorm);
+        }
+        for (int j = 0; j < n; ++j) {
+            wa1[j] /= sdiag[j];
+            temp = wa1[j];
+            for (int i = j+1; i < n; ++i)
+                wa1[i] -= r[i+n*j] * temp;
+        }
+        temp = enorm(n, wa1);
+        double parc = ((fp / delta) / temp) / temp;
+
+        // depending on the sign of the function, update parl or paru
+        if (fp > 0.)
+            parl = max(parl, *par);
+        if (fp < 0.)
+            paru = min(paru, *par);
+        // compute an improved estimate for par
+        *par = max(parl, *par + parc);
+    }
+}
+
+// see mp_covar() in cmpfit/mpfit.c
+static
+void covar(int n, double *r, const int *ipvt, double tol, double *wa)
+{
+    // form the inverse of r in the full upper triangle of r
+    double tolr = tol * fabs(r[0]);
+    int l = -1;
+    for (int k = 0; k < n; ++k) {
+        int kk = k*n + k;
+        if (fabs(r[kk]) <= tolr)
+            break;
+        r[kk] = 1. / r[kk];
+        for (int j = 0; j < k; ++j) {
+            double temp = r[kk] * r[k*n+j];
+            r[k*n+j] = 0.;
+            for (int i = 0; i <= j; ++i)
+                r[k*n+i] -= temp * r[j*n+i];
+        }
+        l = k;
+    }
+
+    // form the full upper triangle of the inverse of (r transpose)*r
+    // in the full upper triangle of r
+    for (int k = 0; k <= l; ++k) {
+        for (int j = 0; j < k; ++j) {
+            double temp = r[k*n+j];
+            for (int i = 0; i <= j; ++i)
+                r[j*n+i] += temp * r[k*n+i];
+        }
+        double temp = r[k*n+k];
+        for (int i = 0; i <= k; ++i)
+            r[k*n+i] *= temp;
+    }
+
+    // form the full lower triangle of the covariance matrix
+    // in the strict lower triangle of r and in wa
+    for (int j = 0; j < n; ++j) {
+        int jj = ipvt[j];
+        bool sing = (j > l);
+        for (int i = 0; i <= j; ++i) {
+            int ji = j*n + i;
+            if (sing)
+                r[ji] = 0.;
+            int ii = ipvt[i];
+            if (ii > jj)
+                r[jj*n+ii] = r[ji];
+            if (ii < jj)
+                r[ii*n+jj] = r[ji];
+        }
+        wa[jj] = r[j*n+j];
+    }
+
+    // symmetrize the covariance matrix in r
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i < j; ++i)
+            r[j*n+i] = r[i*n+j];
+        r[j*n+j] = wa[j];
+    }
+}
+
+int mpfit_streamed(MPstreamFunc *funct, int m, int npar, double *xall,
+                   mp_par *pars, mp_config *config, mp_result *result)
+{
+    const double p1 = 0.1, p5 = 0.5, p25 = 0.25, p75 = 0.75, p0001 = 1.0e-4;
+
+    // default configuration, as in mpfit()
+    mp_config conf;
+    conf.ftol = 1e-10;
+    conf.xtol = 1e-10;
+    conf.gtol = 1e-10;
+    conf.stepfactor = 100.0;
+    conf.nprint = 1;
+    conf.maxiter = 200;
+    conf.douserscale = 0;
+    conf.maxfev = 0;
+    conf.covtol = 1e-14;
+    conf.nofinitecheck = 0;
+    if (config) {
+        if (config->ftol > 0) conf.ftol = config->ftol;
+        if (config->xtol > 0) conf.xtol = config->xtol;
+        if (config->gtol > 0) conf.gtol = config->gtol;
+        if (config->stepfactor > 0) conf.stepfactor = config->stepfactor;
+        if (config->nprint >= 0) conf.nprint = config->nprint;
+        if (config->maxiter > 0) conf.maxiter = config->maxiter;
+        if (config->maxiter == MP_NO_ITER) conf.maxiter = 0;
+        if (config->douserscale != 0) conf.douserscale = config->douserscale;
+        if (config->covtol > 0) conf.covtol = config->covtol;
+        if (config->nofinitecheck > 0)
+            conf.nofinitecheck = config->nofinitecheck;
+        conf.maxfev = config->maxfev;
+    }
+
+    if (funct == NULL)
+        return MP_ERR_FUNC;
+    if (m <= 0 || xall == NULL)
+        return MP_ERR_NPOINTS;
+    if (npar <= 0)
+        return MP_ERR_NFREE;
+
+    vector<int> ifree;
+    for (int i = 0; i < npar; ++i)
+        if (pars == NULL || !pars[i].fixed)
+            ifree.push_back(i);
+    const int nfree = ifree.size();
+    if (nfree == 0)
+        return MP_ERR_NFREE;
+
+    bool qanylim = false;
+    vector<int> qllim(nfree, 0), qulim(nfree, 0);
+    vector<double> llim(nfree, 0.), ulim(nfree, 0.);
+    if (pars) {
+        for (int i = 0; i < npar; ++i) {
+            if ((pars[i].limited[0] && xall[i] < pars[i].limits[0]) ||
+                    (pars[i].limited[1] && xall[i] > pars[i].limits[1]))
+                return MP_ERR_INITBOUNDS;
+            if (!pars[i].fixed && pars[i].limited[0] && pars[i].limited[1]
+                    && pars[i].limits[0] >= pars[i].limits[1])
+                return MP_ERR_BOUNDS;
+        }
+        for (int i = 0; i < nfree; ++i) {
+            const mp_par& p = pars[ifree[i]];
+            qllim[i] = p.limited[0];
+            qulim[i] = p.limited[1];
+            llim[i] = p.limits[0];
+            ulim[i] = p.limits[1];
+            if (qllim[i] || qulim[i])
+                qanylim = true;
+        }
+    }
+
+    if (conf.ftol <= 0 || conf.xtol <= 0 || conf.gtol <= 0 ||
+            conf.maxiter < 0 || conf.stepfactor <= 0)
+        return MP_ERR_PARAM;
+    if (m < nfree)
+        return MP_ERR_DOF;
+
+    // fjac is here only the nfree x nfree triangular factor
+    vector<double> dev(m), qtf(nfree, 0.), x(nfree), xnew(xall, xall+npar),
+                   fjac(nfree*nfree), diag(npar, 0.), wa1(npar), wa2(npar),
+                   wa3(npar), wa4(nfree);
+    vector<int> ipvt(npar);
+    RowBlockQR qr(nfree);
+
+    int info = 0;
+    int nfev = 0;
+    double fnorm = -1., fnorm1 = -1., xnorm = -1., delta = 0.;
+    double par = 0., gnorm = 0.;
+
+    // evaluate user function with initial parameter values
+    int iflag = funct->deviates(xall, &dev[0]);
+    ++nfev;
+    if (iflag < 0)
+        return info;
+    fnorm = enorm(m, &dev[0]);
+    double orignorm = fnorm * fnorm;
+
+    for (int i = 0; i < nfree; ++i)
+        x[i] = xall[ifree[i]];
+
+    int iter = 1;
+    for (;;) { // outer loop
+        for (int i = 0; i < nfree; ++i)
+            xnew[ifree[i]] = x[i];
+
+        // calculate the Jacobian and accumulate it in R
+        qr.clear();
+        iflag = funct->jacobian(&xnew[0], ifree, &qr);
+        ++nfev;
+        if (iflag < 0)
+            break;
+        copy(qr.r().begin(), qr.r().end(), fjac.begin());
+
+        // determine if any of the parameters are pegged at the limits;
+        // J^T fvec = R^T Q^T fvec
+        if (qanylim) {
+            for (int j = 0; j < nfree; ++j) {
+                bool lpegged = (qllim[j] && x[j] == llim[j]);
+                bool upegged = (qulim[j] && x[j] == ulim[j]);
+                double sum = 0.;
+                if (lpegged || upegged)
+                    for (int i = 0; i <= j; ++i)
+                        sum += fjac[j*nfree+i] * qr.qtb()[i];
+                if ((lpegged && sum > 0) || (upegged && sum < 0))
+                    for (int i = 0; i <= j; ++i)
+                        fjac[j*nfree+i] = 0.;
+            }
+        }
+
+        // QR factorization with pivoting of R; it gives the same R and ipvt
+        // as the factorization of the full Jacobian in mpfit()
+        qrfac(nfree, &fjac[0], &ipvt[0], &wa1[0], &wa2[0], &wa3[0]);
+
+        if (iter == 1) {
+            // scale according to the norms of the columns of the initial
+            // jacobian, calculate the norm of the scaled x
+            // and initialize the step bound delta
+            if (conf.douserscale == 0)
+                for (int j = 0; j < nfree; ++j)
+                    diag[ifree[j]] = (wa2[j] == 0. ? 1. : wa2[j]);
+            for (int j = 0; j < nfree; ++j)
+                wa3[j] = diag[ifree[j]] * x[j];
+            xnorm = enorm(nfree, &wa3[0]);
+            delta = conf.stepfactor * xnorm;
+            if (delta == 0.)
+                delta = conf.stepfactor;
+        }
+
+        // form (q transpose)*fvec and store it in qtf
+        for (int i = 0; i < nfree; ++i)
+            wa4[i] = qr.qtb()[i];
+        for (int j = 0; j < nfree; ++j) {
+            double temp3 = fjac[j*nfree+j];
+            if (temp3 != 0.) {
+                double sum = 0.;
+                for (int i = j; i < nfree; ++i)
+                    sum += fjac[j*nfree+i] * wa4[i];
+                double temp = -sum / temp3;
+                for (int i = j; i < nfree; ++i)
+                    wa4[i] += fjac[j*nfree+i] * temp;
+            }
+            fjac[j*nfree+j] = wa1[j];
+            qtf[j] = wa4[j];
+        }
+
+        if (conf.nofinitecheck) {
+            for (int i = 0; i < nfree*nfree; ++i)
+                if (!(fabs(fjac[i]) < HUGE_VAL)) {
+                    info = MP_ERR_NAN;
+                    break;
+                }
+            if (info != 0)
+                break;
+        }
+
+        // compute the norm of the scaled gradient
+        gnorm = 0.;
+        if (fnorm != 0.) {
+            for (int j = 0; j < nfree; ++j) {
+                int l = ipvt[j];
+                if (wa2[l] != 0.) {
+                    double sum = 0.;
+                    for (int i = 0; i <= j; ++i)
+                        sum += fjac[j*nfree+i] * (qtf[i] / fnorm);
+                    double t = fabs(sum / wa2[l]);
+                    if (!(gnorm >= t)) // as mp_dmax1(), NaN is propagated
+                        gnorm = t;
+                }
+            }
+        }
+
+        // test for convergence of the gradient norm
+        if (gnorm <= conf.gtol)
+            info = MP_OK_DIR;
+        if (info != 0)
+            break;
+        if (conf.maxiter == 0) {
+            info = MP_MAXITER;
+            break;
+        }
+
+        // rescale if necessary
+        if (conf.douserscale == 0)
+            for (int j = 0; j < nfree; ++j)
+                diag[ifree[j]] = max(diag[ifree[j]], wa2[j]);
+
+        double ratio = 0.;
+        do { // inner loop
+            // determine the Levenberg-Marquardt parameter
+            lmpar(nfree, &fjac[0], &ipvt[0], &ifree[0], &diag[0], &qtf[0],
+                  delta, &par, &wa1[0], &wa2[0], &wa3[0], &wa4[0]);
+            // store the direction p and x + p. calculate the norm of p.
+            for (int j = 0; j < nfree; ++j)
+                wa1[j] = -wa1[j];
+
+            double alpha = 1.0;
+            if (!qanylim) {
+                for (int j = 0; j < nfree; ++j)
+                    wa2[j] = x[j] + wa1[j];
+            } else {
+                // respect the limits, if a step were to go out of bounds,
+                // take a step in the same direction to the limit
+                for (int j = 0; j < nfree; ++j) {
+                    bool lpegged = (qllim[j] && x[j] <= llim[j]);
+                    bool upegged = (qulim[j] && x[j] >= ulim[j]);
+                    bool dwa1 = fabs(wa1[j]) > MP_MACHEP0;
+                    if (lpegged && wa1[j] < 0)
+                        wa1[j] = 0;
+                    if (upegged && wa1[j] > 0)
+                        wa1[j] = 0;
+                    if (dwa1 && qllim[j] && x[j] + wa1[j] < llim[j])
+                        alpha = min(alpha, (llim[j] - x[j]) / wa1[j]);
+                    if (dwa1 && qulim[j] && x[j] + wa1[j] > ulim[j])
+                        alpha = min(alpha, (ulim[j] - x[j]) / wa1[j]);
+                }
+                for (int j = 0; j < nfree; ++j) {
+                    wa1[j] *= alpha;
+                    wa2[j] = x[j] + wa1[j];
+                    // if the step put us exactly on a boundary,
+                    // make sure it is exact
+                    double sgnu = (ulim[j] >= 0 ? 1 : -1);
+                    double sgnl = (llim[j] >= 0 ? 1 : -1);
+                    double ulim1 = ulim[j] * (1 - sgnu * MP_MACHEP0)
+                                   - (ulim[j] == 0 ? MP_MACHEP0 : 0);
+                    double llim1 = llim[j] * (1 + sgnl * MP_MACHEP0)
+                                   + (llim[j] == 0 ? MP_MACHEP0 : 0);
+                    if (qulim[j] && wa2[j] >= ulim1)
+                        wa2[j] = ulim[j];
+                    if (qllim[j] && wa2[j] <= llim1)
+                        wa2[j] = llim[j];
+                }
+            }
+
+            for (int j = 0; j < nfree; ++j)
+                wa3[j] = diag[ifree[j]] * wa1[j];
+            double pnorm = enorm(nfree, &wa3[0]);
+
+            // on the first iteration, adjust the initial step bound
+            if (iter == 1)
+                delta = min(delta, pnorm);
+
+            // evaluate the function at x + p and calculate its norm
+            for (int i = 0; i < nfree; ++i)
+                xnew[ifree[i]] = wa2[i];
+            iflag = funct->deviates(&xnew[0], &dev[0]);
+            ++nfev;
+            if (iflag < 0)
+                break;
+            fnorm1 = enorm(m, &dev[0]);
+
+            // compute the scaled actual reduction
+            double actred = -1.;
+            if (p1 * fnorm1 < fnorm) {
+                double temp = fnorm1 / fnorm;
+                actred = 1. - temp * temp;
+            }
+
+            // compute the scaled predicted reduction
+            // and the scaled directional derivative
+            for (int j = 0; j < nfree; ++j) {
+                wa3[j] = 0.;
+                double temp = wa1[ipvt[j]];
+                for (int i = 0; i <= j; ++i)
+                    wa3[i] += fjac[j*nfree+i] * temp;
+            }
+            // alpha is the fraction of the full LM step actually taken
+            double temp1 = enorm(nfree, &wa3[0]) * alpha / fnorm;
+            double temp2 = sqrt(alpha * par) * pnorm / fnorm;
+            double prered = temp1*temp1 + temp2*temp2 / p5;
+            double dirder = -(temp1*temp1 + temp2*temp2);
+
+            // compute the ratio of the actual to the predicted reduction
+            ratio = (prered != 0. ? actred / prered : 0.);
+
+            // update the step bound
+            if (ratio <= p25) {
+                double temp;
+                if (actred >= 0.)
+                    temp = p5;
+                else
+                    temp = p5 * dirder / (dirder + p5 * actred);
+                if (p1 * fnorm1 >= fnorm || temp < p1)
+                    temp = p1;
+                delta = temp * min(delta, pnorm / p1);
+                par /= temp;
+            } else if (par == 0. || ratio >= p75) {
+                delta = pnorm / p5;
+                par *= p5;
+            }
+
+            // test for successful iteration
+            if (ratio >= p0001) {
+                for (int j = 0; j < nfree; ++j) {
+                    x[j] = wa2[j];
+                    wa2[j] = diag[ifree[j]] * x[j];
+                }
+                xnorm = enorm(nfree, &wa2[0]);
+                fnorm = fnorm1;
+                ++iter;
+            }
+
+            // tests for convergence
+            if (fabs(actred) <= conf.ftol && prered <= conf.ftol
+                    && p5 * ratio <= 1.)
+                info = MP_OK_CHI;
+            if (delta <= conf.xtol * xnorm)
+                info = MP_OK_PAR;
+            if (fabs(actred) <= conf.ftol && prered <= conf.ftol
+                    && p5 * ratio <= 1. && info == 2)
+                info = MP_OK_BOTH;
+            if (info != 0)
+                break;
+
+            // tests for termination and stringent tolerances
+            if (conf.maxfev > 0 && nfev >= conf.maxfev)
+                info = MP_MAXITER;
+            if (iter >= conf.maxiter)
+                info = MP_MAXITER;
+            if (fabs(actred) <= MP_MACHEP0 && prered <= MP_MACHEP0
+                    && p5 * ratio <= 1.)
+                info = MP_FTOL;
+            if (delta <= MP_MACHEP0 * xnorm)
+                info = MP_XTOL;
+            if (gnorm <= MP_MACHEP0)
+                info = MP_GTOL;
+        } while (info == 0 && ratio < p0001);
+
+        if (info != 0 || iflag < 0)
+            break;
+    }
+
+    // termination, either normal or user imposed
+    if (iflag < 0)
+        info = iflag;
+    for (int i = 0; i < nfree; ++i)
+        xall[ifree[i]] = x[i];
+    if (conf.nprint > 0 && info > 0) {
+        funct->deviates(xall, &dev[0]);
+        ++nfev;
+    }
+
+    int npegged = 0;
+    if (pars)
+        for (int i = 0; i < npar; ++i)
+            if ((pars[i].limited[0] && pars[i].limits[0] == xall[i]) ||
+                    (pars[i].limited[1] && pars[i].limits[1] == xall[i]))
+                ++npegged;
+
+    // compute and return the covariance matrix and/or parameter errors
+    if (result && (result->covar || result->xerror)) {
+        covar(nfree, &fjac[0], &ipvt[0], conf.covtol, &wa2[0]);
+        if (result->covar) {
+            fill(result->covar, result->covar + npar*npar, 0.);
+            for (int j = 0; j < nfree; ++j)
+                for (int i = 0; i < nfree; ++i)
+                    result->covar[ifree[j]*npar+ifree[i]] = fjac[j*nfree+i];
+        }
+        if (result->xerror) {
+            fill(result->xerror, result->xerror + npar, 0.);
+            for (int j = 0; j < nfree; ++j) {
+                double cc = fjac[j*nfree+j];
+                if (cc > 0)
+                    result->xerror[ifree[j]] = sqrt(cc);
+            }
+        }
+    }
+
+    if (result) {
+        strcpy(result->version, MPFIT_VERSION);
+        result->bestnorm = max(fnorm, fnorm1);
+        result->bestnorm *= result->bestnorm;
+        result->orignorm = orignorm;
+        result->status = info;
+        result->niter = iter;
+        result->nfev = nfev;
+        result->npar = npar;
+        result->nfree = nfree;
+        result->npegged = npegged;
+        result->nfunc = m;
+    }
+    return info;
+}
+
+} // namespace fityk
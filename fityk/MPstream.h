@@ -0,0 +1,61 @@
+// This file is part of fityk program. Copyright 2001-2013 Marcin Wojdyr
+// Licence: GNU General Public License ver. 2+
+
+/// MPFIT-compatible Levenberg-Marquardt driver for large numbers of points.
+/// It follows mpfit() step by step, but the Jacobian is never stored:
+/// it is computed in blocks of rows that are accumulated into the triangular
+/// factor R, so the memory used does not grow with the number of points
+/// (except a single vector of deviates).
+
+#ifndef FITYK_MPSTREAM_H_
+#define FITYK_MPSTREAM_H_
+#include <vector>
+#include "cmpfit/mpfit.h"
+
+namespace fityk {
+
+/// Incremental QR factorization of matrix A (m x n) and vector b:
+/// rows are added in blocks and only R (n x n) and the first n elements
+/// of Q^T b are kept. Blocks are merged using Householder reflections.
+class RowBlockQR
+{
+public:
+    RowBlockQR(int n) : n_(n), r_(n*n, 0.), qtb_(n, 0.) {}
+    void clear();
+    /// adds nrows rows: a is column-major (nrows x n), b has nrows elements;
+    /// both arrays are used as a workspace and are overwritten
+    void add_rows(int nrows, double *a, double *b);
+    int n() const { return n_; }
+    /// column-major, only the upper triangle is used
+    const std::vector<double>& r() const { return r_; }
+    const std::vector<double>& qtb() const { return qtb_; }
+
+private:
+    int n_;
+    std::vector<double> r_;
+    std::vector<double> qtb_;
+};
+
+/// The user function for mpfit_streamed(), equivalent of mp_func.
+/// Methods return negative value to stop the fitting.
+class MPstreamFunc
+{
+public:
+    virtual ~MPstreamFunc() {}
+    /// computes m deviates
+    virtual int deviates(const double *par, double *dev) = 0;
+    /// computes deviates and their derivatives with respect to free
+    /// parameters (par[ifree[0]], par[ifree[1]], ...) and adds them
+    /// in blocks of rows to qr
+    virtual int jacobian(const double *par, const std::vector<int>& ifree,
+                         RowBlockQR *qr) = 0;
+};
+
+/// Has the same arguments and results as mpfit(), but requires analytical
+/// derivatives. Fields of mp_par related to numerical derivatives and
+/// result->resid are not supported.
+int mpfit_streamed(MPstreamFunc *funct, int m, int npar, double *xall,
+                   mp_par *pars, mp_config *config, mp_result *result);
+
+} // namespace fityk
+#endif
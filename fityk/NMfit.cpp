@@ -67,7 +67,10 @@ void NMfit::find_best_worst()
 
 double NMfit::run_method(vector<realt>* best_a)
 {
-    init();
+    if (resuming_)
+        find_best_worst(); // continue with the simplex from the last run
+    else
+        init();
     realt convergence = F_->get_settings()->nm_convergence;
     for (int iter = 0; !termination_criteria(iter, convergence); ++iter) {
         change_simplex();
@@ -75,7 +78,7 @@ double NMfit::run_method(vector<realt>* best_a)
         iteration_plot(best->a, best->wssr);
     }
     *best_a = best->a;
-    return best->wssr;
+    return polish_screened(best_a, best->wssr);
 }
 
 void NMfit::change_simplex()
@@ -170,7 +173,7 @@ bool NMfit::termination_criteria(int iter, realt convergence)
 void NMfit::compute_v(Vertex& v)
 {
     assert (!v.a.empty());
-    v.wssr = compute_wssr(v.a, fitted_datas_);
+    v.wssr = compute_wssr_screening(v.a);
     v.computed = true;
 }
 
@@ -28,8 +28,10 @@ class NMfit : public Fit
 public:
     NMfit(Full* F, const char* fname) : Fit(F, fname) {}
     virtual double run_method(std::vector<realt>* best_a);
+protected:
+    virtual bool can_resume() const { return true; }
 private:
-    std::vector<Vertex> vertices;
+    std::vector<Vertex> vertices; // kept for resuming
     std::vector<Vertex>::iterator best, s_worst /*second worst*/, worst;
     std::vector<realt> coord_sum;
     realt volume_factor;
@@ -0,0 +1,348 @@
+// This file is part of fityk program. Copyright 2001-2013 Marcin Wojdyr
+// Licence: GNU General Public License ver. 2+
+
+#define BUILDING_LIBFITYK
+#include "TRfit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "common.h"
+#include "ui.h"
+#include "settings.h"
+#include "logic.h"
+#include "numfuncs.h"
+
+using namespace std;
+
+namespace fityk {
+
+template<typename T>
+static realt dot_product(const T *a, const T *b, int n)
+{
+    realt sum = 0.;
+    for (int i = 0; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+// The notation follows More', "The Levenberg-Marquardt algorithm:
+// implementation and theory" (1978). Residuals r_i = (y_i - f_i) / sigma_i,
+// J = dr/da, the step p minimizes |r + J p| subject to |D p| <= radius.
+
+double TRfit::run_method(std::vector<realt>* best_a)
+{
+    const realt stop_rel = F_->get_settings()->lm_stop_rel_change;
+    const bool geodesic = F_->get_settings()->tr_geodesic_accel;
+    const int max_broyden = F_->get_settings()->tr_broyden_updates;
+
+    free_.clear();
+    for (int i = 0; i < na_; ++i)
+        if (par_usage()[i])
+            free_.push_back(i);
+    const int p = free_.size();
+    m_ = count_points(fitted_datas_);
+    jac_.resize(m_ * p);
+    diag_.assign(p, 0.);
+    jacobian_count_ = 0;
+
+    *best_a = a_orig_;
+    vector<realt> a = a_orig_;
+    vector<double> r(m_), r_new(m_), r_h(m_);
+    compute_jacobian(a, r);
+    int broyden_count = 0; // updates since the last computation of Jacobian
+    int broyden_total = 0;
+    realt chi2 = initial_wssr_;
+    for (int j = 0; j < p; ++j) {
+        realt d = sqrt(dot_product(&jac_[j*m_], &jac_[j*m_], m_));
+        diag_[j] = (d != 0. ? d : 1.);
+    }
+    vector<realt> free_a(p);
+    for (int j = 0; j < p; ++j)
+        free_a[j] = a[free_[j]];
+    realt radius = 100. * scaled_norm(free_a);
+    if (radius == 0.)
+        radius = 100.;
+    realt lambda = 0.;
+
+    if (F_->get_verbosity() >= 2) {
+        F_->ui()->mesg(format_matrix(a_orig_, 1, na_, "Initial A"));
+        F_->ui()->mesg("Starting with trust-region radius=" + S(radius));
+    }
+
+    vector<realt> v, acc(p), step, rhs(p), jv(m_), a_new(na_);
+    int small_change_counter = 0;
+    for (int iter = 0; !common_termination_criteria(); iter++) {
+        compute_jtj_and_grad(r);
+        find_step(radius, lambda, v);
+        step = v;
+
+        if (geodesic) {
+            // second directional derivative of residuals along v,
+            // from finite difference with step h
+            const realt h = 0.1;
+            vector<realt> hv(v);
+            vm_foreach (realt, i, hv)
+                *i *= h;
+            add_step(a, hv, a_new);
+            compute_deviates(a_new, &r_h[0]);
+            multiply_jac(v, jv);
+            for (int i = 0; i < m_; ++i)
+                r_h[i] = 2. / h * ((r_h[i] - r[i]) / h - jv[i]);
+            for (int j = 0; j < p; ++j)
+                rhs[j] = -dot_product(&jac_[j*m_], &r_h[0], m_);
+            solve(rhs, acc); // with factorization from find_step()
+            // acceleration is used only if it's small compared to velocity
+            if (2 * scaled_norm(acc) <= 0.75 * scaled_norm(v))
+                for (int j = 0; j < p; ++j)
+                    step[j] += 0.5 * acc[j];
+        }
+
+        add_step(a, step, a_new);
+        compute_deviates(a_new, &r_new[0]);
+        realt new_chi2 = dot_product(&r_new[0], &r_new[0], m_);
+        // reduction predicted by the linear model (for velocity only)
+        multiply_jac(v, jv);
+        for (int i = 0; i < m_; ++i)
+            jv[i] += r[i];
+        realt predicted = chi2 - dot_product(&jv[0], &jv[0], m_);
+        realt rho = predicted > 0 ? (chi2 - new_chi2) / predicted : -1.;
+        realt step_norm = scaled_norm(step);
+
+        if (F_->get_verbosity() >= 1)
+            F_->ui()->mesg(iteration_info(new_chi2) +
+                           format1<double,32>("  radius=%.5g", radius) +
+                           format1<double,32>("  rho=%.3g", rho) +
+                           format1<int,32>("  iter #%d", iter));
+        // termination criterium: no reduction predicted by the linear model
+        if (predicted <= stop_rel * chi2 && broyden_count == 0) {
+            if (new_chi2 < chi2) {
+                chi2 = new_chi2;
+                *best_a = a_new;
+            }
+            F_->msg("... converged.");
+            break;
+        }
+        if (new_chi2 < chi2 && rho > 1e-4) {
+            realt rel_change = (chi2 - new_chi2) / chi2;
+            // poor agreement with linear model - don't trust approximation
+            if (broyden_count < max_broyden && rho > 0.25) {
+                broyden_update(step, r, r_new);
+                ++broyden_count;
+                ++broyden_total;
+            } else {
+                compute_jacobian(a_new, r_new);
+                broyden_count = 0;
+            }
+            a = a_new;
+            r.swap(r_new);
+            chi2 = new_chi2;
+            *best_a = a;
+            for (int j = 0; j < p; ++j) {
+                const double *jj = &jac_[j*m_];
+                diag_[j] = max(diag_[j], sqrt(dot_product(jj, jj, m_)));
+            }
+
+            if (rho > 0.75)
+                radius = max(radius, 3 * step_norm);
+            else if (rho < 0.25)
+                radius = 0.5 * step_norm;
+
+            // termination criterium: negligible change of chi2
+            if (rel_change < stop_rel || chi2 == 0) {
+                if (broyden_count != 0) {
+                    // make sure it's not an artifact of approximate Jacobian
+                    compute_jacobian(a, r);
+                    broyden_count = 0;
+                } else {
+                    small_change_counter++;
+                    if (small_change_counter >= 2 || chi2 == 0) {
+                        F_->msg("... converged.");
+                        break;
+                    }
+                }
+            } else
+                small_change_counter = 0;
+        }
+
+        else { // worse fitting
+            if (broyden_count != 0) {
+                // try again with exact Jacobian before shrinking the region
+                compute_jacobian(a, r);
+                broyden_count = 0;
+            } else {
+                radius = 0.25 * min(radius, step_norm);
+                // termination criterium: tiny trust region
+                if (radius <= 1e-15 * (scaled_norm(free_a) + 1e-15)) {
+                    F_->msg("In trust-region method: radius=" + S(radius)
+                            + ", stopped.");
+                    break;
+                }
+            }
+        }
+        for (int j = 0; j < p; ++j)
+            free_a[j] = a[free_[j]];
+
+        iteration_plot(*best_a, chi2);
+    }
+    if (F_->get_verbosity() >= 1)
+        F_->ui()->mesg("Jacobian computed " + S(jacobian_count_) + " times, "
+                       + S(broyden_total) + " Broyden updates.");
+    return chi2;
+}
+
+// a_new = a + step, where step has only fitted parameters
+void TRfit::add_step(const vector<realt>& a, const vector<realt>& step,
+                     vector<realt>& a_new) const
+{
+    a_new = a;
+    for (size_t j = 0; j != free_.size(); ++j)
+        a_new[free_[j]] += step[j];
+}
+
+void TRfit::compute_jacobian(const vector<realt>& a, vector<double>& r)
+{
+    vector<double*> derivs(na_, (double*) NULL);
+    for (size_t j = 0; j != free_.size(); ++j)
+        derivs[free_[j]] = &jac_[j*m_];
+    compute_derivatives_mp(a, fitted_datas_, &derivs[0], &r[0]);
+    ++jacobian_count_;
+}
+
+void TRfit::compute_jtj_and_grad(const vector<double>& r)
+{
+    int p = free_.size();
+    jtj_.resize(p * p);
+    grad_.resize(p);
+    for (int j = 0; j < p; ++j) {
+        const double *jj = &jac_[j*m_];
+        for (int k = 0; k <= j; ++k)
+            jtj_[p*j+k] = jtj_[p*k+j] = dot_product(jj, &jac_[k*m_], m_);
+        grad_[j] = dot_product(jj, &r[0], m_);
+    }
+}
+
+void TRfit::multiply_jac(const vector<realt>& v, vector<realt>& jv) const
+{
+    fill(jv.begin(), jv.end(), 0.);
+    for (size_t j = 0; j != free_.size(); ++j) {
+        const double *jj = &jac_[j*m_];
+        for (int i = 0; i < m_; ++i)
+            jv[i] += jj[i] * v[j];
+    }
+}
+
+realt TRfit::scaled_norm(const vector<realt>& v) const
+{
+    realt sum = 0;
+    for (size_t j = 0; j != v.size(); ++j)
+        sum += (diag_[j] * v[j]) * (diag_[j] * v[j]);
+    return sqrt(sum);
+}
+
+// Cholesky factorization of J^T J + lambda D^2 -> chol_ (lower triangle)
+bool TRfit::factorize(realt lambda)
+{
+    int p = free_.size();
+    chol_ = jtj_;
+    for (int j = 0; j < p; ++j)
+        chol_[p*j+j] += lambda * diag_[j] * diag_[j];
+    for (int j = 0; j < p; ++j) {
+        realt d = chol_[p*j+j];
+        for (int k = 0; k < j; ++k)
+            d -= chol_[p*j+k] * chol_[p*j+k];
+        if (d <= 1e-14 * jtj_[p*j+j] || d <= 0)
+            return false;
+        d = sqrt(d);
+        chol_[p*j+j] = d;
+        for (int i = j+1; i < p; ++i) {
+            realt s = chol_[p*i+j];
+            for (int k = 0; k < j; ++k)
+                s -= chol_[p*i+k] * chol_[p*j+k];
+            chol_[p*i+j] = s / d;
+        }
+    }
+    return true;
+}
+
+// solves (J^T J + lambda D^2) x = rhs, pre: factorize()
+void TRfit::solve(const vector<realt>& rhs, vector<realt>& x) const
+{
+    int p = free_.size();
+    x = rhs;
+    for (int i = 0; i < p; ++i) {
+        for (int k = 0; k < i; ++k)
+            x[i] -= chol_[p*i+k] * x[k];
+        x[i] /= chol_[p*i+i];
+    }
+    for (int i = p-1; i >= 0; --i) {
+        for (int k = i+1; k < p; ++k)
+            x[i] -= chol_[p*k+i] * x[k];
+        x[i] /= chol_[p*i+i];
+    }
+}
+
+// Finds lambda such that |D step| is approximately equal to the radius,
+// unless the Gauss-Newton step (lambda=0) is inside the trust region.
+// Newton iterations as in More' (1978), lambda is also used as a guess.
+void TRfit::find_step(realt radius, realt& lambda, vector<realt>& step)
+{
+    int p = free_.size();
+    vector<realt> minus_grad(p), q(p);
+    for (int j = 0; j < p; ++j)
+        minus_grad[j] = -grad_[j];
+    if (factorize(0.)) {
+        solve(minus_grad, step);
+        if (scaled_norm(step) <= 1.1 * radius) {
+            lambda = 0.;
+            return;
+        }
+    }
+    if (lambda <= 0.) {
+        realt gn = 0.;
+        for (int j = 0; j < p; ++j)
+            gn += (grad_[j] / diag_[j]) * (grad_[j] / diag_[j]);
+        lambda = sqrt(gn) / radius;
+    }
+    for (int iter = 0; iter < 10; ++iter) {
+        while (!factorize(lambda))
+            lambda = 10 * lambda + 1e-10;
+        solve(minus_grad, step);
+        realt dn = scaled_norm(step);
+        realt phi = dn - radius;
+        if (fabs(phi) < 0.1 * radius)
+            break;
+        // q = L^-1 D^2 step / dn
+        for (int i = 0; i < p; ++i) {
+            q[i] = diag_[i] * diag_[i] * step[i] / dn;
+            for (int k = 0; k < i; ++k)
+                q[i] -= chol_[p*i+k] * q[k];
+            q[i] /= chol_[p*i+i];
+        }
+        realt new_lambda = lambda + phi / radius / dot_product(&q[0], &q[0], p);
+        lambda = (new_lambda > 0 ? new_lambda : 0.1 * lambda);
+    }
+}
+
+// rank-1 update: J += (r_new - r - J step) step^T / (step^T step)
+void TRfit::broyden_update(const vector<realt>& step, const vector<double>& r,
+                           const vector<double>& r_new)
+{
+    int p = free_.size();
+    vector<realt> u(m_);
+    multiply_jac(step, u);
+    for (int i = 0; i < m_; ++i)
+        u[i] = r_new[i] - r[i] - u[i];
+    realt ss = dot_product(&step[0], &step[0], p);
+    if (ss == 0.)
+        return;
+    for (int j = 0; j < p; ++j) {
+        realt c = step[j] / ss;
+        double *jj = &jac_[j*m_];
+        for (int i = 0; i < m_; ++i)
+            jj[i] += u[i] * c;
+    }
+}
+
+} // namespace fityk
@@ -0,0 +1,48 @@
+// This file is part of fityk program. Copyright 2001-2013 Marcin Wojdyr
+// Licence: GNU General Public License ver. 2+
+
+/// Levenberg-Marquardt method in the trust-region formulation (as in MINPACK)
+/// with optional geodesic acceleration (Transtrum and Sethna, 2012)
+/// and Broyden rank-1 updates of the Jacobian between full evaluations.
+
+#ifndef FITYK_TRFIT_H_
+#define FITYK_TRFIT_H_
+#include <vector>
+#include "fityk.h"
+#include "fit.h"
+
+namespace fityk {
+
+class TRfit : public Fit
+{
+public:
+    TRfit(Full* F, const char* fname) : Fit(F, fname) {}
+    virtual double run_method(std::vector<realt>* best_a);
+
+private:
+    int m_; // number of points
+    int jacobian_count_;
+    std::vector<int> free_; // global positions of fitted parameters
+    // Jacobian of weighted residuals, column-major, m_ x free_.size();
+    // residuals and Jacobian are in double, as in compute_derivatives_mp()
+    std::vector<double> jac_;
+    std::vector<realt> diag_; // scaling of parameters, D in MINPACK
+    std::vector<realt> jtj_, grad_; // J^T J and J^T r
+    std::vector<realt> chol_; // Cholesky factor of J^T J + lambda D^2
+
+    void compute_jacobian(const std::vector<realt>& a, std::vector<double>& r);
+    void compute_jtj_and_grad(const std::vector<double>& r);
+    void multiply_jac(const std::vector<realt>& v, std::vector<realt>& jv)const;
+    realt scaled_norm(const std::vector<realt>& v) const;
+    bool factorize(realt lambda);
+    void solve(const std::vector<realt>& rhs, std::vector<realt>& x) const;
+    void find_step(realt radius, realt& lambda, std::vector<realt>& step);
+    void broyden_update(const std::vector<realt>& step,
+                        const std::vector<double>& r,
+                        const std::vector<double>& r_new);
+    void add_step(const std::vector<realt>& a, const std::vector<realt>& step,
+                  std::vector<realt>& a_new) const;
+};
+
+} // namespace fityk
+#endif
@@ -0,0 +1,339 @@
+// This file is part of fityk program. Copyright 2001-2013 Marcin Wojdyr
+// Licence: GNU General Public License ver. 2+
+
+#define BUILDING_LIBFITYK
+#include "VPfit.h"
+
+#include <cmath>
+#include <vector>
+
+#include "common.h"
+#include "ui.h"
+#include "settings.h"
+#include "logic.h"
+#include "numfuncs.h"
+#include "func.h"
+#include "tplate.h"
+#include "var.h"
+
+using namespace std;
+
+namespace fityk {
+
+template<typename T>
+static realt dot_product(const T *a, const T *b, int n)
+{
+    realt sum = 0.;
+    for (int i = 0; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+// Residuals r_i = (y_i - f_i) / sigma_i, J = dr/da. Columns of J that
+// correspond to linear parameters (J_L) don't depend on these parameters,
+// so for given nonlinear parameters the linear ones are obtained exactly
+// in one Gauss-Newton step. The step of nonlinear parameters minimizes
+// |r + P J_N p|, where P projects onto the orthogonal complement of J_L.
+
+double VPfit::run_method(std::vector<realt>* best_a)
+{
+    const realt stop_rel = F_->get_settings()->lm_stop_rel_change;
+    const realt max_lambda = F_->get_settings()->lm_max_lambda;
+    double lambda = F_->get_settings()->lm_lambda_start;
+
+    m_ = 0;
+    v_foreach (Data*, i, fitted_datas_)
+        m_ += (*i)->get_n();
+    *best_a = a_orig_;
+    find_linear_parameters(a_orig_);
+    const int nn = nonlin_.size();
+    if (F_->get_verbosity() >= 1)
+        F_->ui()->mesg("Linear parameters: " + S(lin_.size()) + ", fitted"
+                       " with Lev-Mar: " + S(nn) + ".");
+
+    vector<realt> a = a_orig_;
+    set_bounds();
+    if (clip_to_bounds(a))
+        F_->msg("Initial parameters moved into their domains.");
+    compute_jacobian(a, false);
+    realt chi2 = project(a);
+    *best_a = a;
+    if (nn == 0) {
+        F_->msg("... linear least squares solved.");
+        return chi2;
+    }
+
+    // columns of J_N depend on the linear parameters changed in project()
+    compute_jacobian(a, true);
+    vector<realt> alpha, beta;
+    compute_reduced_system(alpha, beta);
+
+    int small_change_counter = 0;
+    for (int iter = 0; !common_termination_criteria(); iter++) {
+        vector<realt> step_alpha = alpha;
+        vector<realt> step = beta;
+        for (int j = 0; j < nn; j++)
+            step_alpha[nn * j + j] *= (1.0 + lambda);
+        jordan_solve(step_alpha, step, nn);
+        vector<realt> a_new = a;
+        for (int j = 0; j < nn; j++)
+            a_new[nonlin_[j]] += step[j];
+        clip_to_bounds(a_new);
+        // only J_L is needed for the projection
+        compute_jacobian(a_new, false);
+        realt new_chi2 = project(a_new);
+        if (F_->get_verbosity() >= 1)
+            F_->ui()->mesg(iteration_info(new_chi2) +
+                           format1<double,32>("  lambda=%.5g", lambda) +
+                           format1<int,32>("  iter #%d", iter));
+        if (new_chi2 < chi2) {
+            realt rel_change = (chi2 - new_chi2) / chi2;
+            chi2 = new_chi2;
+            a = a_new;
+            *best_a = a;
+            // termination criterium: negligible change of chi2
+            if (rel_change < stop_rel || chi2 == 0) {
+                small_change_counter++;
+                if (small_change_counter >= 2 || chi2 == 0) {
+                    F_->msg("... converged.");
+                    break;
+                }
+            } else
+                small_change_counter = 0;
+            // the full Jacobian is computed only after an accepted step
+            compute_jacobian(a, true);
+            compute_reduced_system(alpha, beta);
+            lambda /= F_->get_settings()->lm_lambda_down_factor;
+        } else {
+            // termination criterium: large lambda
+            if (lambda > max_lambda) {
+                F_->msg("In L-M method: lambda=" + S(lambda) + " > "
+                        + S(max_lambda) + ", stopped.");
+                break;
+            }
+            lambda *= F_->get_settings()->lm_lambda_up_factor;
+        }
+        iteration_plot(*best_a, chi2);
+    }
+    return chi2;
+}
+
+// Computes r_ and columns of jac_, either all (full) or only J_L.
+// Without linear parameters, J_L is empty and only r_ is computed.
+void VPfit::compute_jacobian(const vector<realt>& a, bool full)
+{
+    const int nl = lin_.size();
+    jac_.resize(m_ * (nl + nonlin_.size()));
+    r_.resize(m_);
+    if (nl == 0 && !full) {
+        compute_deviates(a, &r_[0]);
+        return;
+    }
+    vector<double*> derivs(na_, (double*) NULL);
+    for (int j = 0; j != nl; ++j)
+        derivs[lin_[j]] = &jac_[j*m_];
+    if (full)
+        for (size_t j = 0; j != nonlin_.size(); ++j)
+            derivs[nonlin_[j]] = &jac_[(nl+j)*m_];
+    compute_derivatives_mp(a, fitted_datas_, &derivs[0], &r_[0]);
+}
+
+// Domains are taken into account only for nonlinear parameters,
+// the linear ones are computed in project() without constraints.
+void VPfit::set_bounds()
+{
+    lo_.clear();
+    hi_.clear();
+    if (!F_->get_settings()->box_constraints)
+        return;
+    bool has_bounds = false;
+    vector<realt> lo(na_, -HUGE_VAL), hi(na_, HUGE_VAL);
+    v_foreach (int, i, nonlin_) {
+        const RealRange& d = F_->mgr.gpos_to_var(*i)->domain;
+        if (!d.lo_inf() || !d.hi_inf()) {
+            lo[*i] = d.lo;
+            hi[*i] = d.hi;
+            has_bounds = true;
+        }
+    }
+    if (has_bounds) {
+        lo_.swap(lo);
+        hi_.swap(hi);
+    }
+}
+
+bool VPfit::clip_to_bounds(vector<realt> &a) const
+{
+    bool changed = false;
+    for (size_t i = 0; i < lo_.size(); ++i) {
+        if (a[i] < lo_[i]) {
+            a[i] = lo_[i];
+            changed = true;
+        } else if (a[i] > hi_[i]) {
+            a[i] = hi_[i];
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Candidates for linear parameters are taken from built-in function types:
+// all arguments of linear functions (Constant, Linear, Polynomial*)
+// and height or area of peaks, if they are simple variables.
+// Arguments of user-defined functions are candidates if the model changes
+// linearly with them (checked one by one, using only model evaluations).
+// Finally, a candidate is accepted if its column of J doesn't change when
+// all the candidates are changed together (that excludes e.g. products
+// of parameters, or parameters used also in a non-linear way).
+void VPfit::find_linear_parameters(const vector<realt>& a)
+{
+    vector<bool> candidate(na_, false);
+    vector<bool> to_check(na_, false);
+    v_foreach (Function*, f, F_->mgr.functions()) {
+        const Tplate* tp = (*f)->tp().get();
+        for (int i = 0; i != (*f)->used_vars().get_count(); ++i) {
+            const Variable* v =
+                F_->mgr.variables()[(*f)->used_vars().get_idx(i)];
+            if (v->gpos() < 0)
+                continue;
+            if (!tp->is_coded())
+                to_check[v->gpos()] = true;
+            else if ((tp->traits & Tplate::kLinear) ||
+                     ((tp->traits & Tplate::kPeak) && i < size(tp->fargs) &&
+                      (tp->fargs[i] == "height" || tp->fargs[i] == "area")))
+                candidate[v->gpos()] = true;
+        }
+    }
+
+    lin_.clear();
+    nonlin_.clear();
+    for (int i = 0; i < na_; ++i)
+        if (par_usage()[i])
+            nonlin_.push_back(i);
+    const int n = nonlin_.size();
+    compute_jacobian(a, true);
+    const vector<double> jac0 = jac_;
+    const vector<double> r0 = r_;
+    vector<bool> is_lin(n, false);
+    vector<double> r1(m_);
+    for (int j = 0; j < n; ++j) {
+        int k = nonlin_[j];
+        const double *c0 = &jac0[j*m_];
+        realt norm2 = dot_product(c0, c0, m_);
+        if (norm2 == 0)
+            continue;
+        if (candidate[k]) {
+            is_lin[j] = true;
+        } else if (to_check[k]) {
+            vector<realt> a1 = a;
+            realt delta = 0.25 * (fabs(a[k]) + 1.);
+            a1[k] += delta;
+            compute_deviates(a1, &r1[0]);
+            realt diff2 = 0;
+            for (int i = 0; i < m_; ++i) {
+                realt d = r1[i] - r0[i] - delta * c0[i];
+                diff2 += d * d;
+            }
+            is_lin[j] = (diff2 <= 1e-12 * delta * delta * norm2);
+        }
+    }
+    // each pass removes the parameter with the largest change of column
+    for (;;) {
+        vector<realt> a1 = a;
+        for (int j = 0; j < n; ++j)
+            if (is_lin[j]) {
+                int k = nonlin_[j];
+                a1[k] += (0.25 + 0.05 * (j % 4)) * (fabs(a[k]) + 1.);
+            }
+        compute_jacobian(a1, true);
+        int worst = -1;
+        realt worst_change = 1e-12;
+        for (int j = 0; j < n; ++j) {
+            if (!is_lin[j])
+                continue;
+            const double *c0 = &jac0[j*m_];
+            const double *c1 = &jac_[j*m_];
+            realt diff2 = 0;
+            for (int i = 0; i < m_; ++i)
+                diff2 += (c1[i] - c0[i]) * (c1[i] - c0[i]);
+            realt change = diff2 / dot_product(c0, c0, m_);
+            if (!(change <= worst_change)) { // NaN is also the worst
+                worst = j;
+                worst_change = change;
+            }
+        }
+        if (worst == -1)
+            break;
+        is_lin[worst] = false;
+    }
+    vector<int> all;
+    all.swap(nonlin_);
+    for (int j = 0; j < n; ++j)
+        (is_lin[j] ? lin_ : nonlin_).push_back(all[j]);
+}
+
+// Sets linear parameters in a to the optimal values, using jac_ and r_
+// computed at a. Updates r_ and returns WSSR.
+realt VPfit::project(vector<realt>& a)
+{
+    const int nl = lin_.size();
+    if (nl != 0) {
+        vector<realt> q(nl * nl), delta(nl);
+        for (int j = 0; j < nl; ++j) {
+            const double *cj = &jac_[j*m_];
+            for (int k = 0; k <= j; ++k)
+                q[nl*j+k] = q[nl*k+j] = dot_product(cj, &jac_[k*m_], m_);
+            delta[j] = -dot_product(cj, &r_[0], m_);
+        }
+        jordan_solve(q, delta, nl);
+        for (int j = 0; j < nl; ++j) {
+            a[lin_[j]] += delta[j];
+            const double *cj = &jac_[j*m_];
+            for (int i = 0; i < m_; ++i)
+                r_[i] += cj[i] * delta[j];
+        }
+    }
+    return dot_product(&r_[0], &r_[0], m_);
+}
+
+// Normal equations for the step of nonlinear parameters:
+// alpha = (P J_N)^T (P J_N), beta = -(P J_N)^T r.
+void VPfit::compute_reduced_system(vector<realt>& alpha,
+                                   vector<realt>& beta) const
+{
+    const int nl = lin_.size();
+    const int nn = nonlin_.size();
+    const double *jn = &jac_[nl*m_];
+    vector<double> pj(jn, jn + nn*m_); // P J_N
+    if (nl != 0) {
+        vector<realt> q(nl * nl);
+        for (int j = 0; j < nl; ++j)
+            for (int k = 0; k <= j; ++k)
+                q[nl*j+k] = q[nl*k+j] = dot_product(&jac_[j*m_], &jac_[k*m_],
+                                                    m_);
+        invert_matrix(q, nl);
+        vector<realt> t(nl), x(nl);
+        for (int c = 0; c < nn; ++c) {
+            double *col = &pj[c*m_];
+            for (int j = 0; j < nl; ++j)
+                t[j] = dot_product(&jac_[j*m_], col, m_);
+            for (int j = 0; j < nl; ++j)
+                x[j] = dot_product(&q[nl*j], &t[0], nl);
+            for (int j = 0; j < nl; ++j) {
+                const double *cj = &jac_[j*m_];
+                for (int i = 0; i < m_; ++i)
+                    col[i] -= cj[i] * x[j];
+            }
+        }
+    }
+    alpha.resize(nn * nn);
+    beta.resize(nn);
+    for (int j = 0; j < nn; ++j) {
+        const double *cj = &pj[j*m_];
+        for (int k = 0; k <= j; ++k)
+            alpha[nn*j+k] = alpha[nn*k+j] = dot_product(cj, &pj[k*m_], m_);
+        beta[j] = -dot_product(cj, &r_[0], m_);
+    }
+}
+
+} // namespace fityk
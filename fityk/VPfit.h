@@ -0,0 +1,44 @@
+// This file is part of fityk program. Copyright 2001-2013 Marcin Wojdyr
+// Licence: GNU General Public License ver. 2+
+
+/// Variable projection (Golub and Pereyra, 1973): parameters that enter
+/// the model linearly are computed by linear least squares for each trial
+/// of the other parameters, which are fitted with the Levenberg-Marquardt
+/// method using the Kaufman (1975) approximation of the projected Jacobian.
+
+#ifndef FITYK_VPFIT_H_
+#define FITYK_VPFIT_H_
+#include <vector>
+#include "fityk.h"
+#include "fit.h"
+
+namespace fityk {
+
+class VPfit : public Fit
+{
+public:
+    VPfit(Full* F, const char* fname) : Fit(F, fname) {}
+    virtual double run_method(std::vector<realt>* best_a);
+
+private:
+    int m_; // number of points
+    std::vector<int> lin_;    // global positions of linear parameters
+    std::vector<int> nonlin_; // global positions of other fitted parameters
+    // Jacobian of weighted residuals, column-major, m_ x (lin_ + nonlin_),
+    // and the residuals, both computed at the same parameters (in double,
+    // as in compute_derivatives_mp())
+    std::vector<double> jac_, r_;
+    // domains of nonlinear parameters, empty if not used
+    std::vector<realt> lo_, hi_;
+
+    void compute_jacobian(const std::vector<realt>& a, bool full);
+    void set_bounds();
+    bool clip_to_bounds(std::vector<realt>& a) const;
+    void find_linear_parameters(const std::vector<realt>& a);
+    realt project(std::vector<realt>& a);
+    void compute_reduced_system(std::vector<realt>& alpha,
+                                std::vector<realt>& beta) const;
+};
+
+} // namespace fityk
+#endif
@@ -41,6 +41,7 @@ const char* info_args[] = {
     "set",
     "history", "guess",
     "fit", "errors", "confidence", "cov",
+    "errors_bootstrap", "errors_montecarlo", "confidence_profile",
     "refs", "prop",
     NULL
 };
@@ -204,9 +205,9 @@ void Parser::parse_real_range(Lexer& lex, vector<Token>& args)
     }
 }
 
-// %funcname | [@n.]('F'|'Z') '[' Number ']'
+// %funcname | [@n.]('F'|'Z'|'R') '[' Number ']'
 // returns:   1 token:  Funcname
-//         or 2/3 tokens: Dataset|Nop, "F"|"Z", [expr]
+//         or 2/3 tokens: Dataset|Nop, "F"|"Z"|"R", [expr]
 void Parser::parse_func_id(Lexer& lex, vector<Token>& args, bool accept_fz)
 {
     Token t = lex.get_token();
@@ -220,7 +221,7 @@ void Parser::parse_func_id(Lexer& lex, vector<Token>& args, bool accept_fz)
         t = lex.get_token();
     } else
         args.push_back(nop());
-    if (t.as_string() != "F" && t.as_string() != "Z")
+    if (t.as_string() != "F" && t.as_string() != "Z" && t.as_string() != "R")
         lex.throw_syntax_error("expected %function ID");
     args.push_back(t);
     if (accept_fz && lex.peek_token().type != kTokenLSquare) {
@@ -358,6 +359,7 @@ void Parser::parse_define_rhs(Lexer& lex, Tplate *tp)
         ExpressionParser ep(NULL);
         ep.parse_expr(lex2, -1, &tp->fargs, NULL, ExpressionParser::kAstMode);
         tp->op_trees = prepare_ast_with_der(ep.vm(), tp->fargs.size() + 1);
+        tp->make_bytecode();
 
         tp->create = &create_CustomFunction;
     }
@@ -483,6 +485,11 @@ void Parser::parse_fit_args(Lexer& lex, vector<Token>& args)
         } else if (name == "history") {
             args.push_back(t);
             args.push_back(read_and_calc_expr(lex));
+        } else if (name == "multistart") {
+            args.push_back(t);
+            args.push_back(read_and_calc_expr(lex));
+            while (lex.peek_token().type == kTokenDataset)
+                args.push_back(lex.get_token());
         } else
             lex.throw_syntax_error("unexpected name after `fit'");
     }
@@ -491,6 +498,13 @@ void Parser::parse_fit_args(Lexer& lex, vector<Token>& args)
         args.push_back(t);
         while (lex.peek_token().type == kTokenDataset)
             args.push_back(lex.get_token());
+    }
+    // +n_iter @n*
+    else if (t.type == kTokenPlus) {
+        args.push_back(t);
+        args.push_back(lex.get_expected_token(kTokenNumber));
+        while (lex.peek_token().type == kTokenDataset)
+            args.push_back(lex.get_token());
     } else // no args
         lex.go_back(t);
 }
@@ -498,6 +512,14 @@ void Parser::parse_fit_args(Lexer& lex, vector<Token>& args)
 // [Funcname '='] Uname ['(' kwarg % ',' ')'] [range]
 void Parser::parse_guess_args(Lexer& lex, vector<Token>& args)
 {
+    if (lex.peek_token().type == kTokenLname &&
+            lex.peek_token().as_string() == "all") {
+        args.push_back(lex.get_token()); // guess all Type
+        args.push_back(lex.get_expected_token(kTokenCname));
+        parse_guess_kwargs(lex, args);
+        parse_real_range(lex, args);
+        return;
+    }
     Token t = lex.get_expected_token(kTokenCname, kTokenFuncname);
     if (t.type == kTokenFuncname) {
         args.push_back(t);
@@ -506,6 +528,12 @@ void Parser::parse_guess_args(Lexer& lex, vector<Token>& args)
     } else
         args.push_back(nop());
     args.push_back(t);
+    parse_guess_kwargs(lex, args);
+    parse_real_range(lex, args);
+}
+
+void Parser::parse_guess_kwargs(Lexer& lex, vector<Token>& args)
+{
     if (lex.peek_token().type == kTokenOpen) {
         lex.get_expected_token(kTokenOpen);
         Token t2 = lex.get_token_if(kTokenClose);
@@ -516,7 +544,6 @@ void Parser::parse_guess_args(Lexer& lex, vector<Token>& args)
             t2 = lex.get_expected_token(kTokenComma, kTokenClose);
         }
     }
-    parse_real_range(lex, args);
 }
 
 static
@@ -564,13 +591,21 @@ void Parser::parse_one_info_arg(Lexer& lex, vector<Token>& args)
             while (lex.peek_token().type == kTokenDataset)
                 args.push_back(lex.get_token());
             args.push_back(nop()); // separator
-        } else if (word == "confidence") {
+        } else if (word == "confidence" || word == "confidence_profile") {
             while (lex.peek_token().type == kTokenNop)
                 lex.throw_syntax_error("specify level, e.g. confidence 95");
             args.push_back(lex.get_expected_token(kTokenNumber));
             while (lex.peek_token().type == kTokenDataset)
                 args.push_back(lex.get_token());
             args.push_back(nop()); // separator
+        } else if (word == "errors_bootstrap" || word == "errors_montecarlo") {
+            if (lex.peek_token().type == kTokenNop)
+                lex.throw_syntax_error("specify number of samples, e.g. "
+                                       + word + " 200");
+            args.push_back(lex.get_expected_token(kTokenNumber));
+            while (lex.peek_token().type == kTokenDataset)
+                args.push_back(lex.get_token());
+            args.push_back(nop()); // separator
         } else if (word == "refs") {
             args.push_back(lex.get_expected_token(kTokenVarname));
         } else if (word == "prop") {
@@ -580,14 +615,17 @@ void Parser::parse_one_info_arg(Lexer& lex, vector<Token>& args)
                token.type == kTokenVarname) {
         args.push_back(token);
     }
-    // handle [@n.]F/Z['['expr']']
-    else if ((token.type == kTokenUletter &&
-                                (*token.str == 'F' || *token.str == 'Z'))
+    // handle [@n.]F/Z/R['['expr']']
+    else if ((token.type == kTokenUletter && (*token.str == 'F' ||
+                                *token.str == 'Z' || *token.str == 'R'))
              || token.type == kTokenDataset) {
         args.push_back(token);
         if (token.type == kTokenDataset) {
             lex.get_expected_token(kTokenDot); // discard '.'
-            args.push_back(lex.get_expected_token("F", "Z"));
+            Token t = lex.get_expected_token(kTokenUletter);
+            if (*t.str != 'F' && *t.str != 'Z' && *t.str != 'R')
+                lex.throw_syntax_error("expected F, Z or R after @n.");
+            args.push_back(t);
         }
         if (lex.peek_token().type == kTokenLSquare) {
             lex.get_token(); // discard '['
@@ -725,12 +763,24 @@ void Parser::parse_fz(Lexer& lex, Command &cmd)
     Token t = lex.get_token();
     // F=..., F+=...
     // ('='|'+=') (0 | %f | Type(...) | copy(%f) | F | copy(F)) % '+'
+    // R can be also assigned a dataset: R = @n
     if (t.type == kTokenAssign || t.type == kTokenAddAssign) {
         cmd.type = kCmdChangeModel;
         cmd.args.push_back(t);
+        bool is_r = (*cmd.args[1].str == 'R');
         for (;;) {
             const Token& p = lex.peek_token();
-            if (p.type == kTokenCname) {     // Type(...)
+            if (is_r && p.type == kTokenDataset) {
+                Token ds = lex.get_token();
+                if (lex.peek_token().type == kTokenDot) { // @n.F
+                    lex.go_back(ds);
+                    parse_func_id(lex, cmd.args, true);
+                } else {                                  // @n
+                    cmd.args.push_back(ds);
+                    cmd.args.push_back(nop());
+                    cmd.args.push_back(nop());
+                }
+            } else if (p.type == kTokenCname) {     // Type(...)
                 parse_assign_func(lex, cmd.args);
             } else if (p.as_string() == "0") { // 0
                 cmd.args.push_back(lex.get_token());
@@ -851,7 +901,12 @@ void Parser::parse_command(Lexer& lex, Command& cmd)
             cmd.args.push_back(lex.get_rest_of_line());
         } else if (is_command(token, "def","ine")) {
             cmd.type = kCmdDefine;
-            cmd.defined_tp = parse_define_args(lex);
+            if (lex.peek_token().type == kTokenLname &&
+                    lex.peek_token().as_string() == "plugin") {
+                lex.get_token(); // discard "plugin"
+                cmd.args.push_back(lex.get_word_token());
+            } else
+                cmd.defined_tp = parse_define_args(lex);
         } else if (is_command(token, "del","ete")) {
             if (lex.peek_token().type == kTokenOpen) {
                 cmd.type = kCmdDeleteP;
@@ -928,9 +983,9 @@ void Parser::parse_command(Lexer& lex, Command& cmd)
         }
     } else if (token.type == kTokenUletter) {
         const char c = *token.str;
-        if (c == 'F' || c == 'Z') {
+        if (c == 'F' || c == 'Z' || c == 'R') {
             cmd.args.push_back(nop()); // dataset
-            cmd.args.push_back(token); // F/Z
+            cmd.args.push_back(token); // F/Z/R
             parse_fz(lex, cmd);
         } else if (c == 'M') {
             cmd.type = kCmdResizeP;
@@ -987,11 +1042,11 @@ void Parser::parse_command(Lexer& lex, Command& cmd)
         cmd.args.push_back(token); // dataset
         lex.get_token(); // discard '.'
         string arg = lex.peek_token().as_string();
-        if (arg == "F" || arg == "Z") {
-            cmd.args.push_back(lex.get_token()); // F/Z
+        if (arg == "F" || arg == "Z" || arg == "R") {
+            cmd.args.push_back(lex.get_token()); // F/Z/R
             parse_fz(lex, cmd);
         } else
-            lex.throw_syntax_error("@n. must be followed by F or Z");
+            lex.throw_syntax_error("@n. must be followed by F, Z or R");
     } else if (token.type == kTokenDataset &&
              lex.peek_token().type == kTokenLT) {
         cmd.type = kCmdLoad;
@@ -118,6 +118,7 @@ private:
     void parse_real_range(Lexer& lex, std::vector<Token>& args);
     void parse_func_id(Lexer& lex, std::vector<Token>& args, bool accept_fz);
     void parse_guess_args(Lexer& lex, std::vector<Token>& args);
+    void parse_guess_kwargs(Lexer& lex, std::vector<Token>& args);
     void parse_one_info_arg(Lexer& lex, std::vector<Token>& args);
     void parse_fit_args(Lexer& lex, std::vector<Token>& args);
 };
@@ -42,8 +42,10 @@ string get_file_basename(const string& path)
 
 Data::Data(BasicContext* ctx, Model *model)
         : ctx_(ctx), model_(model),
-          x_step_(0.), has_sigma_(false), xps_source_energy_(0.)
+          x_step_(0.), has_sigma_(false), all_active_(true),
+          xps_source_energy_(0.)
 {
+    model_->set_data_step(&x_step_);
 }
 
 Data::~Data()
@@ -58,7 +60,7 @@ string Data::get_info() const
     if (p_.empty())
         s = "No data points.";
     else
-        s = S(p_.size()) + " points, " + S(active_.size()) + " active.";
+        s = S(p_.size()) + " points, " + S(get_n()) + " active.";
     if (!spec_.path.empty())
         s += "\nFilename: " + spec_.path;
     if (spec_.x_col != LoadSpec::NN || spec_.y_col != LoadSpec::NN ||
@@ -70,7 +72,7 @@ string Data::get_info() const
         s += ", " + S(spec_.sig_col);
     if (!title_.empty())
         s += "\nData title: " + title_;
-    if (active_.size() != p_.size())
+    if (!all_active_)
         s += "\nActive data range: " + range_as_string();
     return s;
 }
@@ -82,6 +84,7 @@ void Data::clear()
     title_ = "";
     p_.clear();
     x_step_ = 0;
+    all_active_ = true;
     active_.clear();
     has_sigma_ = false;
     xps_source_energy_ = 0.;
@@ -90,7 +93,8 @@ void Data::clear()
 bool Data::completely_empty() const
 {
     return is_empty() && get_title().empty() &&
-           model()->get_ff().empty() && model()->get_zz().empty();
+           model()->get_ff().empty() && model()->get_zz().empty() &&
+           !model()->has_convolution();
 }
 
 
@@ -145,6 +149,12 @@ void Data::set_points(const vector<Point> &p)
     after_transform();
 }
 
+void Data::take_points(vector<Point> &p)
+{
+    p_.swap(p);
+    after_transform();
+}
+
 void Data::revert()
 {
     if (spec_.path.empty())
@@ -190,13 +200,24 @@ void Data::load_data_sum(const vector<const Data*>& dd, const string& op)
 void Data::add_one_point(realt x, realt y, realt sigma)
 {
     Point pt(x, y, sigma);
-    vector<Point>::iterator pi = upper_bound(p_.begin(), p_.end(), pt);
-    int idx = pi - p_.begin();
-    p_.insert(pi, pt);
-    vector<int>::iterator ai = lower_bound(active_.begin(), active_.end(), idx);
-    for (vector<int>::iterator i = ai; i != active_.end(); ++i)
-        *i += 1;
-    active_.insert(upper_bound(active_.begin(), active_.end(), idx), idx);
+    int idx = p_.size();
+    if (p_.empty() || !(pt < p_.back())) {
+        // appending (e.g. data acquired live) - amortized O(1)
+        p_.push_back(pt);
+        if (!all_active_)
+            active_.push_back(idx);
+    } else {
+        vector<Point>::iterator pi = upper_bound(p_.begin(), p_.end(), pt);
+        idx = pi - p_.begin();
+        p_.insert(pi, pt);
+        if (!all_active_) {
+            vector<int>::iterator ai = lower_bound(active_.begin(),
+                                                   active_.end(), idx);
+            for (vector<int>::iterator i = ai; i != active_.end(); ++i)
+                *i += 1;
+            active_.insert(ai, idx);
+        }
+    }
     // (fast) x_step_ update
     if (p_.size() < 2)
         x_step_ = 0.;
@@ -215,16 +236,48 @@ void Data::add_one_point(realt x, realt y, realt sigma)
     }
 }
 
+void Data::add_points(const vector<realt>& x, const vector<realt>& y,
+                      const vector<realt>& sigma)
+{
+    assert(x.size() == y.size() && sigma.size() == y.size());
+    if (x.empty())
+        return;
+    bool in_order = p_.empty() || !(x[0] < p_.back().x);
+    for (size_t i = 1; i < x.size() && in_order; ++i)
+        if (x[i] < x[i-1])
+            in_order = false;
+    if (in_order) {
+        for (size_t i = 0; i != x.size(); ++i)
+            add_one_point(x[i], y[i], sigma[i]);
+    } else {
+        // inserting points one by one would be O(n) per point
+        for (size_t i = 0; i != x.size(); ++i)
+            p_.push_back(Point(x[i], y[i], sigma[i]));
+        stable_sort(p_.begin(), p_.end());
+        find_step();
+        update_active_p();
+    }
+}
+
 void Data::update_active_for_one_point(int idx)
 {
+    // this function is called only after switching the active flag
+    if (all_active_) {
+        assert(!p_[idx].is_active);
+        update_active_p();
+        return;
+    }
     vector<int>::iterator a = lower_bound(active_.begin(), active_.end(), idx);
     bool present = (a < active_.end() && *a == idx);
-    // this function is called only after switching the active flag
     assert(present != p_[idx].is_active);
     if (present)
         active_.erase(a);
     else
         active_.insert(a, idx);
+    if (active_.size() == p_.size()) {
+        all_active_ = true;
+        vector<int>().swap(active_); // free memory
+    }
 }
 
 // the same as replace_all(options, "_", "-")
@@ -387,8 +440,17 @@ void Data::update_active_p()
     // pre: p_.x sorted
     // post: active_ sorted
 {
+    int n_active = 0;
+    v_foreach (Point, i, p_)
+        if (i->is_active)
+            ++n_active;
+    all_active_ = (n_active == size(p_));
+    if (all_active_) {
+        vector<int>().swap(active_); // free memory
+        return;
+    }
     active_.clear();
-    active_.reserve(p_.size());
+    active_.reserve(n_active);
     for (int i = 0; i < size(p_); i++)
         if (p_[i].is_active)
             active_.push_back(i);
@@ -398,21 +460,21 @@ void Data::update_active_p()
 //FIXME to remove it or to leave it?
 string Data::range_as_string() const
 {
-    if (active_.empty()) {
+    if (get_n() == 0) {
         ctx_->ui()->warn("File not loaded or all points inactive.");
         return "[]";
     }
-    vector<Point>::const_iterator old_p = p_.begin() + active_[0];
+    vector<Point>::const_iterator old_p = p_.begin() + active_idx(0);
     double left =  old_p->x;
     string s = "[" + S (left) + " : ";
-    for (vector<int>::const_iterator i = active_.begin() + 1;
-                                                    i != active_.end(); ++i) {
-        if (p_.begin() + *i != old_p + 1) {
+    for (int n = 1; n < get_n(); ++n) {
+        int idx = active_idx(n);
+        if (p_.begin() + idx != old_p + 1) {
             double right = old_p->x;
-            left = p_[*i].x;
+            left = p_[idx].x;
             s += S(right) + "] + [" + S(left) + " : ";
         }
-        old_p = p_.begin() + *i;
+        old_p = p_.begin() + idx;
     }
     double right = old_p->x;
     s += S(right) + "]";
@@ -464,6 +526,8 @@ std::pair<int,int> Data::get_index_range(const RealRange& range) const
     //pre: p_.x is sorted, active_ is sorted
     int p1 = lower_bound(p_.begin(), p_.end(), Point(range.lo,0)) - p_.begin();
     int p2 = upper_bound(p_.begin(), p_.end(), Point(range.hi,0)) - p_.begin();
+    if (all_active_)
+        return std::make_pair(p1, std::min(p2 + 1, size(p_)));
     int a1 = lower_bound(active_.begin(), active_.end(), p1) - active_.begin();
     int a2 = upper_bound(active_.begin(), active_.end(), p2) - active_.begin();
     return std::make_pair(a1, a2);
@@ -44,12 +44,16 @@ public :
     //void load_data_sum(const std::vector<const Data*>& dd,
     //                   const std::string& op);
     void set_points(const std::vector<Point>& p);
+    /// like set_points(), but swaps p with the points (no copying)
+    void take_points(std::vector<Point>& p);
     void clear();
     void add_one_point(realt x, realt y, realt sigma);
-    realt get_x(int n) const { return p_[active_[n]].x; }
-    realt get_y(int n) const { return p_[active_[n]].y; }
-    realt get_sigma (int n) const { return p_[active_[n]].sigma; }
-    int get_n() const { return active_.size(); }
+    void add_points(const std::vector<realt>& x, const std::vector<realt>& y,
+                    const std::vector<realt>& sigma);
+    realt get_x(int n) const { return p_[active_idx(n)].x; }
+    realt get_y(int n) const { return p_[active_idx(n)].y; }
+    realt get_sigma (int n) const { return p_[active_idx(n)].sigma; }
+    int get_n() const { return all_active_ ? p_.size() : active_.size(); }
     std::vector<realt> get_xx() const;
     bool is_empty() const { return p_.empty(); }
     bool completely_empty() const;
@@ -70,7 +74,7 @@ public :
     // quick change in active points bookkeeping
     void update_active_for_one_point(int idx);
     void append_point() { size_t n = p_.size(); p_.resize(n+1);
-                                                active_.push_back(n); }
+                          if (!all_active_) active_.push_back(n); }
     // return points at x (if any) or (usually) after it.
     std::vector<Point>::const_iterator get_point_at(double x) const;
     double get_x_min() const;
@@ -93,9 +97,14 @@ private:
     double x_step_; // 0.0 if not fixed;
     bool has_sigma_;
     std::vector<Point> p_;
+    // If all points are active (the usual case) active_ is empty,
+    // to save memory. Otherwise it has indices of active points.
+    bool all_active_;
     std::vector<int> active_;
     double xps_source_energy_;
 
+    /// index in p_ of the n-th active point
+    int active_idx(int n) const { return all_active_ ? n : active_[n]; }
     void post_load();
     void verify_options(const xylib::DataSet* ds, const std::string& options);
     DISALLOW_COPY_AND_ASSIGN(Data);
@@ -79,6 +79,13 @@ const char* function_name(int op)
         case OP_DT_SUM_SAME_X: return "sum_same_x";
         case OP_DT_AVG_SAME_X: return "avg_same_x";
         case OP_DT_SHIRLEY_BG: return "shirley_bg";
+        case OP_DT_FFT_RE: return "fft_re";
+        case OP_DT_FFT_IM: return "fft_im";
+        case OP_DT_FFT_AMP: return "fft_amp";
+        case OP_DT_IFFT_RE: return "ifft_re";
+        case OP_DT_IFFT_IM: return "ifft_im";
+        case OP_DT_LOWPASS: return "lowpass";
+        case OP_DT_DECONVOLVE: return "deconvolve";
         // 2-args functions
         case OP_MOD: return "mod";
         case OP_MIN2: return "min2";
@@ -127,6 +134,9 @@ int get_function_narg(int op)
         case OP_DT_SUM_SAME_X:
         case OP_DT_AVG_SAME_X:
         case OP_DT_SHIRLEY_BG:
+        case OP_DT_FFT_RE:
+        case OP_DT_FFT_IM:
+        case OP_DT_FFT_AMP:
             return 1;
         // 2-args functions
         case OP_MOD:
@@ -137,7 +147,13 @@ int get_function_narg(int op)
         case OP_DVOIGT_DY:
         case OP_RANDNORM:
         case OP_RANDU:
+        case OP_DT_IFFT_RE:
+        case OP_DT_IFFT_IM:
+        case OP_DT_LOWPASS:
             return 2;
+        // 3-args functions
+        case OP_DT_DECONVOLVE:
+            return 3;
         // Fityk functions
         case OP_FUNC:
         case OP_SUM_F:
@@ -819,6 +835,20 @@ void ExpressionParser::parse_expr(Lexer& lex, int default_ds,
                         put_function(OP_DT_AVG_SAME_X);
                     else if (mode == kDatasetTrMode && word == "shirley_bg")
                         put_function(OP_DT_SHIRLEY_BG);
+                    else if (mode == kDatasetTrMode && word == "fft_re")
+                        put_function(OP_DT_FFT_RE);
+                    else if (mode == kDatasetTrMode && word == "fft_im")
+                        put_function(OP_DT_FFT_IM);
+                    else if (mode == kDatasetTrMode && word == "fft_amp")
+                        put_function(OP_DT_FFT_AMP);
+                    else if (mode == kDatasetTrMode && word == "ifft_re")
+                        put_function(OP_DT_IFFT_RE);
+                    else if (mode == kDatasetTrMode && word == "ifft_im")
+                        put_function(OP_DT_IFFT_IM);
+                    else if (mode == kDatasetTrMode && word == "lowpass")
+                        put_function(OP_DT_LOWPASS);
+                    else if (mode == kDatasetTrMode && word == "deconvolve")
+                        put_function(OP_DT_DECONVOLVE);
 
                     else
                         lex.throw_syntax_error("unknown function: " + word);
@@ -0,0 +1,255 @@
+// This file is part of fityk program. Copyright 2001-2013 Marcin Wojdyr
+// Licence: GNU General Public License ver. 2+
+
+#define BUILDING_LIBFITYK
+#include "fft.h"
+
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <map>
+
+#include "common.h"
+
+using namespace std;
+
+namespace fityk {
+
+int fft_size_pow2(int n)
+{
+    int size = 1;
+    while (size < n)
+        size *= 2;
+    return size;
+}
+
+FFTPlan::FFTPlan(int n) : n_(n), sub_(NULL)
+{
+    assert(n > 0);
+    vector<int> radices;
+    int rest = n;
+    while (rest % 4 == 0) {
+        radices.push_back(4);
+        rest /= 4;
+    }
+    for (int p = 2; p <= kMaxRadix && rest > 1; ++p)
+        while (rest % p == 0) {
+            radices.push_back(p);
+            rest /= p;
+        }
+
+    if (rest != 1) {
+        // Bluestein: X_k = c_k sum_j (x_j c_j) conj(c_{k-j}),
+        // where c_k = exp(-i pi k^2 / n)
+        int m = fft_size_pow2(2 * n - 1);
+        sub_ = &get_pow2(m);
+        chirp_.resize(n);
+        for (int k = 0; k < n; ++k) {
+            // k^2 mod 2n keeps the argument small
+            long long k2 = (long long) k * k % (2LL * n);
+            double angle = -M_PI * k2 / n;
+            chirp_[k] = cplx(cos(angle), sin(angle));
+        }
+        chirp_ft_.assign(m, 0.);
+        chirp_ft_[0] = conj(chirp_[0]);
+        for (int k = 1; k < n; ++k)
+            chirp_ft_[k] = chirp_ft_[m-k] = conj(chirp_[k]);
+        sub_->forward(chirp_ft_);
+        return;
+    }
+
+    int ns = 1;
+    stages_.resize(radices.size());
+    for (size_t i = 0; i != radices.size(); ++i) {
+        Stage& st = stages_[i];
+        st.radix = radices[i];
+        st.ns = ns;
+        st.tw.resize(ns * st.radix);
+        for (int j = 0; j < ns; ++j)
+            for (int r = 0; r < st.radix; ++r) {
+                double angle = -2 * M_PI * j * r / (ns * st.radix);
+                st.tw[j*st.radix+r] = cplx(cos(angle), sin(angle));
+            }
+        st.roots.resize(st.radix);
+        for (int k = 0; k < st.radix; ++k) {
+            double angle = -2 * M_PI * k / st.radix;
+            st.roots[k] = cplx(cos(angle), sin(angle));
+        }
+        ns *= st.radix;
+    }
+}
+
+const FFTPlan& FFTPlan::get_pow2(int n)
+{
+    assert(n == fft_size_pow2(n));
+    static map<int, FFTPlan> cache;
+    map<int, FFTPlan>::const_iterator it;
+    bool found;
+    // Only accesses to the map are serialized; its elements are not moved
+    // by insertion.
+#ifdef _OPENMP
+#pragma omp critical(fityk_fft_plan_cache)
+#endif
+    {
+        it = cache.find(n);
+        found = (it != cache.end());
+    }
+    if (!found) {
+        FFTPlan plan(n);
+#ifdef _OPENMP
+#pragma omp critical(fityk_fft_plan_cache)
+#endif
+        it = cache.insert(make_pair(n, plan)).first;
+    }
+    return it->second;
+}
+
+void fft(vector<cplx>& a, bool inverse)
+{
+    int n = a.size();
+    if (n == fft_size_pow2(n))
+        FFTPlan::get_pow2(n).transform(a, inverse);
+    else
+        FFTPlan(n).transform(a, inverse);
+}
+
+void FFTPlan::transform(vector<cplx>& a, bool inverse) const
+{
+    assert((int) a.size() == n_);
+    if (inverse) {
+        // ifft(a) = conj(fft(conj(a)))
+        vm_foreach (cplx, i, a)
+            *i = conj(*i);
+        forward(a);
+        vm_foreach (cplx, i, a)
+            *i = conj(*i);
+    } else
+        forward(a);
+}
+
+// DFT of length r, in place; roots[k] = exp(-2 pi i k / r)
+static void small_dft(cplx *v, int r, const cplx *roots)
+{
+    if (r == 2) {
+        cplx t = v[1];
+        v[1] = v[0] - t;
+        v[0] += t;
+    } else if (r == 4) {
+        cplx s0 = v[0] + v[2], d0 = v[0] - v[2];
+        cplx s1 = v[1] + v[3], d1 = v[1] - v[3];
+        cplx d1i(d1.imag(), -d1.real()); // -i * d1
+        v[0] = s0 + s1;
+        v[1] = d0 + d1i;
+        v[2] = s0 - s1;
+        v[3] = d0 - d1i;
+    } else {
+        cplx t[FFTPlan::kMaxRadix];
+        for (int k = 0; k < r; ++k) {
+            t[k] = v[0];
+            for (int j = 1; j < r; ++j)
+                t[k] += v[j] * roots[j * k % r];
+        }
+        for (int k = 0; k < r; ++k)
+            v[k] = t[k];
+    }
+}
+
+void FFTPlan::forward(vector<cplx>& a) const
+{
+    if (sub_ != NULL) {
+        const int m = sub_->size();
+        vector<cplx> u(m, 0.);
+        for (int k = 0; k < n_; ++k)
+            u[k] = a[k] * chirp_[k];
+        sub_->forward(u);
+        for (int k = 0; k < m; ++k)
+            u[k] = conj(u[k] * chirp_ft_[k]);
+        sub_->forward(u); // inverse, as conj(fft(conj(.)))
+        for (int k = 0; k < n_; ++k)
+            a[k] = chirp_[k] * conj(u[k]) / double(m);
+        return;
+    }
+
+    // Stockham autosort algorithm: each stage reads from one buffer
+    // and writes to the other one, in order, without bit reversal
+    vector<cplx> buf(n_);
+    cplx *in = &a[0], *out = &buf[0];
+    cplx v[kMaxRadix];
+    v_foreach (Stage, st, stages_) {
+        const int r = st->radix;
+        const int stride = n_ / r;
+        for (int j = 0; j < stride; ++j) {
+            const int jm = j % st->ns;
+            const cplx *tw = &st->tw[jm*r];
+            v[0] = in[j];
+            for (int k = 1; k < r; ++k)
+                v[k] = in[j + k*stride] * tw[k];
+            small_dft(v, r, &st->roots[0]);
+            cplx *o = out + (j - jm) * r + jm;
+            for (int k = 0; k < r; ++k)
+                o[k*st->ns] = v[k];
+        }
+        swap(in, out);
+    }
+    if (in != &a[0])
+        copy(in, in + n_, a.begin());
+}
+
+
+KernelConvolution::KernelConvolution(const realt *w, int nk, int na)
+    : nk_(nk), na_(na), w_(w, w + nk)
+{
+    assert(nk > 0);
+    if (nk_ <= kMaxDirectSize || na_ < nk_)
+        return;
+    // circular convolution of size >= na does not wrap around
+    // in the part that is returned
+    int size = fft_size_pow2(na_);
+    wf_.assign(size, 0.);
+    for (int m = 0; m < nk_; ++m)
+        wf_[m] = double(w_[m] / size); // scaling of the inverse FFT
+    fft(wf_, false);
+}
+
+void KernelConvolution::add(const realt *a, int as, realt *out, int os)
+{
+    if (wf_.empty()) {
+        for (int i = 0; i <= na_ - nk_; ++i) {
+            const realt *p = a + (i + nk_ - 1) * as;
+            realt sum = 0.;
+            for (int m = 0; m < nk_; ++m)
+                sum += w_[m] * p[-m*as];
+            out[i*os] += sum;
+        }
+    } else
+        add2(a, NULL, as, out, NULL, os);
+}
+
+void KernelConvolution::add2(const realt *a, const realt *b, int as,
+                             realt *out_a, realt *out_b, int os)
+{
+    if (wf_.empty()) {
+        add(a, as, out_a, os);
+        if (b != NULL)
+            add(b, as, out_b, os);
+        return;
+    }
+    // w is real, so the real and imaginary parts are convolved separately
+    const int size = wf_.size();
+    buf_.resize(size);
+    for (int i = 0; i < na_; ++i)
+        buf_[i] = cplx(a[i*as], b != NULL ? double(b[i*as]) : 0.);
+    fill(buf_.begin() + na_, buf_.end(), 0.);
+    fft(buf_, false);
+    for (int i = 0; i < size; ++i)
+        buf_[i] *= wf_[i];
+    fft(buf_, true);
+    for (int i = 0; i <= na_ - nk_; ++i) {
+        const cplx& c = buf_[i + nk_ - 1];
+        out_a[i*os] += c.real();
+        if (b != NULL)
+            out_b[i*os] += c.imag();
+    }
+}
+
+} // namespace fityk
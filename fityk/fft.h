@@ -0,0 +1,88 @@
+// This file is part of fityk program. Copyright 2001-2013 Marcin Wojdyr
+// Licence: GNU General Public License ver. 2+
+
+/// Fast Fourier transform and convolution with a fixed kernel.
+
+#ifndef FITYK_FFT_H_
+#define FITYK_FFT_H_
+#include <vector>
+#include <complex>
+#include "fityk.h" // realt
+
+namespace fityk {
+
+typedef std::complex<double> cplx;
+
+/// the smallest power of 2 that is >= n
+int fft_size_pow2(int n);
+
+/// Precomputed factorization and twiddle factors for FFT of length n.
+/// Lengths with prime factors up to kMaxRadix are transformed using
+/// mixed-radix Stockham algorithm (radix 4 and 2 for powers of 2),
+/// other lengths using Bluestein's algorithm (chirp-z with power-of-2 FFT).
+class FFTPlan
+{
+public:
+    static const int kMaxRadix = 61;
+
+    explicit FFTPlan(int n);
+    /// returns plan for length n that is a power of 2; such plans are
+    /// cached and never freed (their total size is < 4 times the largest
+    /// length), plans of other lengths are not cached
+    static const FFTPlan& get_pow2(int n);
+
+    int size() const { return n_; }
+    /// in-place transform of a (a.size() == size());
+    /// the inverse transform is not scaled by 1/n
+    void transform(std::vector<cplx>& a, bool inverse) const;
+
+private:
+    struct Stage
+    {
+        int radix;
+        int ns; // product of radices of the previous stages
+        std::vector<cplx> tw; // tw[j*radix+r] = exp(-2 pi i j r / (ns*radix))
+        std::vector<cplx> roots; // exp(-2 pi i k / radix)
+    };
+
+    int n_;
+    std::vector<Stage> stages_;
+    // Bluestein's algorithm
+    const FFTPlan* sub_;         // plan of the padded length
+    std::vector<cplx> chirp_;    // exp(-i pi k^2 / n)
+    std::vector<cplx> chirp_ft_; // FFT of conj(chirp), padded and wrapped
+
+    void forward(std::vector<cplx>& a) const;
+};
+
+/// in-place complex FFT of any length, the plan is cached only for
+/// powers of 2; the inverse transform is not scaled by 1/n
+void fft(std::vector<cplx>& a, bool inverse);
+
+/// Linear convolution of signals with a fixed (short) kernel w:
+///   out[i] += sum_m w[m] * a[i + nk - 1 - m],  i = 0 ... na - nk
+/// i.e. only the part that does not depend on values outside of a
+/// is computed. Kernels with not more than kMaxDirectSize elements
+/// are applied directly, longer ones using FFT.
+class KernelConvolution
+{
+public:
+    static const int kMaxDirectSize = 32;
+
+    /// w has nk elements, convolved signals have na elements
+    KernelConvolution(const realt *w, int nk, int na);
+    /// the convolution of a (strided by as) is added to out (strided by os)
+    void add(const realt *a, int as, realt *out, int os);
+    /// the same as two add() calls, but with one FFT pair
+    void add2(const realt *a, const realt *b, int as,
+              realt *out_a, realt *out_b, int os);
+
+private:
+    int nk_, na_;
+    std::vector<realt> w_;
+    std::vector<cplx> wf_; // FFT of w, if FFT is used
+    std::vector<cplx> buf_;
+};
+
+} // namespace fityk
+#endif
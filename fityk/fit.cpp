@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 
 // Valgrind may not like the way boost::math::erfc_inv is initialized, see
 // https://svn.boost.org/trac/boost/ticket/10005
@@ -27,12 +28,15 @@
 
 #include "logic.h"
 #include "model.h"
+#include "MPstream.h"
 #include "data.h"
 #include "ui.h"
 #include "numfuncs.h"
 #include "settings.h"
 #include "var.h"
 #include "LMfit.h"
+#include "TRfit.h"
+#include "VPfit.h"
 #include "CMPfit.h"
 #include "GAfit.h"
 #include "NMfit.h"
@@ -52,7 +56,8 @@ int count_points(const vector<Data*>& datas)
 
 Fit::Fit(Full *F, const string& m)
     : name(m), F_(F),
-      evaluations_(0), na_(0), last_refresh_time_(0)
+      evaluations_(0), na_(0), resuming_(false), last_refresh_time_(0),
+      has_state_(false)
 {
 }
 
@@ -127,6 +132,310 @@ string Fit::get_cov_info(const vector<Data*>& datas)
     return s;
 }
 
+class ComputeUI
+{
+public:
+    ComputeUI(UserInterface *ui) : ui_(ui) { ui->hint_ui("busy", "1"); }
+    ~ComputeUI() { ui_->hint_ui("busy", ""); }
+private:
+    UserInterface *ui_;
+};
+
+namespace {
+
+// changes numeric option for the lifetime of the object
+class OptionGuard
+{
+public:
+    OptionGuard(SettingsMgr *sm, const string& name, double value)
+        : sm_(sm), name_(name), old_(sm->get_as_number(name))
+        { if (old_ != value) sm_->set_as_number(name_, value); }
+    ~OptionGuard()
+        { if (sm_->get_as_number(name_) != old_)
+              sm_->set_as_number(name_, old_); }
+private:
+    SettingsMgr *sm_;
+    string name_;
+    double old_;
+};
+
+// p-th quantile of sorted data, with linear interpolation
+realt quantile_of_sorted(const vector<realt>& v, double p)
+{
+    double pos = p * (v.size() - 1);
+    int lo = (int) pos;
+    if (lo + 1 >= (int) v.size())
+        return v.back();
+    return v[lo] + (pos - lo) * (v[lo+1] - v[lo]);
+}
+
+} // anonymous namespace
+
+/// Error estimation by refitting synthetic datasets.
+/// Each dataset is the best-fit model plus noise: either residuals
+/// of the fit drawn with replacement (bootstrap), scaled by sqrt(n/dof),
+/// or sigma * N(0,1) (Monte Carlo). Refits use the Levenberg-Marquardt method
+/// and start from the current parameters, which are the optimum.
+/// Returns vectors of all parameters, one for each successful refit.
+vector<vector<realt> > Fit::get_error_samples(const vector<Data*>& datas,
+                                              int n_samples, bool monte_carlo)
+{
+    if (n_samples < 2)
+        throw ExecuteError("at least 2 samples are needed");
+    int dof = get_dof(datas);
+    if (dof <= 0)
+        throw ExecuteError("too few points to estimate errors");
+    const vector<realt> a0 = F_->mgr.parameters();
+    F_->mgr.use_external_parameters(a0);
+
+    // model at all points (active or not) and standardized residuals
+    vector<vector<realt> > yfit(datas.size());
+    vector<realt> resid;
+    for (size_t k = 0; k != datas.size(); ++k) {
+        const vector<Point>& p = datas[k]->points();
+        vector<realt> xx(p.size());
+        for (size_t i = 0; i != p.size(); ++i)
+            xx[i] = p[i].x;
+        yfit[k].resize(p.size(), 0.);
+        datas[k]->model()->compute_model(xx, yfit[k]);
+        for (size_t i = 0; i != p.size(); ++i)
+            if (p[i].is_active)
+                resid.push_back((p[i].y - yfit[k][i]) / p[i].sigma);
+    }
+    // residuals are on average smaller than errors, correct for it
+    double scale = sqrt((double) resid.size() / dof);
+    vm_foreach (realt, r, resid)
+        *r *= scale;
+
+    // Synthetic datasets are refitted as copies, datas are not modified.
+    // Each copy has its own model with the same functions.
+    vector<Data*> copies;
+    for (size_t k = 0; k != datas.size(); ++k) {
+        const Model* orig = datas[k]->model();
+        Model* model = F_->mgr.create_model();
+        model->get_ff() = orig->get_ff();
+        model->get_zz() = orig->get_zz();
+        model->get_rr() = orig->get_rr();
+        model->set_rr_data(orig->get_rr_data(), orig->get_rr_data_source());
+        copies.push_back(new Data(F_, model));
+        vector<Point> p = datas[k]->points();
+        copies.back()->take_points(p);
+    }
+    Fit *lm = F_->fit_manager()->get_method("levenberg_marquardt");
+    vector<vector<realt> > samples;
+    ComputeUI compute_ui(F_->ui());
+    fityk::user_interrupt = 0;
+    try {
+        OptionGuard g1(F_->mutable_settings_mgr(), "verbosity", -1);
+        OptionGuard g2(F_->mutable_settings_mgr(), "fit_replot", 0);
+        for (int n = 0; n < n_samples && !fityk::user_interrupt; ++n) {
+            for (size_t k = 0; k != copies.size(); ++k) {
+                vector<Point>& p = copies[k]->get_mutable_points();
+                for (size_t i = 0; i != p.size(); ++i) {
+                    if (!p[i].is_active)
+                        continue;
+                    realt e = monte_carlo ? rand_gauss()
+                                          : resid[rand() % resid.size()];
+                    p[i].y = yfit[k][i] + e * p[i].sigma;
+                }
+            }
+            vector<realt> a = a0;
+            lm->refit(copies, a);
+            samples.push_back(a);
+        }
+    } catch (...) {
+        purge_all_elements(copies);
+        F_->mgr.use_external_parameters(a0);
+        throw;
+    }
+    purge_all_elements(copies);
+    F_->mgr.use_external_parameters(a0);
+    update_par_usage(datas);
+    return samples;
+}
+
+string Fit::get_error_samples_info(const vector<Data*>& datas, int n_samples,
+                                   bool monte_carlo)
+{
+    const SettingsMgr *sm = F_->settings_mgr();
+    vector<vector<realt> > samples =
+                            get_error_samples(datas, n_samples, monte_carlo);
+    int ns = samples.size();
+    if (ns < 2)
+        throw ExecuteError("interrupted");
+    const vector<realt>& a0 = F_->mgr.parameters();
+    vector<realt> mean(na_, 0.), sd(na_, 0.);
+    for (int j = 0; j < na_; ++j) {
+        for (int n = 0; n < ns; ++n)
+            mean[j] += samples[n][j];
+        mean[j] /= ns;
+        for (int n = 0; n < ns; ++n)
+            sd[j] += (samples[n][j] - mean[j]) * (samples[n][j] - mean[j]);
+        sd[j] = sqrt(sd[j] / (ns - 1));
+    }
+    string s = string(monte_carlo ? "Monte Carlo" : "Bootstrap")
+               + " errors (" + S(ns) + " refits), standard deviation"
+               " and 95% percentile interval:";
+    for (int j = 0; j < na_; ++j) {
+        if (!par_usage_[j])
+            continue;
+        vector<realt> v(ns);
+        for (int n = 0; n < ns; ++n)
+            v[n] = samples[n][j];
+        sort(v.begin(), v.end());
+        s += "\n$" + F_->mgr.gpos_to_var(j)->name + " = "
+             + sm->format_double(a0[j]) + " +- " + sm->format_double(sd[j])
+             + "  [" + sm->format_double(quantile_of_sorted(v, 0.025))
+             + " : " + sm->format_double(quantile_of_sorted(v, 0.975)) + "]";
+    }
+    s += "\nCorrelation matrix\n    ";
+    for (int i = 0; i < na_; ++i)
+        if (par_usage_[i])
+            s += "\t$" + F_->mgr.gpos_to_var(i)->name;
+    for (int i = 0; i < na_; ++i) {
+        if (!par_usage_[i])
+            continue;
+        s += "\n$" + F_->mgr.gpos_to_var(i)->name;
+        for (int j = 0; j < na_; ++j) {
+            if (!par_usage_[j])
+                continue;
+            realt c = 0.;
+            for (int n = 0; n < ns; ++n)
+                c += (samples[n][i] - mean[i]) * (samples[n][j] - mean[j]);
+            c /= (ns - 1);
+            realt d = sd[i] * sd[j];
+            s += "\t" + format1<double,16>("%.4f", d > 0 ? c / d : 0.);
+        }
+    }
+    return s;
+}
+
+namespace {
+
+void shift_along(vector<realt>& a, const vector<realt>& dir, realt t)
+{
+    for (size_t j = 0; j != a.size(); ++j)
+        a[j] += dir[j] * t;
+}
+
+// Returns the value of parameter k at which the profiled WSSR (WSSR minimized
+// over other parameters) reaches wssr_thr, or +/-inf if it is not reached.
+// Going away from the optimum a0, each refit starts from the previous one,
+// with other parameters moved along dir (linear prediction from the
+// covariance matrix at the optimum, dir[k] = 1).
+// sqrt(WSSR - WSSR_min) is nearly linear in a[k], so the crossing point
+// is found by linear interpolation of this value.
+realt profile_limit(Fit *lm, const vector<Data*>& datas,
+                    const vector<realt>& a0, const vector<realt>& dir, int k,
+                    realt wssr0, realt wssr_thr, realt step)
+{
+    const int kMaxExpansions = 10;
+    const int kMaxIterations = 20;
+    const realt g_thr = sqrt(wssr_thr - wssr0);
+    // last point below the threshold, with refitted parameters
+    vector<realt> in_a = a0;
+    realt in_g = 0.;
+    // first point above the threshold
+    realt out_v = 0.;
+    realt out_g = -1.;
+    for (int i = 0; i < kMaxExpansions && out_g < 0; ++i) {
+        vector<realt> a = in_a;
+        shift_along(a, dir, a0[k] + step - in_a[k]);
+        a[k] = a0[k] + step;
+        realt g = sqrt(max(lm->refit(datas, a, k) - wssr0, realt(0.)));
+        if (g >= g_thr) {
+            out_v = a[k];
+            out_g = g;
+        } else {
+            in_a = a;
+            in_g = g;
+            step *= 2;
+        }
+        if (fityk::user_interrupt)
+            throw ExecuteError("interrupted");
+    }
+    if (out_g < 0)
+        return step > 0 ? numeric_limits<realt>::infinity()
+                        : -numeric_limits<realt>::infinity();
+    realt v = out_v;
+    for (int i = 0; i < kMaxIterations; ++i) {
+        v = in_a[k] + (out_v - in_a[k]) * (g_thr - in_g) / (out_g - in_g);
+        vector<realt> a = in_a;
+        shift_along(a, dir, v - in_a[k]);
+        a[k] = v;
+        realt g = sqrt(max(lm->refit(datas, a, k) - wssr0, realt(0.)));
+        if (fabs(g - g_thr) < 1e-3 * g_thr)
+            break;
+        if (g < g_thr) {
+            in_a = a;
+            in_g = g;
+        } else {
+            out_v = v;
+            out_g = g;
+        }
+    }
+    return v;
+}
+
+} // anonymous namespace
+
+/// Profile-likelihood confidence limits. Each parameter is moved away from
+/// the optimum, with other parameters refitted, until WSSR reaches
+/// WSSR_min (1 + t^2 / DoF), where t is the same Student's t quantile
+/// as in get_confidence_limits(). For a linear model both methods give
+/// the same intervals. Returns (lower, upper) pairs for all parameters,
+/// zeros for parameters not used in the model.
+vector<realt> Fit::get_profile_limits(const vector<Data*>& datas,
+                                      double level_percent)
+{
+    // The covariance matrix at the optimum (computed from the Jacobian once)
+    // gives linearized limits, used as initial steps, and directions
+    // in which the other parameters move when the profiled one is changed.
+    vector<double> cov = get_covariance_matrix(datas);
+    int dof = get_dof(datas);
+    const vector<realt> a0 = F_->mgr.parameters();
+    const vector<bool> usage = par_usage_;
+    realt wssr0 = compute_wssr(a0, datas);
+    double level = 1. - level_percent / 100.;
+    boost::math::students_t dist(dof);
+    double t = boost::math::quantile(boost::math::complement(dist, level/2));
+    realt wssr_thr = wssr0 * (1 + t * t / dof);
+    double err_factor = t * sqrt(wssr0 / dof);
+
+    Fit *lm = F_->fit_manager()->get_method("levenberg_marquardt");
+    vector<realt> result(2 * na_, 0.);
+    ComputeUI compute_ui(F_->ui());
+    fityk::user_interrupt = 0;
+    try {
+        OptionGuard g1(F_->mutable_settings_mgr(), "verbosity", -1);
+        OptionGuard g2(F_->mutable_settings_mgr(), "fit_replot", 0);
+        for (int k = 0; k < na_; ++k) {
+            if (!usage[k])
+                continue;
+            realt ckk = cov[na_ * k + k];
+            vector<realt> dir(na_, 0.);
+            dir[k] = 1.;
+            if (ckk > 0)
+                for (int j = 0; j < na_; ++j)
+                    if (usage[j] && j != k)
+                        dir[j] = cov[na_ * j + k] / ckk;
+            realt step = ckk > 0 ? err_factor * sqrt(ckk) : 0.1 * fabs(a0[k]);
+            if (step == 0)
+                step = 1.;
+            result[2*k] = profile_limit(lm, datas, a0, dir, k,
+                                        wssr0, wssr_thr, -step);
+            result[2*k+1] = profile_limit(lm, datas, a0, dir, k,
+                                          wssr0, wssr_thr, step);
+        }
+    } catch (...) {
+        F_->mgr.use_external_parameters(a0);
+        throw;
+    }
+    F_->mgr.use_external_parameters(a0);
+    update_par_usage(datas);
+    return result;
+}
+
 int Fit::compute_deviates(const vector<realt> &A, double *deviates)
 {
     ++evaluations_;
@@ -163,6 +472,61 @@ realt Fit::compute_wssr(const vector<realt> &A,
     return wssr;
 }
 
+/// Approximate WSSR, for exploration of parameter space by derivative-free
+/// methods. Only every screening_stride-th point is evaluated, the sum
+/// is scaled up to all points. See also polish_screened().
+realt Fit::compute_wssr_screening(const vector<realt> &A)
+{
+    int stride = F_->get_settings()->screening_stride;
+    if (stride <= 1)
+        return compute_wssr(A, fitted_datas_);
+    realt wssr = 0;
+    F_->mgr.use_external_parameters(A);
+    v_foreach (Data*, i, fitted_datas_) {
+        const Data* data = *i;
+        int n = data->get_n();
+        int ns = (n + stride - 1) / stride;
+        vector<realt> xx(ns);
+        for (int j = 0; j < ns; ++j)
+            xx[j] = data->get_x(j * stride);
+        vector<realt> yy(ns, 0.);
+        data->model()->compute_model(xx, yy);
+        realt sum = 0;
+        for (int j = 0; j < ns; ++j) {
+            realt dy = (data->get_y(j * stride) - yy[j])
+                       / data->get_sigma(j * stride);
+            sum += dy * dy;
+        }
+        if (ns > 0)
+            wssr += sum * n / ns;
+    }
+    ++evaluations_;
+    return wssr;
+}
+
+/// If WSSR was approximated by compute_wssr_screening(), the best parameters
+/// found are refined with the Levenberg-Marquardt method, using all points
+/// (unless the screening_polish option is off). Returns the exact WSSR.
+realt Fit::polish_screened(vector<realt>* a, realt wssr)
+{
+    if (F_->get_settings()->screening_stride <= 1)
+        return wssr;
+    if (!F_->get_settings()->screening_polish)
+        return compute_wssr(*a, fitted_datas_);
+    Fit *lm = F_->fit_manager()->get_method("levenberg_marquardt");
+    realt exact;
+    try {
+        OptionGuard g1(F_->mutable_settings_mgr(), "verbosity", -1);
+        exact = lm->refit(fitted_datas_, *a);
+        evaluations_ += lm->evaluations_;
+    } catch (ExecuteError&) { // e.g. singular matrix in L-M
+        exact = compute_wssr(*a, fitted_datas_);
+    }
+    F_->msg("Final refinement using all points: WSSR=" +
+            F_->settings_mgr()->format_double(exact));
+    return exact;
+}
+
 //static
 realt Fit::compute_wssr_for_data(const Data* data, bool weigthed)
 {
@@ -247,6 +611,11 @@ void Fit::compute_derivatives(const vector<realt> &A,
     for (int j = 1; j < na_; j++)
         for (int k = 0; k < j; k++)
             alpha[na_ * k + j] = alpha[na_ * j + k];
+    // parameter fixed in refit() can have non-zero derivatives
+    for (int j = 0; j < na_; j++)
+        if (!par_usage_[j])
+            for (int k = 0; k < na_; k++)
+                alpha[na_ * j + k] = alpha[na_ * k + j] = 0.;
 }
 
 //results in alpha and beta
@@ -256,11 +625,15 @@ void Fit::compute_derivatives_for(const Data* data,
 {
     // Iterating over points is tiled to limit memory usage. It's also a little
     // faster than a single loop over all points for large number of points.
+    // But convolution (R) requires calculating F also outside of the tile,
+    // so in this case all points are processed together.
     const int kMaxTileSize = 1024;
+    const int tile_size = data->model()->has_convolution() ? data->get_n()
+                                                            : kMaxTileSize;
     vector<realt> dy_da;
-    for (int tstart = 0; tstart < data->get_n(); tstart += kMaxTileSize) {
+    for (int tstart = 0; tstart < data->get_n(); tstart += tile_size) {
         const int dyn = na_+1;
-        int tsize = min(data->get_n() - tstart, kMaxTileSize);
+        int tsize = min(data->get_n() - tstart, tile_size);
         vector<realt> xx(tsize);
         for (int j = 0; j != tsize; ++j)
             xx[j] = data->get_x(tstart+j);
@@ -320,6 +693,46 @@ int Fit::compute_derivatives_mp_for(const Data* data, int offset,
     return n;
 }
 
+// similar to compute_derivatives_mp(), but the Jacobian is not stored,
+// tiles of rows are passed to the incremental QR factorization
+void Fit::compute_derivatives_qr(const vector<realt> &A,
+                                 const vector<Data*>& datas,
+                                 const vector<int>& ifree, RowBlockQR* qr)
+{
+    ++evaluations_;
+    F_->mgr.use_external_parameters(A);
+    const int kMaxTileSize = 1024;
+    const int dyn = na_+1;
+    const int nfree = ifree.size();
+    vector<realt> dy_da;
+    vector<double> jac, dev;
+    v_foreach (Data*, d, datas) {
+        const Data* data = *d;
+        // as in compute_derivatives_for(), convolution needs all points
+        const int tile_size = data->model()->has_convolution() ? data->get_n()
+                                                                : kMaxTileSize;
+        for (int tstart = 0; tstart < data->get_n(); tstart += tile_size) {
+            int tsize = min(data->get_n() - tstart, tile_size);
+            vector<realt> xx(tsize);
+            for (int i = 0; i != tsize; ++i)
+                xx[i] = data->get_x(tstart+i);
+            vector<realt> yy(tsize, 0.);
+            dy_da.resize(tsize*dyn);
+            fill(dy_da.begin(), dy_da.end(), 0.);
+            data->model()->compute_model_with_derivs(xx, yy, dy_da);
+            jac.resize(tsize*nfree);
+            dev.resize(tsize);
+            for (int i = 0; i != tsize; ++i) {
+                realt inv_sig = 1.0 / data->get_sigma(tstart+i);
+                dev[i] = (data->get_y(tstart+i) - yy[i]) * inv_sig;
+                for (int k = 0; k != nfree; ++k)
+                    jac[k*tsize+i] = -dy_da[i*dyn+ifree[k]] * inv_sig;
+            }
+            qr->add_rows(tsize, &jac[0], &dev[0]);
+        }
+    }
+}
+
 // similar to compute_derivatives(), but adjusted for NLopt interface
 realt Fit::compute_wssr_gradient(const vector<realt> &A,
                                  const vector<Data*>& datas,
@@ -378,17 +791,8 @@ realt Fit::draw_a_from_distribution(int gpos, char distribution, realt mult)
     return F_->mgr.variation_of_a(gpos, dv * mult);
 }
 
-class ComputeUI
-{
-public:
-    ComputeUI(UserInterface *ui) : ui_(ui) { ui->hint_ui("busy", "1"); }
-    ~ComputeUI() { ui_->hint_ui("busy", ""); }
-private:
-    UserInterface *ui_;
-};
-
 /// initialize and run fitting procedure for not more than max_eval evaluations
-void Fit::fit(int max_eval, const vector<Data*>& datas)
+void Fit::fit(int max_eval, const vector<Data*>& datas, bool resume)
 {
     // initialization
     start_time_ = clock();
@@ -411,30 +815,180 @@ void Fit::fit(int max_eval, const vector<Data*>& datas)
     if (F_->get_verbosity() >= 1)
         F_->ui()->mesg("Method: " + name + ". Initial WSSR="
                        + sm->format_double(initial_wssr_));
+    resuming_ = false;
+    if (resume) {
+        if (!can_resume())
+            F_->msg("Method " + name + " can't continue, starting anew.");
+        else if (!has_state_ || state_datas_ != datas || state_a_ != a_orig_
+                 || state_usage_ != par_usage_
+                 || state_stride_ != F_->get_settings()->screening_stride
+                 || fabs(state_wssr_ - initial_wssr_) > 1e-9 * initial_wssr_)
+            F_->msg("Parameters, data or screening_stride changed since "
+                    "the last fit, starting anew.");
+        else
+            resuming_ = true;
+    }
+    has_state_ = false;
 
     // here the work is done
     vector<realt> best_a;
     realt wssr = run_method(&best_a);
+    resuming_ = false;
 
     // finalization
     F_->msg(name + ": " + S(evaluations_) + " evaluations, "
             + format1<double,16>("%.2f", elapsed()) + " s. of CPU time.");
-    if (wssr < initial_wssr_) {
+    finish_fit(a_orig_, initial_wssr_, best_a, wssr);
+    has_state_ = can_resume();
+    state_a_ = F_->mgr.parameters();
+    state_datas_ = datas;
+    state_usage_ = par_usage_;
+    state_stride_ = F_->get_settings()->screening_stride;
+    state_wssr_ = min(wssr, initial_wssr_);
+}
+
+/// Multi-start fitting. The first run starts from the current parameters,
+/// the others from points drawn uniformly from the domains of parameters
+/// (see draw_a_from_distribution()). Runs that end with WSSR that differs
+/// by less than 0.1% are counted as the same local minimum.
+void Fit::multistart(int n_runs, const vector<Data*>& datas)
+{
+    if (n_runs < 1)
+        throw ExecuteError("the number of starting points must be positive");
+    has_state_ = false;
+    // initialization
+    start_time_ = clock();
+    last_refresh_time_ = time(0);
+    ComputeUI compute_ui(F_->ui());
+    update_par_usage(datas);
+    fitted_datas_ = datas;
+    vector<realt> a0 = F_->mgr.parameters();
+    F_->fit_manager()->push_param_history(a0);
+    fityk::user_interrupt = 0;
+    max_eval_ = F_->get_settings()->max_wssr_evaluations;
+    int nu = count(par_usage_.begin(), par_usage_.end(), true);
+    F_->msg("Fitting " + S(nu) + " (of " + S(na_) + ") parameters to "
+            + S(count_points(datas)) + " points, starting from "
+            + S(n_runs) + " points ...");
+    realt wssr0 = compute_wssr(a0, datas);
+    const SettingsMgr *sm = F_->settings_mgr();
+
+    // starting points are drawn before fitting, around the initial values
+    a_orig_ = a0;
+    vector<vector<realt> > starts(n_runs, a0);
+    for (int i = 1; i < n_runs; ++i)
+        for (int j = 0; j < na_; ++j)
+            starts[i][j] = draw_a_from_distribution(j);
+
+    vector<realt> best_a = a0;
+    realt best_wssr = wssr0;
+    vector<realt> minima; // distinct WSSR values, sorted
+    vector<int> hits;     // how many times each minimum was found
+    int total_evaluations = 0;
+    int run = 0;
+    while (run < n_runs) {
+        a_orig_ = starts[run];
+        evaluations_ = 0;
+        initial_wssr_ = compute_wssr(a_orig_, fitted_datas_);
+        best_shown_wssr_ = initial_wssr_;
+        vector<realt> a;
+        realt wssr = run_method(&a);
+        total_evaluations += evaluations_;
+        ++run;
+        if (F_->get_verbosity() >= 1)
+            F_->ui()->mesg("run " + S(run) + "/" + S(n_runs) + ": WSSR="
+                           + sm->format_double(wssr));
+        if (wssr < best_wssr) {
+            best_wssr = wssr;
+            best_a = a;
+        }
+        vector<realt>::iterator m = lower_bound(minima.begin(), minima.end(),
+                                                wssr * (1 - 1e-3));
+        if (m != minima.end() && *m <= wssr * (1 + 1e-3))
+            ++hits[m - minima.begin()];
+        else {
+            hits.insert(hits.begin() + (m - minima.begin()), 1);
+            minima.insert(m, wssr);
+        }
+        double max_time = F_->get_settings()->max_fitting_time;
+        if (fityk::user_interrupt || (max_time > 0 && elapsed() >= max_time))
+            break;
+    }
+
+    // finalization
+    F_->msg(name + ": " + S(run) + " runs, " + S(total_evaluations)
+            + " evaluations, " + format1<double,16>("%.2f", elapsed())
+            + " s. of CPU time.");
+    string info = S(minima.size()) + " distinct minima, WSSR:";
+    for (size_t i = 0; i != minima.size(); ++i)
+        info += " " + sm->format_double(minima[i]) + " (" + S(hits[i]) + "x)";
+    F_->msg(info);
+    finish_fit(a0, wssr0, best_a, best_wssr);
+}
+
+// Common finalization of fit() and multistart(). a0 is already in the
+// parameter history (pushed before fitting); if the fit is better,
+// best_a is pushed as the next item, otherwise a0 is restored.
+void Fit::finish_fit(const vector<realt>& a0, realt wssr0,
+                     const vector<realt>& best_a, realt wssr)
+{
+    const SettingsMgr *sm = F_->settings_mgr();
+    if (wssr < wssr0) {
         F_->fit_manager()->push_param_history(best_a);
         F_->mgr.put_new_parameters(best_a);
-        double percent_change = (wssr - initial_wssr_) / initial_wssr_ * 100.;
+        double percent_change = (wssr - wssr0) / wssr0 * 100.;
         F_->msg("WSSR: " + sm->format_double(wssr) +
                 " (" + S(percent_change) + "%)");
     } else {
         F_->msg("Better fit NOT found (WSSR = " + sm->format_double(wssr)
-                + ", was " + sm->format_double(initial_wssr_) + ")."
+                + ", was " + sm->format_double(wssr0) + ")."
                 "\nParameters NOT changed");
-        F_->mgr.use_external_parameters(a_orig_);
+        F_->mgr.use_external_parameters(a0);
         if (F_->get_settings()->fit_replot)
             F_->ui()->draw_plot(UserInterface::kRepaintImmediately);
     }
 }
 
+realt Fit::refit(const vector<Data*>& datas, vector<realt>& a,
+                 int fixed_gpos)
+{
+    start_time_ = clock();
+    last_refresh_time_ = time(0);
+    has_state_ = false;
+    update_par_usage(datas);
+    if (fixed_gpos != -1) {
+        par_usage_[fixed_gpos] = false;
+        if (count(par_usage_.begin(), par_usage_.end(), true) == 0)
+            return compute_wssr(a, datas);
+    }
+    fitted_datas_ = datas;
+    a_orig_ = a;
+    evaluations_ = 0;
+    max_eval_ = F_->get_settings()->max_wssr_evaluations;
+    initial_wssr_ = compute_wssr(a_orig_, fitted_datas_);
+    best_shown_wssr_ = initial_wssr_;
+    vector<realt> best_a;
+    realt wssr = run_method(&best_a);
+    if (wssr < initial_wssr_) {
+        a = best_a;
+        return wssr;
+    }
+    return initial_wssr_;
+}
+
+realt Fit::update_fit(const vector<Data*>& datas)
+{
+    vector<realt> a = F_->mgr.parameters();
+    realt wssr;
+    {
+        OptionGuard g1(F_->mutable_settings_mgr(), "verbosity", -1);
+        OptionGuard g2(F_->mutable_settings_mgr(), "fit_replot", 0);
+        wssr = refit(datas, a);
+    }
+    F_->mgr.put_new_parameters(a);
+    return wssr;
+}
+
 // sets na_ and par_usage_ based on F_->mgr and datas
 void Fit::update_par_usage(const vector<Data*>& datas)
 {
@@ -552,6 +1106,10 @@ const char* FitManager::method_list[][3] =
 #endif
  { "nelder_mead_simplex", "Nelder-Mead Simplex", "(own implementation)" },
  { "genetic_algorithms", "Genetic Algorithm", "(not really maintained)" },
+ { "trust_region", "Lev-Mar (trust region)",
+                        "with geodesic acceleration and Broyden updates" },
+ { "variable_projection", "Variable projection",
+                        "Lev-Mar with linear parameters eliminated" },
  { NULL, NULL }
 };
 
@@ -577,6 +1135,8 @@ FitManager::FitManager(Full *F)
 #endif
     methods_.push_back(new NMfit(F, next_method()));
     methods_.push_back(new GAfit(F, next_method()));
+    methods_.push_back(new TRfit(F, next_method()));
+    methods_.push_back(new VPfit(F, next_method()));
 }
 
 
@@ -614,34 +1174,100 @@ double FitManager::get_standard_error(const Variable* var) const
 void ParameterHistoryMgr::load_param_history(int item_nr, bool relative)
 {
     if (item_nr == -1 && relative && !param_history_.empty() && //undo
-            param_history_[param_hist_ptr_] != F_->mgr.parameters())
+            get_item(param_hist_ptr_) != F_->mgr.parameters())
         item_nr = 0; // load parameters from param_hist_ptr_
     if (relative)
         item_nr += param_hist_ptr_;
     else if (item_nr < 0)
         item_nr += param_history_.size();
-    if (item_nr < 0 || item_nr >= size(param_history_))
+    if (item_nr < 0 || item_nr >= (int) param_history_.size())
         throw ExecuteError("There is no parameter history item #"
                             + S(item_nr) + ".");
-    F_->mgr.put_new_parameters(param_history_[item_nr]);
+    F_->mgr.put_new_parameters(get_item(item_nr));
     param_hist_ptr_ = item_nr;
 }
 
 bool ParameterHistoryMgr::can_undo() const
 {
     return !param_history_.empty()
-        && (param_hist_ptr_ > 0 || param_history_[0] != F_->mgr.parameters());
+        && (param_hist_ptr_ > 0 || get_item(0) != F_->mgr.parameters());
+}
+
+// keyframe is stored at least every kHistoryKeyframeInterval items,
+// so get_item() applies at most that many differences
+static const int kHistoryKeyframeInterval = 16;
+
+vector<realt> ParameterHistoryMgr::get_item(int n) const
+{
+    assert(n >= 0 && n < (int) param_history_.size());
+    if (n == (int) param_history_.size() - 1)
+        return last_item_;
+    int first = n;
+    while (!param_history_[first].full)
+        --first;
+    vector<realt> aa = param_history_[first].values;
+    for (int i = first + 1; i <= n; ++i) {
+        const HistoryItem& item = param_history_[i];
+        for (size_t j = 0; j != item.idx.size(); ++j)
+            aa[item.idx[j]] = item.values[j];
+    }
+    return aa;
 }
 
 bool ParameterHistoryMgr::push_param_history(const vector<realt>& aa)
 {
     param_hist_ptr_ = param_history_.size() - 1;
-    if (param_history_.empty() || param_history_.back() != aa) {
-        param_history_.push_back(aa);
-        ++param_hist_ptr_;
-        return true;
-    } else
+    if (!param_history_.empty() && last_item_ == aa)
         return false;
+    param_history_.push_back(HistoryItem());
+    HistoryItem& item = param_history_.back();
+    item.full = true;
+    if (param_history_.size() > 1 && last_item_.size() == aa.size()
+            && since_full_ + 1 < kHistoryKeyframeInterval) {
+        for (size_t i = 0; i != aa.size(); ++i)
+            if (aa[i] != last_item_[i])
+                item.idx.push_back(i);
+        // a difference is worth storing only if it is small
+        if (2 * item.idx.size() < aa.size()) {
+            item.full = false;
+            item.values.reserve(item.idx.size());
+            v_foreach (int, i, item.idx)
+                item.values.push_back(aa[*i]);
+        } else
+            item.idx.clear();
+    }
+    if (item.full) {
+        item.values = aa;
+        since_full_ = 0;
+    } else
+        ++since_full_;
+    last_item_ = aa;
+    ++param_hist_ptr_;
+
+    int max_items = F_->get_settings()->max_param_history;
+    while (max_items > 0 && (int) param_history_.size() > max_items)
+        drop_oldest_item();
+    return true;
+}
+
+void ParameterHistoryMgr::drop_oldest_item()
+{
+    if (param_history_.size() > 1 && !param_history_[1].full) {
+        HistoryItem& second = param_history_[1];
+        second.values = get_item(1);
+        second.idx.clear();
+        second.full = true;
+    }
+    param_history_.pop_front();
+    if (param_hist_ptr_ > 0)
+        --param_hist_ptr_;
+}
+
+void ParameterHistoryMgr::clear_param_history()
+{
+    param_history_.clear();
+    last_item_.clear();
+    param_hist_ptr_ = 0;
 }
 
 
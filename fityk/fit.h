@@ -4,6 +4,7 @@
 #ifndef FITYK_FIT_H_
 #define FITYK_FIT_H_
 #include <vector>
+#include <deque>
 #include <string>
 #include <time.h>
 #include "common.h"
@@ -13,6 +14,7 @@ namespace fityk {
 class Data;
 class Full;
 class Variable;
+class RowBlockQR;
 
 int count_points(const std::vector<Data*>& datas);
 
@@ -24,7 +26,12 @@ public:
 
     Fit(Full *F, const std::string& m);
     virtual ~Fit() {}
-    void fit(int max_iter, const std::vector<Data*>& datas);
+    /// if resume is set, continue from the state saved by the previous fit
+    /// (if the method supports it and parameters and data didn't change)
+    void fit(int max_iter, const std::vector<Data*>& datas,
+             bool resume=false);
+    /// run fitting n_runs times from random starting points, keep the best
+    void multistart(int n_runs, const std::vector<Data*>& datas);
     std::string get_goodness_info(const std::vector<Data*>& datas);
     int get_dof(const std::vector<Data*>& datas);
     std::string get_cov_info(const std::vector<Data*>& datas);
@@ -35,6 +42,23 @@ public:
     std::vector<double>
         get_confidence_limits(const std::vector<Data*>& datas,
                               double level_percent);
+    /// parameters fitted to n_samples synthetic datasets, made by resampling
+    /// residuals (bootstrap) or by adding noise to the model (Monte Carlo)
+    std::vector<std::vector<realt> >
+        get_error_samples(const std::vector<Data*>& datas, int n_samples,
+                          bool monte_carlo);
+    std::string get_error_samples_info(const std::vector<Data*>& datas,
+                                       int n_samples, bool monte_carlo);
+    /// profile-likelihood confidence limits, lower and upper for each param.
+    std::vector<realt> get_profile_limits(const std::vector<Data*>& datas,
+                                          double level_percent);
+    /// run the method starting from a, silently; only a is changed.
+    /// Parameter fixed_gpos (if not -1) is kept constant.
+    realt refit(const std::vector<Data*>& datas, std::vector<realt>& a,
+                int fixed_gpos=-1);
+    /// quiet fit that starts from the current parameters and doesn't
+    /// touch the parameter history; for tracking data acquired live
+    realt update_fit(const std::vector<Data*>& datas);
     //const std::vector<Data*>& get_last_dm() const { return fitted_datas_; }
     static realt compute_wssr_for_data (const Data* data, bool weigthed);
     static int compute_deviates_for_data(const Data* data,
@@ -64,7 +88,13 @@ protected:
     int max_eval() const { return max_eval_; }
     const std::vector<bool>& par_usage() const { return par_usage_; }
 
+    // set in fit(); if true, run_method() should continue from the state
+    // saved at the end of the previous run instead of initializing it
+    bool resuming_;
+
     virtual double run_method(std::vector<realt>* best_a) = 0;
+    /// true if run_method() keeps the state needed to continue fitting
+    virtual bool can_resume() const { return false; }
     std::string iteration_info(realt wssr); // changes best_shown_wssr_
     bool common_termination_criteria() const;
     void compute_derivatives(const std::vector<realt> &A,
@@ -73,7 +103,13 @@ protected:
     void compute_derivatives_mp(const std::vector<realt> &A,
                                 const std::vector<Data*>& datas,
                                 double **derivs, double *deviates);
+    void compute_derivatives_qr(const std::vector<realt> &A,
+                                const std::vector<Data*>& datas,
+                                const std::vector<int>& ifree,
+                                RowBlockQR* qr);
     int compute_deviates(const std::vector<realt> &A, double *deviates);
+    realt compute_wssr_screening(const std::vector<realt> &A);
+    realt polish_screened(std::vector<realt>* a, realt wssr);
     realt draw_a_from_distribution(int gpos, char distribution = 'u',
                                    realt mult = 1.);
     void iteration_plot(const std::vector<realt> &A, realt wssr);
@@ -85,8 +121,17 @@ private:
     clock_t start_time_;
     std::vector<bool> par_usage_;
     realt best_shown_wssr_; // for iteration_info()
+    // parameters, datasets and WSSR after the last fit(), for resuming
+    bool has_state_;
+    std::vector<realt> state_a_;
+    std::vector<Data*> state_datas_;
+    std::vector<bool> state_usage_;
+    int state_stride_; // WSSR of saved states depends on screening_stride
+    realt state_wssr_;
 
     double elapsed() const; // CPU time elapsed since the start of fit()
+    void finish_fit(const std::vector<realt>& a0, realt wssr0,
+                    const std::vector<realt>& best_a, realt wssr);
 
     // compute_*_for() does the same as compute_*() but for one dataset
     void compute_derivatives_for(const Data *data,
@@ -98,25 +143,40 @@ private:
 };
 
 /// handles parameter history
+/// Items are stored as differences from the previous item; every few items
+/// (and when the number of parameters changes) the whole vector is stored.
+/// Only the last max_param_history items are kept.
 class FITYK_API ParameterHistoryMgr
 {
 public:
-    ParameterHistoryMgr(Full *F) : F_(F), param_hist_ptr_(0) {}
+    ParameterHistoryMgr(Full *F) : F_(F), since_full_(0), param_hist_ptr_(0) {}
     bool push_param_history(const std::vector<realt>& aa);
-    void clear_param_history() { param_history_.clear(); param_hist_ptr_ = 0; }
+    void clear_param_history();
     int get_param_history_size() const { return param_history_.size(); }
     void load_param_history(int item_nr, bool relative);
-    bool has_param_history_rel_item(int rel_nr) const
-        { return is_index(param_hist_ptr_ + rel_nr, param_history_); }
+    bool has_param_history_rel_item(int rel_nr) const {
+        int n = param_hist_ptr_ + rel_nr;
+        return n >= 0 && n < (int) param_history_.size();
+    }
     bool can_undo() const;
     std::string param_history_info() const;
-    const std::vector<realt>& get_item(int n) const {return param_history_[n];}
+    std::vector<realt> get_item(int n) const;
     int get_active_nr() const { return param_hist_ptr_; }
 protected:
     Full *F_;
 private:
-    std::vector<std::vector<realt> > param_history_; /// old parameter vectors
+    struct HistoryItem
+    {
+        bool full; // values has all parameters (keyframe)
+        std::vector<int> idx; // indices of changed parameters if !full
+        std::vector<realt> values;
+    };
+    std::deque<HistoryItem> param_history_; /// old parameter vectors
+    std::vector<realt> last_item_; /// copy of param_history_.back()
+    int since_full_; /// number of items after the last keyframe
     int param_hist_ptr_; /// points to the current/last parameter vector
+
+    void drop_oldest_item();
 };
 
 /// gives access to fitting methods, enables swithing between them
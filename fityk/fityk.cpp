@@ -19,6 +19,7 @@
 #include "func.h"
 #include "info.h"
 #include "settings.h"
+#include "plugin.h"
 
 using namespace std;
 
@@ -307,6 +308,36 @@ void Fityk::add_point(realt x, realt y, realt sigma, int dataset)
     CATCH_EXECUTE_ERROR
 }
 
+void Fityk::add_points(vector<realt> const& x, vector<realt> const& y,
+                       vector<realt> const& sigma, int dataset)
+                                                          throw(ExecuteError)
+{
+    try {
+        if (y.size() != x.size() || sigma.size() != x.size())
+            throw ExecuteError("add_points: arrays of different sizes");
+        priv_->dk.data(hd(priv_, dataset))->add_points(x, y, sigma);
+    }
+    CATCH_EXECUTE_ERROR
+}
+
+void Fityk::define_callback_type(string const& name, string const& params,
+                                 FuncTypeCallback* callback, int traits,
+                                 string const& defvals)  throw(ExecuteError)
+{
+    // the type takes ownership even if it can't be defined
+    boost::shared_ptr<FuncTypeCallback> cb(callback);
+    try {
+        priv_->get_tpm()->define(make_callback_tplate(name, params, defvals,
+                                                      traits, cb));
+    }
+    catch (SyntaxError& e) { // from parsing defvals
+        last_error_ = string("ExecuteError: ") + e.what();
+        if (throws_)
+            throw ExecuteError(e.what());
+    }
+    CATCH_EXECUTE_ERROR
+}
+
 vector<Point> const& Fityk::get_data(int dataset)  throw(ExecuteError)
 {
     static const vector<Point> empty;
@@ -429,6 +460,31 @@ vector<vector<realt> > Fityk::get_covariance_matrix(int dataset)
     return vector<vector<realt> >();
 }
 
+vector<vector<realt> > Fityk::get_error_samples(int n, bool monte_carlo,
+                                                int dataset)
+                                                        throw(ExecuteError)
+{
+    try {
+        vector<Data*> dss = get_datasets_(priv_, dataset);
+        return priv_->get_fit()->get_error_samples(dss, n, monte_carlo);
+    }
+    CATCH_EXECUTE_ERROR
+    return vector<vector<realt> >();
+}
+
+realt Fityk::update_fit(int dataset)  throw(ExecuteError)
+{
+    try {
+        vector<Data*> dss = get_datasets_(priv_, dataset);
+        Fit *lm = priv_->fit_manager()->get_method("levenberg_marquardt");
+        realt wssr = lm->update_fit(dss);
+        priv_->outdated_plot();
+        return wssr;
+    }
+    CATCH_EXECUTE_ERROR
+    return 0.;
+}
+
 realt* Fityk::get_covariance_matrix_as_array(int dataset)
 {
     try {
@@ -127,6 +127,27 @@ protected:
     Func(const std::string name_) : name(name_) {}
 };
 
+/// function type calculated by the host program (e.g. in Python or Lua),
+/// registered with Fityk::define_callback_type().
+/// Each method is called once for all points (not once per point).
+class FITYK_API FuncTypeCallback
+{
+public:
+    virtual ~FuncTypeCallback() {}
+
+    /// y[i] += f(x[i]) for i = 0,...,n-1; p has one value per parameter
+    virtual void value(const realt* p, int n, const realt* x, realt* y) = 0;
+
+    /// y[i] += f(x[i]), dy_dp[i*np+k] = df/dp[k](x[i]) (np: number of
+    /// parameters), dy_dx[i] = df/dx(x[i]).
+    /// Returns false if not implemented, derivatives are then calculated
+    /// numerically using value().
+    virtual bool value_deriv(const realt* /*p*/, int /*n*/,
+                             const realt* /*x*/, realt* /*y*/,
+                             realt* /*dy_dp*/, realt* /*dy_dx*/)
+                                                    { return false; }
+};
+
 /// special dataset magic numbers used only in this API
 enum {
     /// all datasets, used to get statistics for all datasets together
@@ -198,8 +219,27 @@ public:
     void add_point(realt x, realt y, realt sigma, int dataset=DEFAULT_DATASET)
                                                      throw(ExecuteError);
 
+    /// add data points to dataset; appending points with increasing x
+    /// (e.g. during data acquisition) takes amortized constant time per point
+    void add_points(std::vector<realt> const& x,
+                    std::vector<realt> const& y,
+                    std::vector<realt> const& sigma,
+                    int dataset=DEFAULT_DATASET)  throw(ExecuteError);
+
     // @}
 
+    /// define function type calculated by callback, e.g.
+    /// define_callback_type("MyPeak", "height,center,hwhm", cb, 2);
+    /// params and defvals are comma-separated, as in FitykPluginType;
+    /// traits: 1 - linear, 2 - peak, 4 - sigmoid (used by guess).
+    /// Takes ownership of callback, it's deleted with the type.
+    void define_callback_type(std::string const& name,
+                              std::string const& params,
+                              FuncTypeCallback* callback,
+                              int traits=0,
+                              std::string const& defvals="")
+                                                     throw(ExecuteError);
+
     /// @name (alternative to exceptions) handling of program errors
     // @{
 
@@ -331,6 +371,19 @@ public:
     /// get covariance matrix (for given dataset or for all datasets)
     std::vector<std::vector<realt> >
     get_covariance_matrix(int dataset=ALL_DATASETS)  throw(ExecuteError);
+
+    /// get parameters refitted to n synthetic datasets, generated
+    /// by resampling residuals (bootstrap) or by adding Gaussian noise
+    /// (monte_carlo); one vector of all parameters per refit
+    std::vector<std::vector<realt> >
+    get_error_samples(int n, bool monte_carlo=false,
+                      int dataset=ALL_DATASETS)  throw(ExecuteError);
+
+    /// quick Levenberg-Marquardt fit, warm-started from the current
+    /// parameters, without messages and without changing parameter history;
+    /// meant to be called after each add_points() to follow changing data.
+    /// Returns WSSR.
+    realt update_fit(int dataset=ALL_DATASETS)  throw(ExecuteError);
     // @}
 
     /// UiApi contains functions used by CLI and may be used to implement
@@ -52,24 +52,32 @@ void Function::do_precomputations(const vector<Variable*> &variables)
     this->more_precomputations();
 }
 
-void Function::erased_parameter(int k)
+void Function::erased_parameters(const vector<int>& new_gpos)
 {
     vm_foreach (Multi, i, multi_)
-        if (i->p > k)
-            -- i->p;
+        i->p = new_gpos[i->p];
 }
 
 
-void Function::calculate_value(const vector<realt> &x, vector<realt> &y) const
+void Function::get_nonzero_idx_range(const vector<realt> &x,
+                                     int &first, int &last) const
 {
     realt left, right;
     double cut_level = settings_->function_cutoff;
     if (cut_level != 0. && get_nonzero_range(cut_level, left, right)) {
-        int first = lower_bound(x.begin(), x.end(), left) - x.begin();
-        int last = upper_bound(x.begin(), x.end(), right) - x.begin();
-        this->calculate_value_in_range(x, y, first, last);
-    } else
-        this->calculate_value_in_range(x, y, 0, x.size());
+        first = lower_bound(x.begin(), x.end(), left) - x.begin();
+        last = upper_bound(x.begin(), x.end(), right) - x.begin();
+    } else {
+        first = 0;
+        last = x.size();
+    }
+}
+
+void Function::calculate_value(const vector<realt> &x, vector<realt> &y) const
+{
+    int first, last;
+    get_nonzero_idx_range(x, first, last);
+    this->calculate_value_in_range(x, y, first, last);
 }
 
 realt Function::calculate_value(realt x) const
@@ -85,14 +93,9 @@ void Function::calculate_value_deriv(const vector<realt> &x,
                                      vector<realt> &dy_da,
                                      bool in_dx) const
 {
-    realt left, right;
-    double cut_level = settings_->function_cutoff;
-    if (cut_level != 0. && get_nonzero_range(cut_level, left, right)) {
-        int first = lower_bound(x.begin(), x.end(), left) - x.begin();
-        int last = upper_bound(x.begin(), x.end(), right) - x.begin();
-        this->calculate_value_deriv_in_range(x, y, dy_da, in_dx, first, last);
-    } else
-        this->calculate_value_deriv_in_range(x, y, dy_da, in_dx, 0, x.size());
+    int first, last;
+    get_nonzero_idx_range(x, first, last);
+    this->calculate_value_deriv_in_range(x, y, dy_da, in_dx, first, last);
 }
 
 int Function::max_param_pos() const
@@ -48,10 +48,14 @@ public:
                                std::vector<realt> &y,
                                std::vector<realt> &dy_da,
                                bool in_dx=false) const;
+    /// sets [first, last) to the range of indices in sorted x where
+    /// the function is not negligible (depends on the function_cutoff option)
+    void get_nonzero_idx_range(const std::vector<realt> &x,
+                               int &first, int &last) const;
 
     void do_precomputations(const std::vector<Variable*> &variables);
     virtual void more_precomputations() {}
-    void erased_parameter(int k);
+    void erased_parameters(const std::vector<int>& new_gpos);
     virtual bool get_nonzero_range(double /*level*/,
                       realt& /*left*/, realt& /*right*/) const { return false; }
 
@@ -92,8 +96,9 @@ public:
     realt numarea(realt x1, realt x2, int nsteps) const;
 
     virtual std::string get_bytecode() const { return "No bytecode"; }
-    virtual void update_var_indices(const std::vector<Variable*>& variables)
-            { used_vars_.update_indices(variables); }
+    virtual void update_var_indices(const std::vector<Variable*>& variables,
+                                    const VarIndex* index=NULL)
+            { used_vars_.update_indices(variables, index); }
     void set_param_name(int n, const std::string &new_p)
             { used_vars_.set_name(n, new_p); }
     const IndexedVars& used_vars() const { return used_vars_; }
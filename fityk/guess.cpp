@@ -5,6 +5,7 @@
 #include "guess.h"
 
 #include <algorithm>
+#include <cmath>
 #include <assert.h>
 
 #include "common.h"
@@ -127,6 +128,109 @@ vector<double> Guess::estimate_peak_parameters() const
     return vector4(center, height, hwhm, area);
 }
 
+// Peaks are found as local minima of the second derivative of smoothed data.
+// Both smoothing and derivative come from the quadratic polynomial fitted
+// (least squares) to 2k+1 points around each point (Savitzky-Golay filter).
+// A minimum is a peak if both the smoothed value and the second derivative
+// exceed guess_significance times their noise. The noise of data is taken
+// from sigma (if guess_uses_weights) or estimated from second differences.
+// Width is estimated from the curvature at the center, assuming the Gaussian
+// shape. A few filter widths are tried, starting from the narrowest;
+// peaks found with wider filters are added if they don't overlap
+// with the peaks already found.
+vector<vector<double> > Guess::estimate_all_peaks_parameters() const
+{
+    const int n = yy_.size();
+    if (n < 5)
+        throw ExecuteError("guess: too few points to look for peaks");
+    const double significance = settings_->guess_significance;
+
+    // noise
+    vector<double> noise;
+    if (!sigma_.empty())
+        noise.assign(sigma_.begin(), sigma_.end());
+    else {
+        vector<double> d(n - 2);
+        for (int i = 1; i < n - 1; ++i)
+            d[i-1] = fabs(yy_[i-1] - 2 * yy_[i] + yy_[i+1]);
+        nth_element(d.begin(), d.begin() + d.size() / 2, d.end());
+        // median absolute deviation -> standard deviation
+        double sd = d[d.size() / 2] / 0.6745 / sqrt(6.);
+        noise.resize(n, sd > 0 ? sd : epsilon);
+    }
+
+    // the filter width is based on the hwhm (in points) of the highest peak
+    int top = max_element(yy_.begin(), yy_.end()) - yy_.begin();
+    double top_hwhm = find_hwhm(top, NULL);
+    int top_k = 0;
+    while (top - top_k > 0 && xx_[top] - xx_[top-top_k] < top_hwhm)
+        ++top_k;
+
+    vector<vector<double> > peaks;
+    for (int k = max(2, top_k / 4); k <= max(2, 2 * top_k) && 2*k+2 < n;
+                                                                   k *= 2) {
+        // filter coefficients; j^2 - m is orthogonal to 1 and j
+        const double m = k * (k + 1) / 3.;
+        double s2 = 0;
+        for (int j = -k; j <= k; ++j)
+            s2 += (j*j - m) * (j*j - m);
+        vector<double> c_val(2*k+1), c_der(2*k+1);
+        double norm_val = 0, norm_der = 0;
+        for (int j = -k; j <= k; ++j) {
+            c_der[j+k] = 2 * (j*j - m) / s2;
+            c_val[j+k] = 1. / (2*k+1) - m * (j*j - m) / s2;
+            norm_val += c_val[j+k] * c_val[j+k];
+            norm_der += c_der[j+k] * c_der[j+k];
+        }
+        norm_val = sqrt(norm_val);
+        norm_der = sqrt(norm_der);
+        vector<double> ys(n, 0.), d2(n, 0.);
+        for (int i = k; i < n - k; ++i)
+            for (int j = -k; j <= k; ++j) {
+                ys[i] += c_val[j+k] * yy_[i+j];
+                d2[i] += c_der[j+k] * yy_[i+j];
+            }
+
+        size_t n_narrower = peaks.size();
+        for (int i = k + 1; i < n - k - 1; ++i) {
+            // the lowest value within the filter window
+            bool is_min = d2[i] < 0;
+            for (int j = max(i-k, k); is_min && j <= min(i+k, n-k-1); ++j)
+                if (d2[j] < d2[i] || (j < i && d2[j] == d2[i]))
+                    is_min = false;
+            if (!is_min)
+                continue;
+            if (ys[i] < significance * noise[i] * norm_val ||
+                    -d2[i] < significance * noise[i] * norm_der)
+                continue;
+            // parabolic interpolation of the minimum
+            double denom = d2[i-1] - 2 * d2[i] + d2[i+1];
+            double t = denom > 0 ? 0.5 * (d2[i-1] - d2[i+1]) / denom : 0.;
+            double dx = (xx_[i+1] - xx_[i-1]) / 2.;
+            double center = xx_[i] + t * dx;
+            // for Gaussian: y'' = -2 ln2 height / hwhm^2 at the center
+            double hwhm = max(dx * sqrt(2 * M_LN2 * ys[i] / -d2[i]), epsilon);
+            bool overlaps = false;
+            for (size_t j = 0; j < n_narrower && !overlaps; ++j)
+                if (fabs(center - peaks[j][0]) < hwhm + peaks[j][2])
+                    overlaps = true;
+            if (overlaps)
+                continue;
+            double height = ys[i];
+            // area of Gaussian: height * hwhm * sqrt(pi / ln 2)
+            double area = height * hwhm * 2.1289;
+            peaks.push_back(vector4(center, height, hwhm, area));
+        }
+    }
+
+    sort(peaks.begin(), peaks.end());
+    for (size_t i = 0; i != peaks.size(); ++i) {
+        peaks[i][1] *= settings_->height_correction;
+        peaks[i][2] *= settings_->width_correction;
+    }
+    return peaks;
+}
+
 vector<double> Guess::estimate_linear_parameters() const
 {
     double sx = 0, sy = 0, sxx = 0, /*syy = 0,*/ sxy = 0;
@@ -35,6 +35,9 @@ public:
     std::vector<double> estimate_peak_parameters() const;
     /// returns values corresponding to sigmoid_traits
     std::vector<double> estimate_sigmoid_parameters() const;
+    /// finds all significant peaks in one pass,
+    /// returns values corresponding to peak_traits for each peak
+    std::vector<std::vector<double> > estimate_all_peaks_parameters() const;
 
 private:
     Settings const* settings_;
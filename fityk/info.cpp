@@ -38,6 +38,7 @@ extern "C" {
 #include "lexer.h"
 #include "ui.h"
 #include "runner.h" // args2range
+#include "plugin.h" // create_PluginFunction, create_CallbackFunction
 
 using namespace std;
 
@@ -84,7 +85,20 @@ void models_as_script(const Full* F, string& r, bool commented_defines)
         if (t == NULL || t->as_formula() != (*i)->as_formula())
             r += "\nundefine " + (*i)->name;
     }
+    vector<string> plugins;
     v_foreach (Tplate::Ptr, i, F->get_tpm()->tpvec()) {
+        if ((*i)->create == &create_PluginFunction) {
+            if (!contains_element(plugins, (*i)->plugin_path)) {
+                plugins.push_back((*i)->plugin_path);
+                r += "\ndefine plugin '" + (*i)->plugin_path + "'";
+            }
+            continue;
+        }
+        if ((*i)->create == &create_CallbackFunction) {
+            r += "\n# " + (*i)->name + " is calculated by the host program"
+                 " and must be defined there";
+            continue;
+        }
         string formula = (*i)->as_formula();
         const Tplate* t = default_tpm.get_tp((*i)->name);
         if (t == NULL || t->as_formula() != formula)
@@ -110,6 +124,14 @@ void models_as_script(const Full* F, string& r, bool commented_defines)
         vector<string> const& zz = model->get_zz().names;
         if (!zz.empty())
             r += "\n@" + S(i) +  ": Z = %" + join_vector(zz, " + %");
+        // the tabulated R is copied again from the (restored) dataset
+        if (model->get_rr_data_source() != -1)
+            r += "\n@" + S(i) +  ": R = @" + S(model->get_rr_data_source());
+        vector<string> const& rr = model->get_rr().names;
+        if (!rr.empty())
+            r += "\n@" + S(i) +  ": R " +
+                 (model->get_rr_data_source() != -1 ? "+= %" : "= %") +
+                 join_vector(rr, " + %");
     }
 }
 
@@ -246,7 +268,7 @@ string info_func_props(const Full* F, const string& name)
 void info_history(const Full* F, const Token& t1, const Token& t2,
                   string& result)
 {
-    const vector<UserInterface::Cmd>& cmds = F->ui()->cmds();
+    const deque<UserInterface::Cmd>& cmds = F->ui()->cmds();
     int from = 0, to = cmds.size();
     if (t1.type == kTokenExpr) {
         from = iround(t1.value.d);
@@ -359,6 +381,24 @@ string format_error_info(const Full* F, const vector<double>& errors)
     return s;
 }
 
+// limits: lower and upper limit for each parameter
+string format_limits_info(const Full* F, const vector<realt>& limits)
+{
+    string s;
+    const SettingsMgr *sm = F->settings_mgr();
+    const vector<realt>& pp = F->mgr.parameters();
+    assert(2 * pp.size() == limits.size());
+    const Fit* fit = F->get_fit();
+    for (size_t i = 0; i != pp.size(); ++i) {
+        if (fit->is_param_used(i))
+            s += "\n$" + F->mgr.gpos_to_var(i)->name
+                + " = " + sm->format_double(pp[i])
+                + "  [" + sm->format_double(limits[2*i])
+                + " : " + sm->format_double(limits[2*i+1]) + "]";
+    }
+    return s;
+}
+
 int eval_one_info_arg(const Full* F, int ds, const vector<Token>& args, int n,
                       string& result)
 {
@@ -450,14 +490,21 @@ int eval_one_info_arg(const Full* F, int ds, const vector<Token>& args, int n,
 
         // optionally takes datasets as args
         else if (word == "fit" || word == "errors" || word == "cov" ||
-                 word == "confidence") {
+                 word == "confidence" || word == "confidence_profile" ||
+                 word == "errors_bootstrap" || word == "errors_montecarlo") {
             double level = 0.;
-            if (word == "confidence") {
+            int n_samples = 0;
+            if (word == "confidence" || word == "confidence_profile") {
                 level = args[n+1].value.d;
                 if (level <= 0 || level >= 100)
                     throw ExecuteError("confidence level outside of (0,100)");
                 ++n;
                 ++ret;
+            } else if (word == "errors_bootstrap" ||
+                       word == "errors_montecarlo") {
+                n_samples = iround(args[n+1].value.d);
+                ++n;
+                ++ret;
             }
             vector<Data*> v;
             while (args[n+1].type == kTokenDataset) {
@@ -482,6 +529,17 @@ int eval_one_info_arg(const Full* F, int ds, const vector<Token>& args, int n,
                 vector<double> limits =
                     F->get_fit()->get_confidence_limits(v, level);
                 result += format_error_info(F, limits);
+            } else if (word == "confidence_profile") {
+                result += S(level) + "% profile-likelihood confidence"
+                          " intervals:";
+                vector<realt> limits =
+                    F->get_fit()->get_profile_limits(v, level);
+                result += format_limits_info(F, limits);
+            } else if (word == "errors_bootstrap" ||
+                       word == "errors_montecarlo") {
+                bool mc = (word == "errors_montecarlo");
+                result += F->get_fit()->get_error_samples_info(v, n_samples,
+                                                               mc);
             } else //if (word == "cov")
                 result += F->get_fit()->get_cov_info(v);
         }
@@ -514,9 +572,9 @@ int eval_one_info_arg(const Full* F, int ds, const vector<Token>& args, int n,
     else if (args[n].type == kTokenVarname)
         info_variables(F, Lexer::get_string(args[n]), result);
 
-    // handle [@n.]F/Z['['expr']']
-    else if ((args[n].type == kTokenUletter &&
-                             (*args[n].str == 'F' || *args[n].str == 'Z'))
+    // handle [@n.]F/Z/R['['expr']']
+    else if ((args[n].type == kTokenUletter && (*args[n].str == 'F' ||
+                                *args[n].str == 'Z' || *args[n].str == 'R'))
              || args[n].type == kTokenDataset) {
         int k = ds;
         if (args[n].type == kTokenDataset) {
@@ -534,6 +592,9 @@ int eval_one_info_arg(const Full* F, int ds, const vector<Token>& args, int n,
             result += f->get_basic_assignment();
         } else {
             const vector<string>& names = model->get_fz(fz).names;
+            if (fz == 'R' && model->get_rr_data_source() != -1)
+                result += "@" + S(model->get_rr_data_source())
+                          + (names.empty() ? "" : " + ");
             if (!names.empty())
                 result += "%" + join_vector(names, " + %");
         }
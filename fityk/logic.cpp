@@ -22,6 +22,7 @@
 #include "lexer.h" // Lexer::kNew
 #include "cparser.h"
 #include "runner.h"
+#include "plugin.h"
 
 using namespace std;
 
@@ -54,6 +55,7 @@ void Full::initialize()
     settings_mgr_ = new SettingsMgr(this);
     tplate_mgr_ = new TplateMgr;
     tplate_mgr_->add_builtin_types(cmd_executor_->parser());
+    load_plugins_from_env(tplate_mgr_, ui_);
     view = View(&dk);
     ui_->mark_plot_dirty();
     dk.append(new Data(this, mgr.create_model()));
@@ -67,6 +67,136 @@ static int lua_vector_iterator(lua_State* L)
 
 namespace fityk {
 
+// FuncTypeCallback that calls Lua functions: f(x, p) -> y
+// and optionally df(x, p) -> y, dy_dp, dy_dx.
+// Arrays are passed as tables indexed from 1, dy_dp[i][k] = df/dp_k(x_i).
+class LuaFuncTypeCallback : public FuncTypeCallback
+{
+public:
+    LuaFuncTypeCallback(lua_State* L, const string& name, int np,
+                        int func_ref, int deriv_ref)
+        : L_(L), name_(name), np_(np),
+          func_ref_(func_ref), deriv_ref_(deriv_ref), top_(0) {}
+
+    ~LuaFuncTypeCallback() {
+        luaL_unref(L_, LUA_REGISTRYINDEX, func_ref_);
+        luaL_unref(L_, LUA_REGISTRYINDEX, deriv_ref_);
+    }
+
+    void value(const realt* p, int n, const realt* x, realt* y) {
+        call(func_ref_, p, n, x, 1);
+        read_table(top_+1, n, y, true, "value");
+        lua_settop(L_, top_);
+    }
+
+    bool value_deriv(const realt* p, int n, const realt* x, realt* y,
+                     realt* dy_dp, realt* dy_dx) {
+        if (deriv_ref_ == LUA_NOREF)
+            return false;
+        call(deriv_ref_, p, n, x, 3);
+        read_table(top_+1, n, y, true, "value");
+        if (!lua_istable(L_, top_+2))
+            error("dy_dp should be a table");
+        for (int i = 0; i < n; ++i) {
+            lua_rawgeti(L_, top_+2, i+1);
+            read_table(top_+4, np_, dy_dp + i*np_, false, "dy_dp[i]");
+            lua_pop(L_, 1);
+        }
+        read_table(top_+3, n, dy_dx, false, "dy_dx");
+        lua_settop(L_, top_);
+        return true;
+    }
+
+private:
+    lua_State* L_;
+    string name_;
+    int np_;
+    int func_ref_, deriv_ref_;
+    int top_; // the stack top before the call
+
+    void push_table(const realt* a, int n) {
+        lua_createtable(L_, n, 0);
+        for (int i = 0; i < n; ++i) {
+            lua_pushnumber(L_, a[i]);
+            lua_rawseti(L_, -2, i+1);
+        }
+    }
+
+    // leaves nresults values on the stack or throws ExecuteError
+    void call(int ref, const realt* p, int n, const realt* x, int nresults) {
+        top_ = lua_gettop(L_);
+        lua_rawgeti(L_, LUA_REGISTRYINDEX, ref);
+        push_table(x, n);
+        push_table(p, np_);
+        if (lua_pcall(L_, 2, nresults, 0) != 0) {
+            const char *msg = lua_tostring(L_, -1);
+            error(msg ? msg : "(non-string error)");
+        }
+    }
+
+    void read_table(int idx, int n, realt* out, bool add, const char* what) {
+        if (!lua_istable(L_, idx))
+            error(S(what) + " should be a table");
+        for (int i = 0; i < n; ++i) {
+            lua_rawgeti(L_, idx, i+1);
+            if (!lua_isnumber(L_, -1))
+                error(S(what) + " should have " + S(n) + " numbers");
+            realt v = lua_tonumber(L_, -1);
+            out[i] = add ? out[i] + v : v;
+            lua_pop(L_, 1);
+        }
+    }
+
+    void error(const string& msg) {
+        lua_settop(L_, top_);
+        throw ExecuteError(name_ + ": " + msg);
+    }
+};
+
+} // namespace fityk
+
+// F:define_lua_type(name, params, func [, deriv [, traits [, defvals]]])
+static int lua_define_type(lua_State* L)
+{
+    using namespace fityk;
+    Fityk *fik = NULL;
+    swig_type_info *type_info = SWIG_TypeQuery(L, "fityk::Fityk *");
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void**) &fik, type_info, 0)))
+        return luaL_error(L, "use F:define_lua_type(...)");
+    const char *name = luaL_checkstring(L, 2);
+    const char *params = luaL_checkstring(L, 3);
+    luaL_checktype(L, 4, LUA_TFUNCTION);
+    if (!lua_isnoneornil(L, 5))
+        luaL_checktype(L, 5, LUA_TFUNCTION);
+    int traits = (int) luaL_optinteger(L, 6, 0);
+    const char *defvals = luaL_optstring(L, 7, "");
+    int np = params[0] == '\0' ? 0 : 1;
+    for (const char* c = params; *c != '\0'; ++c)
+        if (*c == ',')
+            ++np;
+    lua_pushvalue(L, 4);
+    int func_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    lua_pushvalue(L, 5);
+    int deriv_ref = luaL_ref(L, LUA_REGISTRYINDEX); // LUA_REFNIL for nil
+    if (deriv_ref == LUA_REFNIL)
+        deriv_ref = LUA_NOREF;
+    bool ok = true;
+    try {
+        fik->define_callback_type(name, params,
+                                  new LuaFuncTypeCallback(L, name, np,
+                                                          func_ref, deriv_ref),
+                                  traits, defvals);
+    }
+    catch (ExecuteError& e) {
+        lua_pushstring(L, e.what());
+        ok = false;
+    }
+    // lua_error() long-jumps, it's called when no C++ objects are alive
+    return ok ? 0 : lua_error(L);
+}
+
+namespace fityk {
+
 LuaBridge::LuaBridge(Full *F)
     : ctx_(F)
 {
@@ -87,6 +217,12 @@ LuaBridge::LuaBridge(Full *F)
         lua_pop(L_, 1);
     }
 
+    // F:define_lua_type() is added to the methods of wrapped class Fityk
+    SWIG_Lua_get_class_metatable(L_, "Fityk");
+    SWIG_Lua_get_table(L_, ".fn");
+    SWIG_Lua_add_function(L_, "define_lua_type", lua_define_type);
+    lua_pop(L_, 2);
+
     // define F
     swig_type_info *type_info = SWIG_TypeQuery(L_, "fityk::Fityk *");
     assert(type_info != NULL);
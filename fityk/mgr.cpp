@@ -25,7 +25,8 @@ namespace fityk {
 ModelManager::ModelManager(const BasicContext* ctx)
     : ctx_(ctx),
       var_autoname_counter_(0),
-      func_autoname_counter_(0)
+      func_autoname_counter_(0),
+      stamp_(0), values_stamp_(0)
 {
     assert(ctx != NULL);
 }
@@ -53,20 +54,26 @@ void ModelManager::delete_model(Model *m)
 
 void ModelManager::sort_variables()
 {
-    for (vector<Variable*>::iterator i = variables_.begin();
-            i != variables_.end(); ++i)
-        (*i)->set_var_idx(variables_);
+    // Swap variables until each one depends only on variables with lower
+    // indices. Positions are looked up by name, so only the two swapped
+    // variables need to be updated in each step.
     int pos = 0;
     while (pos < size(variables_)) {
-        int M = variables_[pos]->used_vars().get_max_idx();
+        int M = -1;
+        v_foreach (string, i, variables_[pos]->used_vars().names()) {
+            VarIndex::const_iterator k = var_index_.find(*i);
+            assert(k != var_index_.end());
+            M = max(M, k->second);
+        }
         if (M > pos) {
             swap(variables_[pos], variables_[M]);
-            for (vector<Variable*>::iterator i = variables_.begin();
-                    i != variables_.end(); ++i)
-                (*i)->set_var_idx(variables_);
+            var_index_[variables_[pos]->name] = pos;
+            var_index_[variables_[M]->name] = M;
         } else
             ++pos;
     }
+    set_var_positions(0);
+    reindex_all();
 }
 
 /*
@@ -137,7 +144,7 @@ void ModelManager::eval_tilde(vector<int>::iterator op,
         code.erase(op, op+5);
     }
     parameters_.push_back(value);
-    variables_.push_back(tilde_var);
+    push_variable(tilde_var);
 }
 
 int ModelManager::make_variable(const string &name, VMData* vd)
@@ -193,25 +200,52 @@ int ModelManager::make_variable(const string &name, VMData* vd)
     }
 }
 
-bool ModelManager::is_variable_referred(int i, string *first_referrer)
+// returns sorted indices of all variables that uv depends on (indirectly too)
+vector<int> ModelManager::get_dependencies(const IndexedVars& uv) const
+{
+    vector<bool> visited(variables_.size(), false);
+    vector<int> stack = uv.indices();
+    vector<int> deps;
+    while (!stack.empty()) {
+        int n = stack.back();
+        stack.pop_back();
+        if (visited[n])
+            continue;
+        visited[n] = true;
+        deps.push_back(n);
+        v_foreach (int, i, variables_[n]->used_vars().indices())
+            if (!visited[*i])
+                stack.push_back(*i);
+    }
+    sort(deps.begin(), deps.end());
+    return deps;
+}
+
+// returns numbers of references to each variable from variables and functions
+vector<int> ModelManager::count_references() const
+{
+    vector<int> refs(variables_.size(), 0);
+    v_foreach (Variable*, i, variables_)
+        v_foreach (int, j, (*i)->used_vars().indices())
+            ++refs[*j];
+    v_foreach (Function*, i, functions_)
+        v_foreach (int, j, (*i)->used_vars().indices())
+            ++refs[*j];
+    return refs;
+}
+
+// name of the first variable or function that refers to variable i,
+// ignoring variables marked as deleted
+string ModelManager::find_referrer(int i, const vector<bool>& deleted) const
 {
     // A variable can be referred only by variables with larger index.
-    for (int j = i+1; j < size(variables_); ++j) {
-        if (variables_[j]->used_vars().has_idx(i)) {
-            if (first_referrer)
-                *first_referrer = "$" + variables_[j]->name;
-            return true;
-        }
-    }
-    for (vector<Function*>::iterator j = functions_.begin();
-            j != functions_.end(); ++j) {
-        if ((*j)->used_vars().has_idx(i)) {
-            if (first_referrer)
-                *first_referrer = "%" + (*j)->name;
-            return true;
-        }
-    }
-    return false;
+    for (int j = i+1; j < size(variables_); ++j)
+        if (!deleted[j] && variables_[j]->used_vars().has_idx(i))
+            return "$" + variables_[j]->name;
+    v_foreach (Function*, j, functions_)
+        if ((*j)->used_vars().has_idx(i))
+            return "%" + (*j)->name;
+    return "";
 }
 
 vector<string>
@@ -229,48 +263,124 @@ ModelManager::get_variable_references(const string &name) const
     return refs;
 }
 
+// update look-up tables: name -> position for variables_[first...]
+// and gpos -> position for all simple variables
+void ModelManager::set_var_positions(int first)
+{
+    for (int i = first; i < size(variables_); ++i)
+        var_index_[variables_[i]->name] = i;
+    vpos_of_gpos_.assign(parameters_.size(), -1);
+    for (int i = 0; i != size(variables_); ++i) {
+        int gpos = variables_[i]->gpos();
+        if (gpos >= 0)
+            vpos_of_gpos_[gpos] = i;
+    }
+}
+
+void ModelManager::set_func_positions(int first)
+{
+    for (int i = first; i < size(functions_); ++i)
+        func_index_[functions_[i]->name] = i;
+}
+
 // set indices corresponding to variable names in all functions and variables
 void ModelManager::reindex_all()
 {
-    for (vector<Variable*>::iterator i = variables_.begin();
-            i != variables_.end(); ++i)
-        (*i)->set_var_idx(variables_);
-    for (vector<Function*>::iterator i = functions_.begin();
-            i != functions_.end(); ++i) {
-        (*i)->update_var_indices(variables_);
+    vm_foreach (Variable*, i, variables_)
+        (*i)->set_var_idx(variables_, &var_index_);
+    vm_foreach (Function*, i, functions_)
+        (*i)->update_var_indices(variables_, &var_index_);
+}
+
+// removes marked variables in one pass and updates indices
+void ModelManager::erase_variables(const vector<bool>& deleted)
+{
+    int first = -1;
+    int n = 0;
+    for (int i = 0; i != size(variables_); ++i) {
+        if (deleted[i]) {
+            var_index_.erase(variables_[i]->name);
+            delete variables_[i];
+            if (first == -1)
+                first = i;
+        } else
+            variables_[n++] = variables_[i];
     }
+    if (first == -1)
+        return;
+    variables_.resize(n);
+    set_var_positions(first);
+    reindex_all();
+}
+
+// removes marked functions in one pass
+void ModelManager::erase_functions(const vector<bool>& deleted)
+{
+    int first = -1;
+    int n = 0;
+    for (int i = 0; i != size(functions_); ++i) {
+        if (deleted[i]) {
+            func_index_.erase(functions_[i]->name);
+            delete functions_[i];
+            if (first == -1)
+                first = i;
+        } else
+            functions_[n++] = functions_[i];
+    }
+    functions_.resize(n);
+    if (first != -1)
+        set_func_positions(first);
 }
 
 void ModelManager::remove_unreferred()
 {
     // remove auto-delete marked variables, which are not referred by others
+    // (going down, because variables refer only to variables before them)
+    vector<int> refs = count_references();
+    vector<bool> deleted(variables_.size(), false);
     for (int i = variables_.size()-1; i >= 0; --i)
-        if (is_auto(variables_[i]->name) && !is_variable_referred(i)) {
-            delete variables_[i];
-            variables_.erase(variables_.begin() + i);
+        if (is_auto(variables_[i]->name) && refs[i] == 0) {
+            deleted[i] = true;
+            v_foreach (int, j, variables_[i]->used_vars().indices())
+                --refs[*j];
         }
 
-    // re-index all functions and variables (in any case)
-    reindex_all();
+    erase_variables(deleted);
 
     // remove unreferred parameters
-    for (int i = size(parameters_)-1; i >= 0; --i) {
-        bool del=true;
-        for (int j = 0; j < size(variables_); ++j)
-            if (variables_[j]->gpos() == i) {
-                del=false;
-                break;
-            }
-        if (del) {
-            parameters_.erase(parameters_.begin() + i);
-            // take care about parameter indices in variables and functions
-            for (vector<Variable*>::iterator j = variables_.begin();
-                    j != variables_.end(); ++j)
-                (*j)->erased_parameter(i);
-            for (vector<Function*>::iterator j = functions_.begin();
-                    j != functions_.end(); ++j)
-                (*j)->erased_parameter(i);
-        }
+    vector<bool> used(parameters_.size(), false);
+    v_foreach (Variable*, i, variables_)
+        if ((*i)->gpos() >= 0)
+            used[(*i)->gpos()] = true;
+    if (count(used.begin(), used.end(), false) == 0)
+        return;
+    // new_gpos[k]: k minus the number of removed parameters before k
+    vector<int> new_gpos(parameters_.size());
+    int n = 0;
+    for (size_t i = 0; i != parameters_.size(); ++i) {
+        new_gpos[i] = n;
+        if (used[i])
+            parameters_[n++] = parameters_[i];
+    }
+    parameters_.resize(n);
+    // take care about parameter indices in variables and functions
+    vm_foreach (Variable*, i, variables_)
+        (*i)->erased_parameters(new_gpos);
+    vm_foreach (Function*, i, functions_)
+        (*i)->erased_parameters(new_gpos);
+    set_var_positions(variables_.size());
+}
+
+void ModelManager::push_variable(Variable* var)
+{
+    int pos = variables_.size();
+    variables_.push_back(var);
+    var_index_[var->name] = pos;
+    int gpos = var->gpos();
+    if (gpos >= 0) {
+        if (gpos >= size(vpos_of_gpos_))
+            vpos_of_gpos_.resize(gpos + 1, -1);
+        vpos_of_gpos_[gpos] = pos;
     }
 }
 
@@ -278,13 +388,14 @@ void ModelManager::remove_unreferred()
 int ModelManager::add_variable(Variable* new_var, bool old_domain)
 {
     auto_ptr<Variable> var(new_var);
-    var->set_var_idx(variables_);
+    var->set_var_idx(variables_, &var_index_);
     int pos = find_variable_nr(var->name);
     if (pos == -1) {
         pos = variables_.size();
-        variables_.push_back(var.release());
+        push_variable(var.release());
     } else {
-        if (var->used_vars().depends_on(pos, variables_)) { //check for loops
+        vector<int> deps = get_dependencies(var->used_vars());
+        if (binary_search(deps.begin(), deps.end(), pos)) { //check for loops
             throw ExecuteError("loop in dependencies of $" + var->name);
         }
 
@@ -297,6 +408,11 @@ int ModelManager::add_variable(Variable* new_var, bool old_domain)
         variables_[pos] = var.release();
         if (variables_[pos]->used_vars().get_max_idx() > pos)
             sort_variables();
+        else {
+            // CompoundFunction keeps pointers to variables, and gpos changes
+            set_var_positions(variables_.size());
+            reindex_all();
+        }
         remove_unreferred();
     }
     return pos;
@@ -333,13 +449,12 @@ int ModelManager::assign_var_copy(const string &name, const string &orig)
     assert(!name.empty());
     const Variable* ov = find_variable(orig);
     map<int,string> var_copies;
-    for (int i = 0; i < size(variables_); ++i) {
-        if (ov->used_vars().depends_on(i, variables_)) {
-            const Variable* var_orig = variables_[i];
-            string newname = name_var_copy(var_orig);
-            copy_and_add_variable(newname, var_orig, var_copies);
-            var_copies[i] = newname;
-        }
+    vector<int> deps = get_dependencies(ov->used_vars());
+    v_foreach (int, i, deps) {
+        const Variable* var_orig = variables_[*i];
+        string newname = name_var_copy(var_orig);
+        copy_and_add_variable(newname, var_orig, var_copies);
+        var_copies[*i] = newname;
     }
     return copy_and_add_variable(name, ov, var_copies);
 }
@@ -365,24 +480,27 @@ void ModelManager::delete_variables(const vector<string> &names)
                     nn.insert(j);
     }
 
-    // Delete variables_. The descending index order is required to make
-    // is_variable_referred() and variables_.erase() work properly.
+    // Mark variables to be deleted. The descending index order is required,
+    // because variables are referred only by variables with larger indices.
+    vector<int> refs = count_references();
+    vector<bool> deleted(variables_.size(), false);
     for (set<int>::const_reverse_iterator i = nn.rbegin(); i != nn.rend(); ++i){
         // Check for dependencies.
-        string first_referrer;
-        if (is_variable_referred(*i, &first_referrer)) {
-            reindex_all();
+        if (refs[*i] != 0) {
+            string msg = "can't delete $" + get_variable(*i)->name +
+                         " because " + find_referrer(*i, deleted) +
+                         " depends on it.";
+            erase_variables(deleted);
             remove_unreferred(); // post-delete
-            throw ExecuteError("can't delete $" + get_variable(*i)->name +
-                             " because " + first_referrer + " depends on it.");
+            throw ExecuteError(msg);
         }
-
-        delete variables_[*i];
-        variables_.erase(variables_.begin() + *i);
+        deleted[*i] = true;
+        v_foreach (int, j, variables_[*i]->used_vars().indices())
+            --refs[*j];
     }
 
     // post-delete
-    reindex_all();
+    erase_variables(deleted);
     remove_unreferred();
 }
 
@@ -405,11 +523,10 @@ void ModelManager::delete_funcs(const vector<string>& names)
                     nn.insert(j);
     }
 
-    // Delete functions. The descending index order is needed by .erase().
-    for (set<int>::const_reverse_iterator i = nn.rbegin(); i != nn.rend(); ++i){
-        delete functions_[*i];
-        functions_.erase(functions_.begin() + *i);
-    }
+    vector<bool> deleted(functions_.size(), false);
+    for (set<int>::const_iterator i = nn.begin(); i != nn.end(); ++i)
+        deleted[*i] = true;
+    erase_functions(deleted);
 
     // post-delete
     remove_unreferred();
@@ -420,7 +537,8 @@ bool ModelManager::is_function_referred(int n) const
 {
     v_foreach (Model*, i, models_) {
         if (contains_element((*i)->get_ff().idx, n)
-                || contains_element((*i)->get_zz().idx, n))
+                || contains_element((*i)->get_zz().idx, n)
+                || contains_element((*i)->get_rr().idx, n))
             return true;
     }
     return false;
@@ -429,23 +547,32 @@ bool ModelManager::is_function_referred(int n) const
 // post: call update_indices_in_models()
 void ModelManager::auto_remove_functions()
 {
-    int func_size = functions_.size();
-    for (int i = func_size - 1; i >= 0; --i)
-        if (is_auto(functions_[i]->name) && !is_function_referred(i)) {
-            delete functions_[i];
-            functions_.erase(functions_.begin() + i);
+    vector<bool> referred(functions_.size(), false);
+    v_foreach (Model*, i, models_) {
+        v_foreach (int, j, (*i)->get_ff().idx)
+            referred[*j] = true;
+        v_foreach (int, j, (*i)->get_zz().idx)
+            referred[*j] = true;
+        v_foreach (int, j, (*i)->get_rr().idx)
+            referred[*j] = true;
+    }
+    vector<bool> deleted(functions_.size(), false);
+    bool any = false;
+    for (size_t i = 0; i != functions_.size(); ++i)
+        if (is_auto(functions_[i]->name) && !referred[i]) {
+            deleted[i] = true;
+            any = true;
         }
-    if (func_size != size(functions_)) {
+    if (any) {
+        erase_functions(deleted);
         remove_unreferred();
     }
 }
 
 int ModelManager::find_function_nr(const string &name) const
 {
-    for (int i = 0; i < size(functions_); ++i)
-        if (functions_[i]->name == name)
-            return i;
-    return -1;
+    VarIndex::const_iterator i = func_index_.find(name);
+    return i != func_index_.end() ? i->second : -1;
 }
 
 const Function* ModelManager::find_function(const string &name) const
@@ -458,10 +585,8 @@ const Function* ModelManager::find_function(const string &name) const
 
 int ModelManager::find_variable_nr(const string &name) const
 {
-    for (int i = 0; i < size(variables_); ++i)
-        if (variables_[i]->name == name)
-            return i;
-    return -1;
+    VarIndex::const_iterator i = var_index_.find(name);
+    return i != var_index_.end() ? i->second : -1;
 }
 
 const Variable* ModelManager::find_variable(const string &name) const
@@ -475,11 +600,8 @@ const Variable* ModelManager::find_variable(const string &name) const
 int ModelManager::gpos_to_vpos(int gpos) const
 {
     assert(gpos >= 0 && gpos < size(parameters_));
-    for (size_t i = 0; i < variables_.size(); ++i)
-        if (variables_[i]->gpos() == gpos)
-            return i;
-    assert(0);
-    return 0;
+    assert(gpos < size(vpos_of_gpos_) && vpos_of_gpos_[gpos] != -1);
+    return vpos_of_gpos_[gpos];
 }
 
 void ModelManager::use_parameters()
@@ -493,6 +615,7 @@ void ModelManager::use_external_parameters(const vector<realt> &ext_param)
         (*i)->recalculate(variables_, ext_param);
     vm_foreach (Function*, i, functions_)
         (*i)->do_precomputations(variables_);
+    ++values_stamp_;
 }
 
 void ModelManager::put_new_parameters(const vector<realt> &aa)
@@ -527,13 +650,12 @@ int ModelManager::assign_func_copy(const string &name, const string &orig)
     assert(!name.empty());
     const Function* of = find_function(orig);
     map<int,string> var_copies;
-    for (int i = 0; i < size(variables_); ++i) {
-        if (of->used_vars().depends_on(i, variables_)) {
-            const Variable* var_orig = variables_[i];
-            string newname = name_var_copy(var_orig);
-            copy_and_add_variable(newname, var_orig, var_copies);
-            var_copies[i] = newname;
-        }
+    vector<int> deps = get_dependencies(of->used_vars());
+    v_foreach (int, i, deps) {
+        const Variable* var_orig = variables_[*i];
+        string newname = name_var_copy(var_orig);
+        copy_and_add_variable(newname, var_orig, var_copies);
+        var_copies[*i] = newname;
     }
     vector<string> varnames;
     for (int i = 0; i != of->used_vars().get_count(); ++i) {
@@ -550,7 +672,7 @@ int ModelManager::assign_func_copy(const string &name, const string &orig)
 
 int ModelManager::add_func(Function* func)
 {
-    func->update_var_indices(variables_);
+    func->update_var_indices(variables_, &var_index_);
     // if there is already function with the same name -- replace
     int nr = find_function_nr(func->name);
     if (nr != -1) {
@@ -561,6 +683,7 @@ int ModelManager::add_func(Function* func)
     } else {
         nr = functions_.size();
         functions_.push_back(func);
+        func_index_[func->name] = nr;
         ctx_->msg("%" + func->name + " created.");
     }
     return nr;
@@ -598,7 +721,7 @@ void ModelManager::substitute_func_param(const string &name,
     int v_idx = vd->single_symbol() ? vd->code()[1]
                                     : make_variable(next_var_name(), vd);
     k->set_param_name(k->get_param_nr(param), variables_[v_idx]->name);
-    k->update_var_indices(variables_);
+    k->update_var_indices(variables_, &var_index_);
     remove_unreferred();
 }
 
@@ -641,6 +764,9 @@ void ModelManager::do_reset()
     var_autoname_counter_ = 0;
     func_autoname_counter_ = 0;
     parameters_.clear();
+    var_index_.clear();
+    func_index_.clear();
+    vpos_of_gpos_.clear();
     //don't delete models, they should unregister itself
     update_indices_in_models();
 }
@@ -648,23 +774,24 @@ void ModelManager::do_reset()
 void ModelManager::update_indices(FunctionSum& sum)
 {
     sum.idx.clear();
-    size_t i = 0;
-    while (i < sum.names.size()) {
+    size_t n = 0;
+    for (size_t i = 0; i != sum.names.size(); ++i) {
         int k = find_function_nr(sum.names[i]);
-        if (k == -1)
-            sum.names.erase(sum.names.begin() + i);
-        else {
+        if (k != -1) {
             sum.idx.push_back(k);
-            ++i;
+            sum.names[n++] = sum.names[i];
         }
     }
+    sum.names.resize(n);
 }
 
 void ModelManager::update_indices_in_models()
 {
+    ++stamp_;
     for (vector<Model*>::iterator i = models_.begin(); i != models_.end(); ++i){
         update_indices((*i)->get_ff());
         update_indices((*i)->get_zz());
+        update_indices((*i)->get_rr());
     }
 }
 
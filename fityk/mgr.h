@@ -7,6 +7,7 @@
 #include <map>
 #include "fityk.h"
 #include "tplate.h" // Tplate::Ptr
+#include "var.h" // VarIndex
 
 namespace fityk {
 
@@ -79,6 +80,11 @@ public:
     std::vector<std::string>
         get_variable_references(const std::string &name) const;
     void update_indices_in_models();
+    /// changed when functions or models change; models use it to find
+    /// out if the cached index of function supports must be rebuilt
+    int stamp() const { return stamp_; }
+    /// changed when values of parameters change (supports may move)
+    int values_stamp() const { return values_stamp_; }
     void do_reset();
     std::vector<std::string> share_par_cmd(const std::string& par, bool share);
 
@@ -93,17 +99,31 @@ private:
     /// sorted, a doesn't depend on b if idx(a)>idx(b)
     std::vector<Variable*> variables_;
     std::vector<Function*> functions_;
+    // positions in variables_ and functions_, found by name
+    VarIndex var_index_;
+    VarIndex func_index_;
+    // vpos_of_gpos_[gpos] is position of simple variable in variables_
+    std::vector<int> vpos_of_gpos_;
     int var_autoname_counter_; ///for names for "anonymous" variables
     int func_autoname_counter_; ///for names for "anonymous" functions
+    int stamp_;
+    int values_stamp_;
 
     int add_variable(Variable* new_var, bool old_domain);
+    void push_variable(Variable* var);
     void sort_variables();
     int copy_and_add_variable(const std::string& name,
                               const Variable* orig,
                               const std::map<int,std::string>& varmap);
     int add_func(Function* func);
     //std::string get_or_make_variable(const std::string& func);
-    bool is_variable_referred(int i, std::string *first_referrer = NULL);
+    std::vector<int> get_dependencies(const IndexedVars& uv) const;
+    std::vector<int> count_references() const;
+    std::string find_referrer(int i, const std::vector<bool>& deleted) const;
+    void erase_variables(const std::vector<bool>& deleted);
+    void erase_functions(const std::vector<bool>& deleted);
+    void set_var_positions(int first);
+    void set_func_positions(int first);
     void reindex_all();
     std::string name_var_copy(const Variable* v);
     void update_indices(FunctionSum& sum);
@@ -5,10 +5,12 @@
 #include "model.h"
 
 #include <algorithm>
+#include <limits>
 #include <string>
 #include <vector>
 
 #include "common.h"
+#include "fft.h"
 #include "func.h"
 #include "var.h"
 #include "mgr.h"
@@ -26,15 +28,20 @@ void Model::destroy()
 
 void Model::clear()
 {
-    if (ff_.names.empty() && zz_.names.empty())
+    if (ff_.names.empty() && zz_.names.empty() && !has_convolution())
         return;
     ff_.names.clear();
     ff_.idx.clear();
     zz_.names.clear();
     zz_.idx.clear();
+    rr_.names.clear();
+    rr_.idx.clear();
+    rr_data_.clear();
+    rr_data_source_ = -1;
     //mgr_.auto_remove_functions();
     //mgr.update_indices_in_models();
     //F_->outdated_plot();
+    supports_stamp_ = -1;
 }
 
 /// checks if this model depends on the variable with index idx
@@ -47,15 +54,25 @@ bool Model::is_dependent_on_var(int idx) const
     v_foreach (int, i, zz_.idx)
         if (mgr_.get_function(*i)->used_vars().depends_on(idx, vv))
             return true;
+    v_foreach (int, i, rr_.idx)
+        if (mgr_.get_function(*i)->used_vars().depends_on(idx, vv))
+            return true;
     return false;
 }
 
 realt Model::value(realt x) const
 {
+    if (has_convolution()) {
+        vector<realt> xx(1, x), yy(1, 0.);
+        compute_model(xx, yy);
+        return yy[0];
+    }
     x += zero_shift(x);
     realt y = 0;
-    v_foreach (int, i, ff_.idx)
-        y += mgr_.get_function(*i)->calculate_value(x);
+    vector<const Support*> found;
+    find_supports(x, x, found);
+    v_foreach (const Support*, s, found)
+        y += mgr_.get_function(ff_.idx[(*s)->pos])->calculate_value(x);
     return y;
 }
 
@@ -67,6 +84,140 @@ realt Model::zero_shift(realt x) const
     return z;
 }
 
+// Points are processed in tiles: all functions are evaluated on one tile
+// before moving to the next one, so that y and dy_da are updated while they
+// are in cache. Functions that are negligible (function_cutoff) in the tile
+// are skipped.
+static const int kValueTileSize = 4096;
+// in the derivative mode the tile is sized to keep dy_da in L2 cache
+static const int kDerivTileBytes = 128 * 1024;
+
+void Model::update_supports() const
+{
+    double cut_level = ctx_->get_settings()->function_cutoff;
+    if (supports_stamp_ == mgr_.stamp() && supports_cutoff_ == cut_level
+            && supports_.size() == ff_.idx.size()) {
+        // without cutoff all supports are infinite, parameters don't matter
+        if (cut_level != 0. && supports_values_stamp_ != mgr_.values_stamp())
+            update_support_ranges(cut_level, false);
+        return;
+    }
+    supports_.resize(ff_.idx.size());
+    for (size_t i = 0; i != ff_.idx.size(); ++i)
+        supports_[i].pos = i;
+    update_support_ranges(cut_level, true);
+    supports_stamp_ = mgr_.stamp();
+    supports_cutoff_ = cut_level;
+}
+
+// Updates ranges in supports_ and sorts them. If only parameters changed
+// (!rebuild), the order hardly changes and insertion sort is used,
+// it is linear for almost sorted data.
+void Model::update_support_ranges(double cut_level, bool rebuild) const
+{
+    const realt inf = numeric_limits<realt>::infinity();
+    vm_foreach (Support, s, supports_) {
+        const Function* f = mgr_.get_function(ff_.idx[s->pos]);
+        // !(left <= right) is also true for NaN
+        if (cut_level == 0. || !f->get_nonzero_range(cut_level,
+                                                     s->left, s->right)
+                || !(s->left <= s->right)) {
+            s->left = -inf;
+            s->right = inf;
+        }
+    }
+    // without cutoff all supports are infinite and are kept in F order
+    if (cut_level != 0. && rebuild)
+        sort(supports_.begin(), supports_.end());
+    else if (cut_level != 0.) {
+        for (size_t i = 1; i < supports_.size(); ++i) {
+            Support t = supports_[i];
+            size_t j = i;
+            for (; j > 0 && t < supports_[j-1]; --j)
+                supports_[j] = supports_[j-1];
+            supports_[j] = t;
+        }
+    }
+    max_right_.resize(supports_.size());
+    for (size_t i = 0; i != supports_.size(); ++i)
+        max_right_[i] = (i == 0 ? supports_[i].right
+                                : max(max_right_[i-1], supports_[i].right));
+    supports_values_stamp_ = mgr_.values_stamp();
+}
+
+// finds supports that intersect [x1, x2], returns them in F order
+void Model::find_supports(realt x1, realt x2,
+                          vector<const Support*>& found) const
+{
+    update_supports();
+    found.clear();
+    if (supports_cutoff_ == 0.) {
+        v_foreach (Support, s, supports_)
+            found.push_back(&*s);
+        return;
+    }
+    Support key;
+    key.left = x2;
+    int end = upper_bound(supports_.begin(), supports_.end(), key)
+              - supports_.begin();
+    int begin = lower_bound(max_right_.begin(), max_right_.begin() + end, x1)
+                - max_right_.begin();
+    for (int i = begin; i < end; ++i)
+        if (supports_[i].right >= x1)
+            found.push_back(&supports_[i]);
+    sort(found.begin(), found.end(), Support::pos_less);
+}
+
+vector<int> Model::get_ff_in_range(realt x1, realt x2) const
+{
+    vector<const Support*> found;
+    find_supports(x1, x2, found);
+    vector<int> positions(found.size());
+    for (size_t i = 0; i != found.size(); ++i)
+        positions[i] = found[i]->pos;
+    return positions;
+}
+
+void Model::get_nonzero_ranges(const vector<realt> &x, int ignore_func,
+                               vector<FuncRange>& ranges) const
+{
+    ranges.clear();
+    if (x.empty())
+        return;
+    vector<const Support*> found;
+    find_supports(x.front(), x.back(), found);
+    ranges.reserve(found.size());
+    const realt inf = numeric_limits<realt>::infinity();
+    v_foreach (const Support*, s, found) {
+        int n = ff_.idx[(*s)->pos];
+        if (n == ignore_func)
+            continue;
+        FuncRange r;
+        r.func = mgr_.get_function(n);
+        r.first = 0;
+        r.last = x.size();
+        if ((*s)->left != -inf)
+            r.first = lower_bound(x.begin(), x.end(), (*s)->left) - x.begin();
+        if ((*s)->right != inf)
+            r.last = upper_bound(x.begin(), x.end(), (*s)->right) - x.begin();
+        if (r.first < r.last)
+            ranges.push_back(r);
+    }
+}
+
+void Model::get_zz_nonzero_ranges(const vector<realt> &x,
+                                  vector<FuncRange>& ranges) const
+{
+    ranges.clear();
+    v_foreach (int, i, zz_.idx) {
+        FuncRange r;
+        r.func = mgr_.get_function(*i);
+        r.func->get_nonzero_idx_range(x, r.first, r.last);
+        if (r.first < r.last)
+            ranges.push_back(r);
+    }
+}
+
 void Model::compute_model(vector<realt> &x, vector<realt> &y,
                           int ignore_func) const
 {
@@ -74,9 +225,27 @@ void Model::compute_model(vector<realt> &x, vector<realt> &y,
     v_foreach (int, i, zz_.idx)
         mgr_.get_function(*i)->calculate_value(x, x);
     // add y-value to y
-    v_foreach (int, i, ff_.idx)
-        if (*i != ignore_func)
-            mgr_.get_function(*i)->calculate_value(x, y);
+    if (has_convolution())
+        convolve_ff(x, y, NULL, ignore_func);
+    else
+        add_ff(x, y, ignore_func);
+}
+
+void Model::add_ff(const vector<realt> &x, vector<realt> &y,
+                   int ignore_func) const
+{
+    vector<FuncRange> ranges;
+    get_nonzero_ranges(x, ignore_func, ranges);
+    const int n = x.size();
+    for (int tstart = 0; tstart < n; tstart += kValueTileSize) {
+        int tend = min(n, tstart + kValueTileSize);
+        v_foreach (FuncRange, r, ranges) {
+            int first = max(r->first, tstart);
+            int last = min(r->last, tend);
+            if (first < last)
+                r->func->calculate_value_in_range(x, y, first, last);
+        }
+    }
 }
 
 // returns y values in y, x is changed in place to x+Z,
@@ -98,10 +267,288 @@ void Model::compute_model_with_derivs(vector<realt> &x, vector<realt> &y,
         mgr_.get_function(*i)->calculate_value(x, x);
 
     // calculate value and derivatives
-    v_foreach (int, i, ff_.idx)
-        mgr_.get_function(*i)->calculate_value_deriv(x, y, dy_da, false);
-    v_foreach (int, i, zz_.idx)
-        mgr_.get_function(*i)->calculate_value_deriv(x, y, dy_da, true);
+    vector<FuncRange> z_ranges;
+    get_zz_nonzero_ranges(x, z_ranges);
+    if (!has_convolution()) {
+        add_ff_with_derivs(x, y, dy_da, &z_ranges);
+        return;
+    }
+    convolve_ff(x, y, &dy_da, -1);
+    // uses dy/dx of the convolved model
+    v_foreach (FuncRange, r, z_ranges)
+        r->func->calculate_value_deriv_in_range(x, y, dy_da, true,
+                                                r->first, r->last);
+}
+
+// if z_ranges is not NULL, derivatives of Z are also calculated
+void Model::add_ff_with_derivs(const vector<realt> &x, vector<realt> &y,
+                               vector<realt> &dy_da,
+                               const vector<FuncRange>* z_ranges) const
+{
+    vector<FuncRange> f_ranges;
+    get_nonzero_ranges(x, -1, f_ranges);
+    const int n = x.size();
+    const int dyn = dy_da.size() / n;
+    const int tile_size = max(16, kDerivTileBytes / (dyn * (int)sizeof(realt)));
+    for (int tstart = 0; tstart < n; tstart += tile_size) {
+        int tend = min(n, tstart + tile_size);
+        v_foreach (FuncRange, r, f_ranges) {
+            int first = max(r->first, tstart);
+            int last = min(r->last, tend);
+            if (first < last)
+                r->func->calculate_value_deriv_in_range(x, y, dy_da, false,
+                                                        first, last);
+        }
+        if (z_ranges == NULL)
+            continue;
+        // uses dy/dx that was summed over all functions in F
+        const vector<FuncRange>& zr = *z_ranges;
+        v_foreach (FuncRange, r, zr) {
+            int first = max(r->first, tstart);
+            int last = min(r->last, tend);
+            if (first < last)
+                r->func->calculate_value_deriv_in_range(x, y, dy_da, true,
+                                                        first, last);
+        }
+    }
+}
+
+// Convolution with the instrument function R:
+//   y(x) = integral F(x-t) R(t) dt / integral R(t) dt.
+// R is sampled in bins of width h (the step of x) and F is calculated
+// at x extended by the width of R, so that the sum is a discrete
+// convolution, computed using FFT for wide kernels. If x is not evenly
+// spaced the sum is calculated directly for each point.
+
+// Functions in R are truncated where they drop below this fraction
+// of their height.
+static const double kKernelCutoff = 1e-5;
+// Each bin of the sampled kernel is an average over a few points,
+// so that narrow kernels are not lost; at least this many points
+// are taken across the kernel.
+static const int kKernelMinPoints = 16;
+static const int kKernelMaxSubsteps = 64;
+// number of steps across the kernel if neither x nor the dataset
+// is evenly spaced
+static const int kKernelSteps = 64;
+
+/// instrument function sampled with step h: w[m] is the weight at offset
+/// (kmin+m)*h, normalized to sum(w) = 1; dw[j*nk+m] is the derivative
+/// of w[m] with respect to parameter dpar[j]
+struct SampledKernel
+{
+    realt h;
+    int kmin;
+    vector<realt> w;
+    vector<int> dpar;
+    vector<realt> dw;
+    int nk() const { return w.size(); }
+};
+
+void Model::get_kernel_range(realt& left, realt& right) const
+{
+    left = numeric_limits<realt>::infinity();
+    right = -left;
+    if (!rr_data_.empty()) {
+        left = rr_data_.front().x;
+        right = rr_data_.back().x;
+    }
+    v_foreach (int, i, rr_.idx) {
+        const Function* f = mgr_.get_function(*i);
+        realt height, l, r;
+        if (!f->get_height(&height) || height == 0.
+                || !f->get_nonzero_range(kKernelCutoff * fabs(height), l, r)
+                || !is_finite(l) || !is_finite(r))
+            throw ExecuteError("can't find the width of %" + f->name
+                               + " (in R)");
+        left = min(left, min(l, r));
+        right = max(right, max(l, r));
+    }
+}
+
+void Model::sample_kernel(realt h, bool with_derivs, int dyn,
+                          SampledKernel& k) const
+{
+    realt left, right;
+    get_kernel_range(left, right);
+    k.h = h;
+    k.kmin = iround(left / h);
+    const int nk = iround(right / h) - k.kmin + 1;
+    int sub = kKernelMaxSubsteps;
+    if (right > left)
+        sub = max(1, min(kKernelMaxSubsteps,
+                         (int) ceil(kKernelMinPoints * h / (right - left))));
+    const int nt = nk * sub;
+    vector<realt> tx(nt), ty(nt, 0.), dt;
+    for (int m = 0; m < nk; ++m)
+        for (int j = 0; j < sub; ++j)
+            tx[m*sub+j] = (k.kmin + m + (j + 0.5) / sub - 0.5) * h;
+    if (with_derivs)
+        dt.resize(nt * dyn, 0.);
+    v_foreach (int, i, rr_.idx) {
+        const Function* f = mgr_.get_function(*i);
+        if (with_derivs)
+            f->calculate_value_deriv_in_range(tx, ty, dt, false, 0, nt);
+        else
+            f->calculate_value_in_range(tx, ty, 0, nt);
+    }
+    // linear interpolation of the tabulated function, zero outside
+    if (!rr_data_.empty()) {
+        size_t pos = 0;
+        for (int i = 0; i < nt; ++i) {
+            realt t = tx[i];
+            if (t < rr_data_.front().x || t > rr_data_.back().x)
+                continue;
+            while (pos + 2 < rr_data_.size() && rr_data_[pos+1].x < t)
+                ++pos;
+            const PointD& a = rr_data_[pos];
+            const PointD& b = rr_data_[pos+1];
+            if (b.x > a.x)
+                ty[i] += a.y + (b.y - a.y) * (t - a.x) / (b.x - a.x);
+        }
+    }
+
+    k.w.assign(nk, 0.);
+    realt sum = 0.;
+    for (int m = 0; m < nk; ++m) {
+        for (int j = 0; j < sub; ++j)
+            k.w[m] += ty[m*sub+j];
+        sum += k.w[m];
+    }
+    if (sum == 0. || !is_finite(sum))
+        throw ExecuteError("the instrument function R has zero area");
+    for (int m = 0; m < nk; ++m)
+        k.w[m] /= sum;
+
+    k.dpar.clear();
+    k.dw.clear();
+    if (!with_derivs)
+        return;
+    // d(w_m)/dp = (dK_m/dp - w_m * sum(dK/dp)) / sum(K)
+    vector<realt> d(nk);
+    for (int p = 0; p < dyn - 1; ++p) { // the last column is dy/dx
+        realt dsum = 0.;
+        bool nonzero = false;
+        for (int m = 0; m < nk; ++m) {
+            d[m] = 0.;
+            for (int j = 0; j < sub; ++j)
+                d[m] += dt[(m*sub+j)*dyn + p];
+            dsum += d[m];
+            if (d[m] != 0.)
+                nonzero = true;
+        }
+        if (!nonzero)
+            continue;
+        k.dpar.push_back(p);
+        for (int m = 0; m < nk; ++m)
+            k.dw.push_back((d[m] - k.w[m] * dsum) / sum);
+    }
+}
+
+// returns step if x is evenly spaced (within the same tolerance as in
+// Data::get_x_step()), 0 otherwise
+static realt find_fixed_step(const vector<realt> &x)
+{
+    const int n = x.size();
+    if (n < 2)
+        return 0.;
+    realt h = (x.back() - x.front()) / (n - 1);
+    if (!(h > 0))
+        return 0.;
+    realt max_diff = 1e-4 * h;
+    for (int i = 1; i < n - 1; ++i)
+        if (fabs(x[i] - x.front() - i * h) > max_diff)
+            return 0.;
+    return h;
+}
+
+void Model::convolve_ff(const vector<realt> &x, vector<realt> &y,
+                        vector<realt> *dy_da, int ignore_func) const
+{
+    const int n = x.size();
+    if (n == 0)
+        return;
+    const int dyn = dy_da != NULL ? dy_da->size() / n : 0;
+    SampledKernel k;
+    realt h = find_fixed_step(x);
+    if (h != 0.) {
+        sample_kernel(h, dy_da != NULL, dyn, k);
+        const int nk = k.nk();
+        const int kmax = k.kmin + nk - 1;
+        // F is calculated at g[j] = x[j - kmax + kmin]
+        const int ng = n + nk - 1;
+        vector<realt> g(ng), yg(ng, 0.);
+        for (int j = 0; j < ng; ++j)
+            g[j] = x[0] + (j - kmax) * h;
+        KernelConvolution conv(&k.w[0], nk, ng);
+        if (dy_da == NULL) {
+            add_ff(g, yg, ignore_func);
+            conv.add(&yg[0], 1, &y[0], 1);
+            return;
+        }
+        vector<realt> dyg(ng * dyn, 0.);
+        add_ff_with_derivs(g, yg, dyg, NULL);
+        conv.add(&yg[0], 1, &y[0], 1);
+        // only non-zero columns are convolved, two at a time
+        vector<int> cols;
+        for (int c = 0; c < dyn; ++c)
+            for (int j = 0; j < ng; ++j)
+                if (dyg[j*dyn+c] != 0.) {
+                    cols.push_back(c);
+                    break;
+                }
+        realt *out = &(*dy_da)[0];
+        for (size_t i = 0; i < cols.size(); i += 2) {
+            if (i + 1 < cols.size())
+                conv.add2(&dyg[cols[i]], &dyg[cols[i+1]], dyn,
+                          out + cols[i], out + cols[i+1], dyn);
+            else
+                conv.add(&dyg[cols[i]], dyn, out + cols[i], dyn);
+        }
+        // parameters of R
+        for (size_t j = 0; j < k.dpar.size(); ++j) {
+            KernelConvolution dconv(&k.dw[j*nk], nk, ng);
+            dconv.add(&yg[0], 1, out + k.dpar[j], dyn);
+        }
+        return;
+    }
+
+    // x is not evenly spaced (or it's a single point), direct summation
+    // for each point; R is sampled with the same step as for the dataset
+    if (data_step_ != NULL && *data_step_ > 0)
+        h = *data_step_;
+    else {
+        realt left, right;
+        get_kernel_range(left, right);
+        h = (right > left ? (right - left) / kKernelSteps : 1.);
+    }
+    sample_kernel(h, dy_da != NULL, dyn, k);
+    const int nk = k.nk();
+    const int kmax = k.kmin + nk - 1;
+    vector<realt> xs(nk), ys(nk), dys(nk * dyn);
+    for (int i = 0; i < n; ++i) {
+        for (int m = 0; m < nk; ++m)
+            xs[m] = x[i] - (kmax - m) * h;
+        fill(ys.begin(), ys.end(), 0.);
+        if (dy_da == NULL) {
+            add_ff(xs, ys, ignore_func);
+            for (int m = 0; m < nk; ++m)
+                y[i] += k.w[nk-1-m] * ys[m];
+            continue;
+        }
+        fill(dys.begin(), dys.end(), 0.);
+        add_ff_with_derivs(xs, ys, dys, NULL);
+        realt *out = &(*dy_da)[i*dyn];
+        for (int m = 0; m < nk; ++m) {
+            realt wm = k.w[nk-1-m];
+            y[i] += wm * ys[m];
+            for (int c = 0; c < dyn; ++c)
+                out[c] += wm * dys[m*dyn+c];
+        }
+        for (size_t j = 0; j < k.dpar.size(); ++j)
+            for (int m = 0; m < nk; ++m)
+                out[k.dpar[j]] += k.dw[j*nk+nk-1-m] * ys[m];
+    }
 }
 
 realt Model::calculate_value_and_deriv(realt x, vector<realt> &dy_da) const
@@ -266,6 +713,8 @@ int Model::max_param_pos() const
         n = max(mgr_.get_function(*i)->max_param_pos(), n);
     v_foreach (int, i, zz_.idx)
         n = max(mgr_.get_function(*i)->max_param_pos(), n);
+    v_foreach (int, i, rr_.idx)
+        n = max(mgr_.get_function(*i)->max_param_pos(), n);
     return n;
 }
 
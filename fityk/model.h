@@ -8,15 +8,18 @@
 #include <utility>
 #include "fityk.h"
 #include "common.h" // DISALLOW_COPY_AND_ASSIGN
+#include "numfuncs.h" // PointD
 
 namespace fityk {
 
 class ModelManager;
 class BasicContext;
+class Function;
+struct SampledKernel;
 
 struct FunctionSum
 {
-    /// names of functions in F/Z, i.e. names of the component functions
+    /// names of functions in F/Z/R, i.e. names of the component functions
     std::vector<std::string> names;
     /// indices corresponding to the names in names
     std::vector<int> idx;
@@ -26,7 +29,8 @@ struct FunctionSum
 
 ///  This class contains description of curve which we are trying to fit
 ///  to data. This curve is described simply by listing names of functions
-///  in F and in Z (Z contains x-corrections)
+///  in F and in Z (Z contains x-corrections). Optionally, F is convolved
+///  with the instrument function R (sum of functions or a copy of dataset).
 class FITYK_API Model
 {
 public:
@@ -56,13 +60,30 @@ public:
     std::vector<realt> get_numeric_derivatives(realt x, realt numerical_h)const;
     realt zero_shift(realt x) const;
 
-    // ff_ and zz_ getters
+    // ff_, zz_ and rr_ getters
     const FunctionSum& get_ff() const { return ff_; }
     FunctionSum& get_ff() { return ff_; }
     const FunctionSum& get_zz() const { return zz_; }
     FunctionSum& get_zz() { return zz_; }
-    const FunctionSum& get_fz(char c) const { return (c == 'F' ? ff_ : zz_); }
-    FunctionSum& get_fz(char c) { return (c == 'F' ? ff_ : zz_); }
+    const FunctionSum& get_rr() const { return rr_; }
+    FunctionSum& get_rr() { return rr_; }
+    const FunctionSum& get_fz(char c) const
+        { return c == 'F' ? ff_ : (c == 'Z' ? zz_ : rr_); }
+    FunctionSum& get_fz(char c)
+        { return c == 'F' ? ff_ : (c == 'Z' ? zz_ : rr_); }
+
+    /// tabulated instrument function (copied from dataset), used with rr_
+    const std::vector<PointD>& get_rr_data() const { return rr_data_; }
+    /// index of the dataset from which rr_data_ was copied
+    int get_rr_data_source() const { return rr_data_source_; }
+    void set_rr_data(const std::vector<PointD>& p, int source_ds)
+        { rr_data_ = p; rr_data_source_ = source_ds; }
+    bool has_convolution() const
+        { return !rr_.empty() || !rr_data_.empty(); }
+    /// x step of the dataset that owns this model (0 if not fixed);
+    /// convolution at arbitrary x samples R with this step, as it is
+    /// done for the whole dataset
+    void set_data_step(const double *h) { data_step_ = h; }
 
     // throws SyntaxError if index `idx' is wrong
     const std::string& get_func_name(char c, int idx) const;
@@ -72,14 +93,71 @@ public:
     int max_param_pos() const;
     realt calculate_value_and_deriv(realt x, std::vector<realt> &dy_da) const;
 
+    /// positions (in F) of functions that are not negligible somewhere
+    /// in [x1, x2], according to the function_cutoff option
+    std::vector<int> get_ff_in_range(realt x1, realt x2) const;
+
 private:
     const BasicContext* ctx_;
     ModelManager &mgr_;
-    FunctionSum ff_, zz_;
+    FunctionSum ff_, zz_, rr_;
+    std::vector<PointD> rr_data_;
+    int rr_data_source_;
+    const double *data_step_;
+
+    /// function and the range of point indices where it is not negligible
+    struct FuncRange
+    {
+        const Function* func;
+        int first, last;
+    };
+
+    /// range where function in F is not negligible (function_cutoff)
+    struct Support
+    {
+        realt left, right;
+        int pos; ///< position of the function in ff_
+        bool operator<(const Support& s) const { return left < s.left; }
+        static bool pos_less(const Support* a, const Support* b)
+            { return a->pos < b->pos; }
+    };
+    // supports of functions in F sorted by the left bound,
+    // rebuilt when ModelManager::stamp() or function_cutoff changes,
+    // only the ranges are updated when values_stamp() changes
+    mutable std::vector<Support> supports_;
+    // max_right_[i] is the max. right bound in supports_[0..i]
+    mutable std::vector<realt> max_right_;
+    mutable int supports_stamp_;
+    mutable int supports_values_stamp_;
+    mutable double supports_cutoff_;
+
+    void update_supports() const;
+    void update_support_ranges(double cut_level, bool rebuild) const;
+    void find_supports(realt x1, realt x2,
+                       std::vector<const Support*>& found) const;
+    void get_nonzero_ranges(const std::vector<realt> &x, int ignore_func,
+                            std::vector<FuncRange>& ranges) const;
+    void get_zz_nonzero_ranges(const std::vector<realt> &x,
+                               std::vector<FuncRange>& ranges) const;
+    void add_ff(const std::vector<realt> &x, std::vector<realt> &y,
+                int ignore_func) const;
+    void add_ff_with_derivs(const std::vector<realt> &x, std::vector<realt> &y,
+                            std::vector<realt> &dy_da,
+                            const std::vector<FuncRange>* z_ranges) const;
+
+    // convolution with R
+    void get_kernel_range(realt& left, realt& right) const;
+    void sample_kernel(realt h, bool with_derivs, int dyn,
+                       SampledKernel& k) const;
+    void convolve_ff(const std::vector<realt> &x, std::vector<realt> &y,
+                     std::vector<realt> *dy_da, int ignore_func) const;
 
     // can be created/deleted only from ModelManager
     friend class ModelManager;
-    Model(const BasicContext *ctx, ModelManager &mgr) : ctx_(ctx), mgr_(mgr) {}
+    Model(const BasicContext *ctx, ModelManager &mgr)
+        : ctx_(ctx), mgr_(mgr), rr_data_source_(-1), data_step_(NULL),
+          supports_stamp_(-1), supports_values_stamp_(-1),
+          supports_cutoff_(0.) {}
     ~Model() {}
 
     DISALLOW_COPY_AND_ASSIGN(Model);
@@ -0,0 +1,443 @@
+// This file is part of fityk program. Copyright 2001-2013 Marcin Wojdyr
+// Licence: GNU General Public License ver. 2+
+
+#define BUILDING_LIBFITYK
+#include "plugin.h"
+
+#include <stdlib.h> // getenv
+#include <string.h> // strlen
+#include <sys/stat.h>
+#include <algorithm>
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <dlfcn.h>
+# include <dirent.h>
+#endif
+
+#include "common.h"
+#include "lexer.h"
+#include "tplate.h"
+#include "ui.h"
+
+using namespace std;
+
+namespace fityk {
+
+Function* create_PluginFunction(const Settings* s, const string& name,
+                                Tplate::Ptr tp, const vector<string>& vars)
+{
+    return new PluginFunction(s, name, tp, vars);
+}
+
+void PluginFunction::calculate_value_in_range(const vector<realt> &xx,
+                                              vector<realt> &yy,
+                                              int first, int last) const
+{
+    if (last <= first)
+        return;
+#if USE_LONG_DOUBLE
+    vector<double> x(xx.begin() + first, xx.begin() + last);
+    vector<double> y(last - first, 0.);
+    pt_->value(params(), last - first, &x[0], &y[0]);
+    for (int i = first; i < last; ++i)
+        yy[i] += y[i-first];
+#else
+    pt_->value(params(), last - first, &xx[first], &yy[first]);
+#endif
+}
+
+void PluginFunction::calculate_value_deriv_in_range(const vector<realt> &xx,
+                                                    vector<realt> &yy,
+                                                    vector<realt> &dy_da,
+                                                    bool in_dx,
+                                                    int first, int last) const
+{
+    int n = last - first;
+    if (n <= 0)
+        return;
+    int dyn = dy_da.size() / xx.size();
+    int np = nv();
+    vector<double> dy_dv(n * np + 1), dy_dx(n);
+#if USE_LONG_DOUBLE
+    vector<double> x(xx.begin() + first, xx.begin() + last), y(n, 0.);
+    pt_->value_deriv(params(), n, &x[0], &y[0], &dy_dv[0], &dy_dx[0]);
+    if (!in_dx)
+        for (int i = 0; i < n; ++i)
+            yy[first+i] += y[i];
+#else
+    vector<double> y_ignored;
+    if (in_dx)
+        y_ignored.resize(n, 0.);
+    pt_->value_deriv(params(), n, &xx[first],
+                     in_dx ? &y_ignored[0] : &yy[first],
+                     &dy_dv[0], &dy_dx[0]);
+#endif
+    // the same as CALCULATE_DERIV_END in bfunc.h
+    for (int i = 0; i < n; ++i) {
+        realt *d = &dy_da[dyn*(first+i)];
+        const double *dv = &dy_dv[np*i];
+        if (!in_dx) {
+            v_foreach (Multi, j, multi_)
+                d[j->p] += dv[j->n] * j->mult;
+            d[dyn-1] += dy_dx[i];
+        } else {
+            v_foreach (Multi, j, multi_)
+                d[j->p] += d[dyn-1] * dv[j->n] * j->mult;
+        }
+    }
+}
+
+bool PluginFunction::get_nonzero_range(double level,
+                                       realt &left, realt &right) const
+{
+    double l, r;
+    if (pt_->nonzero_range == NULL || !pt_->nonzero_range(params(), level,
+                                                          &l, &r))
+        return false;
+    left = l;
+    right = r;
+    return true;
+}
+
+bool PluginFunction::get_center(realt* a) const
+{
+    if (pt_->center == NULL)
+        return Function::get_center(a);
+    double c;
+    if (!pt_->center(params(), &c))
+        return false;
+    *a = c;
+    return true;
+}
+
+// calls optional function from plugin that returns a property
+static bool get_plugin_prop(int (*f)(const double*, double*),
+                            const double* p, realt* a)
+{
+    double val;
+    if (f == NULL || !f(p, &val))
+        return false;
+    *a = val;
+    return true;
+}
+
+bool PluginFunction::get_height(realt* a) const
+{
+    return get_plugin_prop(pt_->height, params(), a);
+}
+
+bool PluginFunction::get_fwhm(realt* a) const
+{
+    return get_plugin_prop(pt_->fwhm, params(), a);
+}
+
+bool PluginFunction::get_area(realt* a) const
+{
+    return get_plugin_prop(pt_->area, params(), a);
+}
+
+
+Function* create_CallbackFunction(const Settings* s, const string& name,
+                                  Tplate::Ptr tp, const vector<string>& vars)
+{
+    return new CallbackFunction(s, name, tp, vars);
+}
+
+void CallbackFunction::calculate_value_in_range(const vector<realt> &xx,
+                                                vector<realt> &yy,
+                                                int first, int last) const
+{
+    if (last > first)
+        cb_->value(params(), last - first, &xx[first], &yy[first]);
+}
+
+// central differences; each step is one call of the callback for all points
+void CallbackFunction::numeric_deriv(int n, const realt* x, realt* y,
+                                     realt* dy_dv, realt* dy_dx) const
+{
+    int np = nv();
+    vector<realt> p(av_.begin(), av_.begin() + np);
+    vector<realt> y1(n), y2(n);
+    cb_->value(params(), n, x, y);
+    for (int k = 0; k < np; ++k) {
+        realt orig = p[k];
+        realt h = std::max(fabs(orig), realt(1e-3)) * 1e-6;
+        fill(y1.begin(), y1.end(), 0.);
+        fill(y2.begin(), y2.end(), 0.);
+        p[k] = orig + h;
+        cb_->value(&p[0], n, x, &y1[0]);
+        p[k] = orig - h;
+        cb_->value(&p[0], n, x, &y2[0]);
+        p[k] = orig;
+        for (int i = 0; i < n; ++i)
+            dy_dv[np*i+k] = (y1[i] - y2[i]) / (2 * h);
+    }
+    vector<realt> xh(n), hx(n);
+    fill(y1.begin(), y1.end(), 0.);
+    fill(y2.begin(), y2.end(), 0.);
+    for (int i = 0; i < n; ++i) {
+        hx[i] = std::max(fabs(x[i]), realt(1e-3)) * 1e-6;
+        xh[i] = x[i] + hx[i];
+    }
+    cb_->value(params(), n, &xh[0], &y1[0]);
+    for (int i = 0; i < n; ++i)
+        xh[i] = x[i] - hx[i];
+    cb_->value(params(), n, &xh[0], &y2[0]);
+    for (int i = 0; i < n; ++i)
+        dy_dx[i] = (y1[i] - y2[i]) / (2 * hx[i]);
+}
+
+void CallbackFunction::calculate_value_deriv_in_range(const vector<realt> &xx,
+                                                      vector<realt> &yy,
+                                                      vector<realt> &dy_da,
+                                                      bool in_dx,
+                                                      int first,
+                                                      int last) const
+{
+    int n = last - first;
+    if (n <= 0)
+        return;
+    int dyn = dy_da.size() / xx.size();
+    int np = nv();
+    vector<realt> dy_dv(n * np + 1), dy_dx(n), y(n, 0.);
+    if (!cb_->value_deriv(params(), n, &xx[first], &y[0],
+                          &dy_dv[0], &dy_dx[0])) {
+        fill(y.begin(), y.end(), 0.);
+        numeric_deriv(n, &xx[first], &y[0], &dy_dv[0], &dy_dx[0]);
+    }
+    // the same as CALCULATE_DERIV_END in bfunc.h
+    for (int i = 0; i < n; ++i) {
+        realt *d = &dy_da[dyn*(first+i)];
+        const realt *dv = &dy_dv[np*i];
+        if (!in_dx) {
+            yy[first+i] += y[i];
+            v_foreach (Multi, j, multi_)
+                d[j->p] += dv[j->n] * j->mult;
+            d[dyn-1] += dy_dx[i];
+        } else {
+            v_foreach (Multi, j, multi_)
+                d[j->p] += d[dyn-1] * dv[j->n] * j->mult;
+        }
+    }
+}
+
+
+// checks if the whole string is a single token of given type
+static bool is_token(const string& s, TokenType tt)
+{
+    try {
+        Lexer lex(s.c_str());
+        return lex.get_token().type == tt &&
+               lex.get_token().type == kTokenNop;
+    }
+    catch (SyntaxError&) {
+        return false;
+    }
+}
+
+// makes template of type defined outside of fityk, create is not set
+static boost::shared_ptr<Tplate> new_external_tplate(
+                const string& err_prefix, const char* name, const char* params,
+                const char* defvals, int traits)
+{
+    if (name == NULL || !is_token(name, kTokenCname))
+        throw ExecuteError(err_prefix + "wrong name, it should be "
+                           "CamelCase, like MyPeak.");
+    if (params == NULL)
+        throw ExecuteError(err_prefix + "params must be set.");
+    boost::shared_ptr<Tplate> tp(new Tplate);
+    tp->name = name;
+    if (params[0] != '\0') {
+        tp->fargs = split_string(params, ',');
+        if (defvals != NULL && defvals[0] != '\0')
+            tp->defvals = split_string(defvals, ',');
+        else
+            tp->defvals.resize(tp->fargs.size());
+    }
+    v_foreach (string, a, tp->fargs)
+        if (!is_token(*a, kTokenLname) || *a == "x")
+            throw ExecuteError(err_prefix + "wrong parameter name: " + *a);
+    if (tp->defvals.size() != tp->fargs.size())
+        throw ExecuteError(err_prefix + S(tp->fargs.size())
+                           + " parameter(s), but "
+                           + S(tp->defvals.size()) + " default value(s)");
+    tp->traits = traits & (Tplate::kLinear | Tplate::kPeak | Tplate::kSigmoid);
+    tp->docs_fragment = NULL;
+    tp->plugin_type = NULL;
+    // throws SyntaxError if default values can't be parsed
+    tp->get_missing_default_values();
+    return tp;
+}
+
+vector<Tplate::Ptr> make_plugin_tplates(const FitykPluginType* types,
+                                        int count, const string& path)
+{
+    if (types == NULL || count <= 0)
+        throw ExecuteError("Plugin " + path + " defines no function types"
+                           " (for ABI version "
+                           + S(FITYK_PLUGIN_ABI_VERSION) + ").");
+    vector<Tplate::Ptr> result;
+    for (int i = 0; i != count; ++i) {
+        const FitykPluginType& pt = types[i];
+        string err_prefix = "Plugin " + path + ", type #" + S(i) + ": ";
+        if (pt.abi_version != FITYK_PLUGIN_ABI_VERSION)
+            throw ExecuteError(err_prefix + "ABI version " + S(pt.abi_version)
+                               + ", expected "
+                               + S(FITYK_PLUGIN_ABI_VERSION));
+        if (pt.value == NULL || pt.value_deriv == NULL)
+            throw ExecuteError(err_prefix + "value and value_deriv "
+                               "must be set.");
+        boost::shared_ptr<Tplate> tp = new_external_tplate(err_prefix,
+                               pt.name, pt.params, pt.defvals, pt.traits);
+        tp->rhs = pt.formula != NULL ? string(pt.formula)
+                                     : "compiled in " + path + " #";
+        tp->create = &create_PluginFunction;
+        tp->plugin_type = &pt;
+        tp->plugin_path = path;
+        result.push_back(tp);
+    }
+    return result;
+}
+
+Tplate::Ptr make_callback_tplate(const string& name, const string& params,
+                                 const string& defvals, int traits,
+                                 boost::shared_ptr<FuncTypeCallback> callback)
+{
+    if (!callback)
+        throw ExecuteError("No callback for function type " + name);
+    boost::shared_ptr<Tplate> tp = new_external_tplate(name + ": ",
+                        name.c_str(), params.c_str(), defvals.c_str(), traits);
+    tp->rhs = "calculated by callback #";
+    tp->create = &create_CallbackFunction;
+    tp->callback = callback;
+    return tp;
+}
+
+static bool is_directory(const string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR;
+}
+
+static bool has_plugin_extension(const string& filename)
+{
+#if defined(_WIN32)
+    const char* ext = ".dll";
+#elif defined(__APPLE__)
+    const char* ext = ".dylib";
+#else
+    const char* ext = ".so";
+#endif
+    size_t len = strlen(ext);
+    return filename.size() > len &&
+           filename.compare(filename.size() - len, len, ext) == 0;
+}
+
+vector<string> find_plugins(const string& path)
+{
+    if (!is_directory(path))
+        return vector1(path);
+    vector<string> files;
+#ifdef _WIN32
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileA((path + "\\*").c_str(), &fd);
+    if (h != INVALID_HANDLE_VALUE) {
+        do {
+            if (has_plugin_extension(fd.cFileName))
+                files.push_back(path + "\\" + fd.cFileName);
+        } while (FindNextFileA(h, &fd));
+        FindClose(h);
+    }
+#else
+    DIR *dir = opendir(path.c_str());
+    if (dir == NULL)
+        throw ExecuteError("Cannot open directory: " + path);
+    while (const struct dirent *e = readdir(dir))
+        if (has_plugin_extension(e->d_name))
+            files.push_back(path + "/" + e->d_name);
+    closedir(dir);
+#endif
+    // the order of types (info types) should not depend on the file system
+    sort(files.begin(), files.end());
+    return files;
+}
+
+vector<Tplate::Ptr> load_plugin(const string& path)
+{
+    FitykPluginTypesFunc types_func = NULL;
+#ifdef _WIN32
+    HMODULE handle = LoadLibraryA(path.c_str());
+    if (handle == NULL)
+        throw ExecuteError("Cannot load plugin: " + path);
+    types_func = (FitykPluginTypesFunc) GetProcAddress(handle,
+                                                FITYK_PLUGIN_TYPES_SYMBOL);
+#else
+    // without slash dlopen() searches only system directories
+    string p = contains_element(path, '/') ? path : "./" + path;
+    void *handle = dlopen(p.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL)
+        throw ExecuteError("Cannot load plugin: " + string(dlerror()));
+    types_func = (FitykPluginTypesFunc) dlsym(handle,
+                                              FITYK_PLUGIN_TYPES_SYMBOL);
+#endif
+    // Functions that were created can be used until the program ends,
+    // so the library is not unloaded even if it's not a plugin.
+    if (types_func == NULL)
+        throw ExecuteError(path + " is not a fityk plugin (function "
+                           FITYK_PLUGIN_TYPES_SYMBOL "() not found).");
+    int count = 0;
+    const FitykPluginType* types = (*types_func)(FITYK_PLUGIN_ABI_VERSION,
+                                                 &count);
+    return make_plugin_tplates(types, count, path);
+}
+
+vector<string> define_plugin_types(TplateMgr* tpm,
+                                   const vector<Tplate::Ptr>& tps)
+{
+    vector<string> names;
+    v_foreach (Tplate::Ptr, tp, tps) {
+        const Tplate* old = tpm->get_tp((*tp)->name);
+        if (old != NULL && old->create == &create_PluginFunction &&
+                old->plugin_type == (*tp)->plugin_type)
+            continue;
+        tpm->define(*tp);
+        names.push_back((*tp)->name);
+    }
+    return names;
+}
+
+void load_plugins_from_env(TplateMgr* tpm, const UserInterface* ui)
+{
+    const char* env = getenv("FITYK_PLUGIN_PATH");
+    if (env == NULL)
+        return;
+#ifdef _WIN32
+    const char sep = ';';
+#else
+    const char sep = ':';
+#endif
+    vector<string> dirs = split_string(env, sep);
+    v_foreach (string, dir, dirs) {
+        // directories that don't exist are silently ignored
+        if (!is_directory(*dir))
+            continue;
+        vector<string> files;
+        try {
+            files = find_plugins(*dir);
+        }
+        catch (ExecuteError& e) {
+            ui->warn(e.what());
+        }
+        v_foreach (string, f, files) {
+            try {
+                define_plugin_types(tpm, load_plugin(*f));
+            }
+            catch (std::exception& e) {
+                ui->warn(e.what());
+            }
+        }
+    }
+}
+
+} // namespace fityk
@@ -0,0 +1,117 @@
+// This file is part of fityk program. Copyright 2001-2013 Marcin Wojdyr
+// Licence: GNU General Public License ver. 2+
+
+/// Function types defined outside of fityk: compiled in plugins (shared
+/// libraries, see plugin_api.h) or calculated by the host program
+/// (FuncTypeCallback in fityk.h).
+
+#ifndef FITYK_PLUGIN_H_
+#define FITYK_PLUGIN_H_
+
+#include "func.h"
+#include "plugin_api.h"
+
+namespace fityk {
+
+class TplateMgr;
+class UserInterface;
+
+/// %function of type defined in a plugin, all calculations are delegated
+/// to the plugin
+class PluginFunction : public Function
+{
+public:
+    PluginFunction(const Settings* settings, const std::string &name,
+                   Tplate::Ptr tp, const std::vector<std::string> &vars)
+        : Function(settings, name, tp, vars), pt_(tp->plugin_type) {}
+    void calculate_value_in_range(const std::vector<realt> &xx,
+                                  std::vector<realt> &yy,
+                                  int first, int last) const;
+    void calculate_value_deriv_in_range(const std::vector<realt> &xx,
+                                        std::vector<realt> &yy,
+                                        std::vector<realt> &dy_da,
+                                        bool in_dx,
+                                        int first, int last) const;
+    bool get_nonzero_range(double level, realt &left, realt &right) const;
+    bool get_center(realt* a) const;
+    bool get_height(realt* a) const;
+    bool get_fwhm(realt* a) const;
+    bool get_area(realt* a) const;
+
+private:
+    const FitykPluginType* pt_;
+
+    // the plugin API uses double, with long double the values are copied
+#if USE_LONG_DOUBLE
+    mutable std::vector<double> dav_;
+    const double* params() const {
+        dav_.assign(av_.begin(), av_.end());
+        return dav_.empty() ? NULL : &dav_[0];
+    }
+#else
+    const double* params() const { return av_.empty() ? NULL : &av_[0]; }
+#endif
+    DISALLOW_COPY_AND_ASSIGN(PluginFunction);
+};
+
+Function* create_PluginFunction(const Settings* s, const std::string& name,
+                        Tplate::Ptr tp, const std::vector<std::string>& vars);
+
+/// %function of type registered with Fityk::define_callback_type(),
+/// values are calculated by FuncTypeCallback, for all points at once
+class CallbackFunction : public Function
+{
+public:
+    CallbackFunction(const Settings* settings, const std::string &name,
+                     Tplate::Ptr tp, const std::vector<std::string> &vars)
+        : Function(settings, name, tp, vars), cb_(tp->callback.get()) {}
+    void calculate_value_in_range(const std::vector<realt> &xx,
+                                  std::vector<realt> &yy,
+                                  int first, int last) const;
+    void calculate_value_deriv_in_range(const std::vector<realt> &xx,
+                                        std::vector<realt> &yy,
+                                        std::vector<realt> &dy_da,
+                                        bool in_dx,
+                                        int first, int last) const;
+private:
+    FuncTypeCallback* cb_;
+
+    const realt* params() const { return av_.empty() ? NULL : &av_[0]; }
+    void numeric_deriv(int n, const realt* x, realt* y,
+                       realt* dy_dv, realt* dy_dx) const;
+    DISALLOW_COPY_AND_ASSIGN(CallbackFunction);
+};
+
+Function* create_CallbackFunction(const Settings* s, const std::string& name,
+                        Tplate::Ptr tp, const std::vector<std::string>& vars);
+
+/// makes templates from the types returned by plugin (path is only stored)
+std::vector<Tplate::Ptr> make_plugin_tplates(const FitykPluginType* types,
+                                             int count,
+                                             const std::string& path);
+
+/// makes template for Fityk::define_callback_type()
+Tplate::Ptr make_callback_tplate(const std::string& name,
+                                 const std::string& params,
+                                 const std::string& defvals, int traits,
+                                 boost::shared_ptr<FuncTypeCallback> callback);
+
+/// returns path if it is a file, or plugins (.so/.dylib/.dll files)
+/// in path if it is a directory
+std::vector<std::string> find_plugins(const std::string& path);
+
+/// loads shared library and returns types defined in it;
+/// the library is never unloaded
+std::vector<Tplate::Ptr> load_plugin(const std::string& path);
+
+/// defines types in tpm, types that were already loaded from the same
+/// plugin are skipped; returns names of new types
+std::vector<std::string> define_plugin_types(TplateMgr* tpm,
+                                       const std::vector<Tplate::Ptr>& tps);
+
+/// loads plugins from directories listed in FITYK_PLUGIN_PATH
+/// environment variable, failures are reported as warnings
+void load_plugins_from_env(TplateMgr* tpm, const UserInterface* ui);
+
+} // namespace fityk
+#endif // FITYK_PLUGIN_H_
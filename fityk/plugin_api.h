@@ -0,0 +1,92 @@
+/* This file is part of fityk program. Copyright 2001-2013 Marcin Wojdyr
+ * Licence: GNU General Public License ver. 2+
+ */
+
+/* C ABI of plugins with compiled function types.
+ *
+ * A plugin is a shared library (.so, .dylib or .dll) that exports
+ * function fityk_plugin_types() (see below). Each function type is
+ * described by struct FitykPluginType and after the plugin is loaded
+ * (command: define plugin 'path/to/library') it is used like built-in types,
+ * e.g. %f = MyPeak(height=1, center=2, hwhm=0.3).
+ *
+ * The plugin does not need to be linked with libfityk and it can be written
+ * in any language that can export C functions.
+ * Arrays of parameters p have as many elements as there are names in
+ * FitykPluginType.params.
+ */
+
+#ifndef FITYK_PLUGIN_API_H_
+#define FITYK_PLUGIN_API_H_
+
+/* incremented when the layout of FitykPluginType changes */
+#define FITYK_PLUGIN_ABI_VERSION 1
+
+/* values of FitykPluginType.traits, used by the guess command */
+#define FITYK_PLUGIN_LINEAR  1
+#define FITYK_PLUGIN_PEAK    2
+#define FITYK_PLUGIN_SIGMOID 4
+
+#if defined(_WIN32)
+# define FITYK_PLUGIN_EXPORT __declspec(dllexport)
+#elif __GNUC__-0 >= 4
+# define FITYK_PLUGIN_EXPORT __attribute__ ((visibility ("default")))
+#else
+# define FITYK_PLUGIN_EXPORT
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct FitykPluginType_
+{
+    /* must be set to FITYK_PLUGIN_ABI_VERSION */
+    int abi_version;
+    /* name of the type, starts with upper case letter, e.g. "MyPeak" */
+    const char* name;
+    /* comma-separated names of parameters, e.g. "height,center,hwhm" */
+    const char* params;
+    /* comma-separated default values, the same as in the define command,
+     * e.g. ",,hwhm*0.8,0.5[0:1]" (empty value: the parameter name is used) */
+    const char* defvals;
+    /* formula shown by the info command, with parameter names and x;
+     * NULL if the function can't be written as a formula */
+    const char* formula;
+    /* 0 or combination of FITYK_PLUGIN_LINEAR/PEAK/SIGMOID */
+    int traits;
+
+    /* obligatory: y[i] += f(x[i]) for i = 0,...,n-1 */
+    void (*value)(const double* p, int n, const double* x, double* y);
+
+    /* obligatory: y[i] += f(x[i]),
+     *             dy_dp[i*np+k] = df/dp[k](x[i]) (np: number of parameters),
+     *             dy_dx[i] = df/dx(x[i]) */
+    void (*value_deriv)(const double* p, int n, const double* x, double* y,
+                        double* dy_dp, double* dy_dx);
+
+    /* Functions below are optional (can be NULL).
+     * They return 0 if the value is not known and 1 otherwise. */
+
+    /* range outside of which |f(x)| < level */
+    int (*nonzero_range)(const double* p, double level,
+                         double* left, double* right);
+    int (*center)(const double* p, double* result);
+    int (*height)(const double* p, double* result);
+    int (*fwhm)(const double* p, double* result);
+    int (*area)(const double* p, double* result);
+} FitykPluginType;
+
+/* The function exported by a plugin. It returns array of *count types,
+ * or NULL if the plugin does not support given ABI version.
+ * The returned data must remain valid until the program ends.
+ */
+typedef const FitykPluginType* (*FitykPluginTypesFunc)(int abi_version,
+                                                       int* count);
+#define FITYK_PLUGIN_TYPES_SYMBOL "fityk_plugin_types"
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* FITYK_PLUGIN_API_H_ */
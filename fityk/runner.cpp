@@ -4,6 +4,7 @@
 #define BUILDING_LIBFITYK
 #include "runner.h"
 
+#include <set>
 #include <boost/scoped_ptr.hpp>
 
 #include "cparser.h"
@@ -20,6 +21,7 @@
 #include "transform.h"
 #include "ui.h"
 #include "luabridge.h"
+#include "plugin.h"
 
 using namespace std;
 
@@ -113,24 +115,27 @@ void Runner::command_delete(const vector<Token>& args)
         F_->outdated_plot();
 }
 
+void Runner::command_define_plugin(const Token& t)
+{
+    // define plugin 'file_or_directory'
+    vector<string> files = find_plugins(Lexer::get_string(t));
+    vector<string> names;
+    v_foreach (string, f, files) {
+        vector<string> nn = define_plugin_types(F_->get_tpm(),
+                                                load_plugin(*f));
+        names.insert(names.end(), nn.begin(), nn.end());
+    }
+    if (names.empty())
+        F_->msg("No new function types.");
+    else
+        F_->msg("New function type(s): " + join_vector(names, " "));
+}
+
 void Runner::command_delete_points(const vector<Token>& args, int ds)
 {
-    assert(args.size() == 1);
-    Lexer lex(args[0].str);
     ep_.clear_vm();
-    ep_.parse_expr(lex, ds);
-
-    Data *data = F_->dk.data(ds);
-    const vector<Point>& p = data->points();
-    int len = data->points().size();
-    vector<Point> new_p;
-    new_p.reserve(len);
-    for (int n = 0; n != len; ++n) {
-        double val = ep_.calculate(n, p);
-        if (fabs(val) < 0.5)
-            new_p.push_back(p[n]);
-    }
-    data->set_points(new_p);
+    parse_point_command(kCmdDeleteP, args, ds, ep_);
+    apply_point_command(kCmdDeleteP, ep_, F_->dk.data(ds));
     F_->outdated_plot();
 }
 
@@ -178,6 +183,15 @@ void Runner::command_fit(const vector<Token>& args, int ds)
             datas.push_back(F_->dk.data(ds));
         F_->get_fit()->fit(n_steps, datas);
         F_->outdated_plot();
+    } else if (args[0].type == kTokenPlus) {
+        int n_steps = iround(args[1].value.d);
+        vector<Data*> datas;
+        for (size_t i = 2; i < args.size(); ++i)
+            token_to_data(F_, args[i], datas);
+        if (datas.empty())
+            datas.push_back(F_->dk.data(ds));
+        F_->get_fit()->fit(n_steps, datas, true);
+        F_->outdated_plot();
     } else if (args[0].as_string() == "undo") {
         F_->fit_manager()->load_param_history(-1, true);
         F_->outdated_plot();
@@ -190,6 +204,15 @@ void Runner::command_fit(const vector<Token>& args, int ds)
         int n = iround(args[1].value.d);
         F_->fit_manager()->load_param_history(n, false);
         F_->outdated_plot();
+    } else if (args[0].as_string() == "multistart") {
+        int n_runs = iround(args[1].value.d);
+        vector<Data*> datas;
+        for (size_t i = 2; i < args.size(); ++i)
+            token_to_data(F_, args[i], datas);
+        if (datas.empty())
+            datas.push_back(F_->dk.data(ds));
+        F_->get_fit()->multistart(n_runs, datas);
+        F_->outdated_plot();
     }
 }
 
@@ -199,10 +222,11 @@ void Runner::command_guess(const vector<Token>& args, int ds)
     Data* data = F_->dk.data(ds);
     string name; // optional function name
     int ignore_idx = -1;
+    bool all_peaks = (args[0].type == kTokenLname); // guess all Type
     if (args[0].type == kTokenFuncname) {
         name = Lexer::get_string(args[0]);
         ignore_idx = F_->mgr.find_function_nr(name);
-    } else
+    } else if (!all_peaks)
         name = F_->mgr.next_func_name();
 
     // function type
@@ -231,6 +255,40 @@ void Runner::command_guess(const vector<Token>& args, int ds)
     Guess g(F_->get_settings());
     g.set_data(data, range, ignore_idx);
 
+    if (all_peaks) {
+        if (!(tp->traits & Tplate::kPeak) || (tp->traits & Tplate::kLinear))
+            throw ExecuteError("guess all: " + ftype + " is not a peak");
+        vector<vector<double> > peaks = g.estimate_all_peaks_parameters();
+        FunctionSum& ff = data->model()->get_ff();
+        // functions are created in bulk, the model is updated once
+        v_foreach (vector<double>, p, peaks) {
+            vector<realt> pvals(p->begin(), p->end());
+            vector<VMData*> peak_args = func_args;
+            vector<VMData> vd_storage(tp->fargs.size());
+            for (size_t i = 0; i < tp->fargs.size(); ++i) {
+                // given values are copied, because creating a variable
+                // from "~..." changes VMData (eval_tilde())
+                if (peak_args[i] != NULL) {
+                    vd_storage[i] = *func_args[i];
+                    peak_args[i] = &vd_storage[i];
+                    continue;
+                }
+                string dv = tp->defvals[i].empty() ? tp->fargs[i]
+                                                   : tp->defvals[i];
+                defval_to_vm(dv, Guess::peak_traits, pvals, vd_storage[i]);
+                peak_args[i] = &vd_storage[i];
+            }
+            string peak_name = F_->mgr.next_func_name();
+            int idx = F_->mgr.assign_func(peak_name, tp, peak_args);
+            ff.names.push_back(peak_name);
+            ff.idx.push_back(idx);
+        }
+        F_->msg(S(peaks.size()) + " peak(s) found.");
+        F_->mgr.use_parameters();
+        F_->outdated_plot();
+        return;
+    }
+
     // guess
     vector<string> gkeys;
     vector<realt> gvals;
@@ -520,11 +578,12 @@ int get_fz_or_func(const Full *F, int ds, vector<Token>::const_iterator a,
                    vector<string>& added)
 {
     // $func -> 1
-    // (Dataset|Nop) (F|Z) (Expr|Nop) -> 3
+    // (Dataset|Nop) (F|Z|R) (Expr|Nop) -> 3
     if (a->type == kTokenFuncname) {
         added.push_back(Lexer::get_string(*a));
         return 1;
-    } else if (a->type == kTokenDataset || a->type == kTokenNop) {
+    } else if ((a->type == kTokenDataset && (a+1)->type != kTokenNop)
+               || a->type == kTokenNop) {
         int r_ds = a->type == kTokenDataset ? a->value.i : ds;
         const Model* model = F->dk.get_model(r_ds);
         assert((a+1)->type == kTokenUletter);
@@ -559,18 +618,22 @@ void add_functions_to(const Full* F, vector<string> const &names,
 
 void Runner::command_change_model(const vector<Token>& args, int ds)
 {
-    // args (Dataset|Nop) ("F"|"Z") ("+"|"+=")
-    //      ("0" | $func | Type ... | ("F"|"Z") (Expr|Nop)
-    //       ("copy" ($func | Dataset ("F"|"Z") (Expr|Nop)))
+    // args (Dataset|Nop) ("F"|"Z"|"R") ("+"|"+=")
+    //      ("0" | $func | Type ... | ("F"|"Z"|"R") (Expr|Nop)
+    //       ("copy" ($func | Dataset ("F"|"Z"|"R") (Expr|Nop)))
+    //       | Dataset Nop Nop  -- only in R
     //      )+
     int lhs_ds = (args[0].type == kTokenDataset ? args[0].value.i : ds);
-    FunctionSum& sum = F_->dk.get_mutable_model(lhs_ds)->get_fz(*args[1].str);
+    Model* model = F_->dk.get_mutable_model(lhs_ds);
+    FunctionSum& sum = model->get_fz(*args[1].str);
     bool removed_functions = false;
     if (args[2].type == kTokenAssign && !sum.names.empty()) {
         sum.names.clear();
         sum.idx.clear();
         removed_functions = true;
     }
+    if (args[2].type == kTokenAssign && *args[1].str == 'R')
+        model->set_rr_data(vector<PointD>(), -1);
     vector<string> new_names;
     for (size_t i = 3; i < args.size(); i += 2) {
         // $func | Dataset ("F"|"Z")
@@ -582,6 +645,19 @@ void Runner::command_change_model(const vector<Token>& args, int ds)
         else if (args[i].type == kTokenNumber) {
             // nothing
         }
+        // Dataset -- tabulated instrument function
+        else if (args[i].type == kTokenDataset) {
+            int r_ds = args[i].value.i;
+            const Data* data = F_->dk.data(r_ds);
+            if (data->get_n() < 2)
+                throw ExecuteError("@" + S(r_ds) + " has less than 2 active "
+                                   "points, can't be used as R");
+            vector<PointD> p(data->get_n());
+            for (int j = 0; j != data->get_n(); ++j)
+                p[j] = PointD(data->get_x(j), data->get_y(j));
+            model->set_rr_data(p, r_ds);
+            i += 2;
+        }
         // "copy" ...
         else if (args[i].type == kTokenLname && args[i].as_string() == "copy") {
             vector<string> v;
@@ -647,19 +723,135 @@ void Runner::command_load(const vector<Token>& args)
 
 void Runner::command_all_points_tr(const vector<Token>& args, int ds)
 {
-    // args: (kTokenUletter kTokenExpr)+
     ep_.clear_vm();
-    for (size_t i = 0; i < args.size(); i += 2) {
-        Lexer lex(args[i+1].str);
-        ep_.parse_expr(lex, ds);
-        ep_.push_assign_lhs(args[i]);
-    }
-    Data *data = F_->dk.data(ds);
-    ep_.transform_data(data->get_mutable_points());
-    data->after_transform();
+    parse_point_command(kCmdAllPointsTr, args, ds, ep_);
+    apply_point_command(kCmdAllPointsTr, ep_, F_->dk.data(ds));
     F_->outdated_plot();
 }
 
+// Parses expressions of "delete(...)" or "X=..., Y=..." into ep.
+void Runner::parse_point_command(CommandType type, const vector<Token>& args,
+                                 int ds, ExpressionParser& ep)
+{
+    if (type == kCmdDeleteP) {
+        assert(args.size() == 1);
+        Lexer lex(args[0].str);
+        ep.parse_expr(lex, ds);
+    } else { // kCmdAllPointsTr
+        // args: (kTokenUletter kTokenExpr)+
+        for (size_t i = 0; i < args.size(); i += 2) {
+            Lexer lex(args[i+1].str);
+            ep.parse_expr(lex, ds);
+            ep.push_assign_lhs(args[i]);
+        }
+    }
+}
+
+// Executes command parsed by parse_point_command(). Only data is changed,
+// so it can be called concurrently for different datasets.
+void Runner::apply_point_command(CommandType type, ExpressionParser& ep,
+                                 Data *data)
+{
+    if (type == kCmdDeleteP) {
+        vector<Point>& p = data->get_mutable_points();
+        int len = p.size();
+        if (ep.can_modify_in_place()) {
+            // remaining points are moved to the front, without copying
+            // the whole array
+            int k = 0;
+            for (int n = 0; n != len; ++n) {
+                double val = ep.calculate(n, p);
+                if (fabs(val) < 0.5)
+                    p[k++] = p[n];
+            }
+            p.resize(k);
+            data->after_transform();
+            return;
+        }
+        vector<Point> new_p;
+        new_p.reserve(len);
+        for (int n = 0; n != len; ++n) {
+            double val = ep.calculate(n, p);
+            if (fabs(val) < 0.5)
+                new_p.push_back(p[n]);
+        }
+        data->take_points(new_p);
+    } else { // kCmdAllPointsTr
+        ep.transform_data(data->get_mutable_points());
+        data->after_transform();
+    }
+}
+
+// Point transformations and "delete(...)" in "@*: ..." (or "@1 @2 ...: ...")
+// touch only points of the current dataset, so datasets can be processed
+// in parallel (if compiled with OpenMP). Expressions are parsed sequentially,
+// because parsing evaluates aggregate functions and looks up variables.
+// Returns false if the statement should be executed in the usual way.
+bool Runner::execute_in_parallel(const Statement& st)
+{
+    if (st.datasets.size() < 2 || st.commands.size() != 1)
+        return false;
+    const Command& c = st.commands[0];
+    if (c.type != kCmdAllPointsTr && c.type != kCmdDeleteP)
+        return false;
+    // the same dataset can't be changed concurrently
+    if (set<int>(st.datasets.begin(), st.datasets.end()).size() !=
+            st.datasets.size())
+        return false;
+
+    const int n = st.datasets.size();
+    vector<ExpressionParser> parsers(n, ExpressionParser(F_));
+    parse_point_command(c.type, c.args, st.datasets[0], parsers[0]);
+    if (!parsers[0].is_thread_safe())
+        return false;
+    int n_parsed = 1;
+    try {
+        for (; n_parsed < n; ++n_parsed)
+            parse_point_command(c.type, c.args, st.datasets[n_parsed],
+                                parsers[n_parsed]);
+    }
+    catch (...) {
+        // as if executed sequentially: datasets before the failed one
+        // are changed
+        apply_point_commands(c.type, st.datasets, parsers, n_parsed);
+        throw;
+    }
+    apply_point_commands(c.type, st.datasets, parsers, n);
+    return true;
+}
+
+void Runner::apply_point_commands(CommandType type, const vector<int>& dd,
+                                  vector<ExpressionParser>& parsers, int n)
+{
+    // Points are copied before the change. Datasets after the first
+    // failed one are restored, as if the datasets were processed one by one.
+    vector<vector<Point> > backups(n);
+    vector<string> errors(n);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < n; ++i) {
+        Data *data = F_->dk.data(dd[i]);
+        backups[i] = data->points();
+        // exceptions can't leave the parallel region
+        try {
+            apply_point_command(type, parsers[i], data);
+        }
+        catch (const std::exception& e) {
+            errors[i] = e.what();
+        }
+    }
+    if (n > 0)
+        F_->outdated_plot();
+    for (int i = 0; i < n; ++i) {
+        if (!errors[i].empty()) {
+            for (int j = i + 1; j < n; ++j)
+                F_->dk.data(dd[j])->take_points(backups[j]);
+            throw ExecuteError(errors[i]);
+        }
+    }
+}
+
 
 void Runner::command_point_tr(const vector<Token>& args, int ds)
 {
@@ -732,7 +924,10 @@ void Runner::execute_command(Command& c, int ds)
             command_debug(F_, ds, c.args[0], c.args[1]);
             break;
         case kCmdDefine:
-            F_->get_tpm()->define(c.defined_tp);
+            if (c.args.empty())
+                F_->get_tpm()->define(c.defined_tp);
+            else
+                command_define_plugin(c.args[0]);
             break;
         case kCmdDelete:
             command_delete(c.args);
@@ -847,6 +1042,57 @@ void Runner::recalculate_command(Command& c, int ds, Statement& st)
         }
 }
 
+void Runner::execute_sequentially(Statement& st)
+{
+    v_foreach (int, i, st.datasets) {
+        vm_foreach (Command, c, st.commands) {
+            // The values of expression were calculated when parsing
+            // in the context of the first dataset.
+            // We need to re-evaluate it for all but the first dataset,
+            // and also if it is preceded by other command or by "with"
+            // (e.g. epsilon can change the result)
+            if (i != st.datasets.begin() || c != st.commands.begin() ||
+                    !st.with_args.empty())
+                recalculate_command(*c, *i, st);
+
+            if (c->type == kCmdExec || c->type == kCmdLua) {
+                // this command contains nested commands that use the same
+                // Parser/Runner.
+                assert(c->args.size() == 1 || (c->args.size() == 2 &&
+                                         c->args[0].type == kTokenAssign));
+                bool eq = (c->args[0].type == kTokenAssign);
+                const Token& t = c->args.back();
+                TokenType tt = t.type;
+                string str = Lexer::get_string(t);
+                Statement backup;
+                // According to the 0x standard swap() does not invalidate
+                // iterators that refer to elements.
+                st.datasets.swap(backup.datasets);
+                st.with_args.swap(backup.with_args);
+                st.commands.swap(backup.commands);
+                int old_default_idx = F_->dk.default_idx();
+                F_->dk.set_default_idx(*i);
+                if (eq) {
+                    if (c->type == kCmdExec)
+                        F_->lua_bridge()->exec_lua_output(str);
+                    else // if (c->type == kCmdLua)
+                        F_->lua_bridge()->exec_lua_string("return " + str);
+                } else {
+                    if (c->type == kCmdExec)
+                        command_exec(tt, str);
+                    else // if (c->type == kCmdLua)
+                        F_->lua_bridge()->exec_lua_string(str);
+                }
+                F_->dk.set_default_idx(old_default_idx);
+                st.datasets.swap(backup.datasets);
+                st.with_args.swap(backup.with_args);
+                st.commands.swap(backup.commands);
+            } else
+                execute_command(*c, *i);
+        }
+    }
+}
+
 // Execute the last parsed string.
 // Throws ExecuteError, ExitRequestedException.
 void Runner::execute_statement(Statement& st)
@@ -858,53 +1104,8 @@ void Runner::execute_statement(Statement& st)
             s_orig.reset(new Settings(*F_->get_settings()));
             command_set(st.with_args);
         }
-        v_foreach (int, i, st.datasets) {
-            vm_foreach (Command, c, st.commands) {
-                // The values of expression were calculated when parsing
-                // in the context of the first dataset.
-                // We need to re-evaluate it for all but the first dataset,
-                // and also if it is preceded by other command or by "with"
-                // (e.g. epsilon can change the result)
-                if (i != st.datasets.begin() || c != st.commands.begin() ||
-                        !st.with_args.empty())
-                    recalculate_command(*c, *i, st);
-
-                if (c->type == kCmdExec || c->type == kCmdLua) {
-                    // this command contains nested commands that use the same
-                    // Parser/Runner.
-                    assert(c->args.size() == 1 || (c->args.size() == 2 &&
-                                             c->args[0].type == kTokenAssign));
-                    bool eq = (c->args[0].type == kTokenAssign);
-                    const Token& t = c->args.back();
-                    TokenType tt = t.type;
-                    string str = Lexer::get_string(t);
-                    Statement backup;
-                    // According to the 0x standard swap() does not invalidate
-                    // iterators that refer to elements.
-                    st.datasets.swap(backup.datasets);
-                    st.with_args.swap(backup.with_args);
-                    st.commands.swap(backup.commands);
-                    int old_default_idx = F_->dk.default_idx();
-                    F_->dk.set_default_idx(*i);
-                    if (eq) {
-                        if (c->type == kCmdExec)
-                            F_->lua_bridge()->exec_lua_output(str);
-                        else // if (c->type == kCmdLua)
-                            F_->lua_bridge()->exec_lua_string("return " + str);
-                    } else {
-                        if (c->type == kCmdExec)
-                            command_exec(tt, str);
-                        else // if (c->type == kCmdLua)
-                            F_->lua_bridge()->exec_lua_string(str);
-                    }
-                    F_->dk.set_default_idx(old_default_idx);
-                    st.datasets.swap(backup.datasets);
-                    st.with_args.swap(backup.with_args);
-                    st.commands.swap(backup.commands);
-                } else
-                    execute_command(*c, *i);
-            }
-        }
+        if (!execute_in_parallel(st))
+            execute_sequentially(st);
     }
     catch (...) {
         if (!st.with_args.empty())
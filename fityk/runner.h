@@ -37,9 +37,19 @@ private:
     std::vector<VMData>* vdlist_;
     ExpressionParser ep_;
 
+    void execute_sequentially(Statement& st);
+    bool execute_in_parallel(const Statement& st);
+    void apply_point_commands(CommandType type, const std::vector<int>& dd,
+                              std::vector<ExpressionParser>& parsers, int n);
+    static void parse_point_command(CommandType type,
+                                    const std::vector<Token>& args, int ds,
+                                    ExpressionParser& ep);
+    static void apply_point_command(CommandType type, ExpressionParser& ep,
+                                    Data *data);
     void execute_command(Command& c, int ds);
     void command_set(const std::vector<Token>& args);
     void command_delete(const std::vector<Token>& args);
+    void command_define_plugin(const Token& t);
     void command_delete_points(const std::vector<Token>& args, int ds);
     void command_exec(TokenType tt, const std::string& str);
     void command_fit(const std::vector<Token>& args, int ds);
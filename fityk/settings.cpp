@@ -51,6 +51,9 @@ double epsilon = 1e-12; // declared in common.h
 static const char* on_error_enum[] =
 { "nothing", "stop", "exit", NULL };
 
+static const char* script_refresh_enum[] =
+{ "line", "period", "end", NULL };
+
 static const char* default_sigma_enum[] =
 { "sqrt", "one", NULL };
 
@@ -66,6 +69,7 @@ static const char* fit_method_enum[20] = { NULL };
 static const Option options[] = {
     OPT(verbosity, kInt, 0, NULL),
     OPT(autoplot, kBool, true, NULL),
+    OPT(script_refresh, kEnum, script_refresh_enum[0], script_refresh_enum),
     OPT(on_error, kEnum, on_error_enum[1], on_error_enum),
     OPT(epsilon, kDouble, 1e-12, NULL),
     OPT(default_sigma, kEnum, default_sigma_enum[0], default_sigma_enum),
@@ -73,12 +77,14 @@ static const Option options[] = {
     OPT(numeric_format, kString, "%g", NULL),
     OPT(logfile, kString, "", NULL),
     OPT(log_output, kBool, false, NULL),
+    OPT(max_cmd_history, kInt, 0, NULL),
     OPT(function_cutoff, kDouble, 0., NULL),
     OPT(cwd, kString, "", NULL),
 
     OPT(height_correction, kDouble, 1., NULL),
     OPT(width_correction, kDouble, 1., NULL),
     OPT(guess_uses_weights, kBool, true, NULL),
+    OPT(guess_significance, kDouble, 4., NULL),
 
     OPT(fitting_method, kEnum, FitManager::method_list[0][0], fit_method_enum),
     OPT(max_wssr_evaluations, kInt, 1000, NULL),
@@ -87,15 +93,21 @@ static const Option options[] = {
     OPT(fit_replot, kBool, false, NULL),
     OPT(domain_percent, kDouble, 30., NULL),
     OPT(box_constraints, kBool, true, NULL),
+    OPT(screening_stride, kInt, 1, NULL),
+    OPT(screening_polish, kBool, true, NULL),
+    OPT(max_param_history, kInt, 0, NULL),
 
     OPT(lm_lambda_start, kDouble, 0.001, NULL),
     OPT(lm_lambda_up_factor, kDouble, 10, NULL),
     OPT(lm_lambda_down_factor, kDouble, 10, NULL),
     OPT(lm_max_lambda, kDouble, 1e+15, NULL),
     OPT(lm_stop_rel_change, kDouble, 1e-7, NULL),
+    OPT(tr_geodesic_accel, kBool, true, NULL),
+    OPT(tr_broyden_updates, kInt, 4, NULL),
     OPT(ftol_rel, kDouble, 0, NULL),
     OPT(xtol_rel, kDouble, 0, NULL),
     //OPT(mpfit_gtol, kDouble, 1e-10, NULL),
+    OPT(mpfit_max_jacobian, kDouble, 100., NULL),
 
     OPT(nm_convergence, kDouble, 0.0001, NULL),
     OPT(nm_move_all, kBool, false, NULL),
@@ -214,6 +226,8 @@ void SettingsMgr::set_as_string(string const& k, string const& v)
     const Option& opt = find_option(k);
     assert(opt.vtype == kString || opt.vtype == kEnum);
     if (opt.vtype == kString) {
+        if (k == "logfile")
+            ctx_->ui()->close_log();
         if (k == "logfile" && !v.empty()) {
             FILE* f = fopen(v.c_str(), "a");
             if (!f)
@@ -15,6 +15,7 @@ struct FITYK_API Settings
     // general
     int verbosity;
     bool autoplot;
+    const char* script_refresh;
     const char* on_error;
     double epsilon; // for now, there is also global epsilon
     const char* default_sigma;
@@ -22,6 +23,7 @@ struct FITYK_API Settings
     std::string numeric_format;
     std::string logfile;
     bool log_output;
+    int max_cmd_history;
     double function_cutoff;
     std::string cwd; // current working directory
 
@@ -29,6 +31,7 @@ struct FITYK_API Settings
     double height_correction;
     double width_correction;
     bool guess_uses_weights;
+    double guess_significance;
 
     // fitting
     const char* fitting_method;
@@ -38,16 +41,23 @@ struct FITYK_API Settings
     bool fit_replot;
     double domain_percent;
     bool box_constraints;
+    int screening_stride;
+    bool screening_polish;
+    int max_param_history;
     // fitting - LM
     double lm_lambda_start;
     double lm_lambda_up_factor;
     double lm_lambda_down_factor;
     double lm_max_lambda;
     double lm_stop_rel_change;
+    // fitting - trust-region LM
+    bool tr_geodesic_accel;
+    int tr_broyden_updates;
     // fitting - MPFIT & NLopt
     double ftol_rel;
     double xtol_rel;
     //double mpfit_gtol;
+    double mpfit_max_jacobian;
     // fitting - NM
     double nm_convergence;
     bool nm_move_all;
@@ -61,6 +61,9 @@ namespace std {
 // implementation, not api
 %ignore get_ftk;
 %ignore get_covariance_matrix_as_array;
+// callbacks are defined with define_py_type() and F:define_lua_type()
+%ignore fityk::FuncTypeCallback;
+%ignore define_callback_type;
 
 #if defined(SWIGLUA) || defined(SWIGJAVA)
     namespace std
@@ -209,5 +212,240 @@ namespace std {
     %ignore get_ui_api;
 #endif
 
+#if defined(SWIGPYTHON)
+    %typemap(check) PyObject *pyderiv {
+        if ($1 != Py_None && !PyCallable_Check($1))
+            SWIG_exception(SWIG_TypeError,"Expected function or None.");
+    }
+
+    %{
+    #include <string.h>
+    #include <stdio.h>
+    #include <algorithm>
+    // format of realt in the buffer protocol (struct module syntax)
+    static const char* const _py_realt_format =
+                                    sizeof(realt) == sizeof(double) ? "d" : "g";
+
+    // returns numpy.<name>, or NULL if NumPy is not available
+    static PyObject* _py_numpy_func(const char* name)
+    {
+        static PyObject* numpy = NULL;
+        static bool imported = false;
+        if (!imported) {
+            imported = true;
+            numpy = PyImport_ImportModule("numpy");
+            if (numpy == NULL)
+                PyErr_Clear();
+        }
+        return numpy ? PyObject_GetAttrString(numpy, name) : NULL;
+    }
+
+    // returns message of the current Python exception and clears it
+    static std::string _py_fetch_error()
+    {
+        PyObject *type, *value, *traceback;
+        PyErr_Fetch(&type, &value, &traceback);
+        std::string msg;
+        PyObject *str = value ? PyObject_Str(value) : NULL;
+        if (str != NULL) {
+    #if PY_MAJOR_VERSION >= 3
+            PyObject *bytes = PyUnicode_AsUTF8String(str);
+            if (bytes != NULL) {
+                msg = PyBytes_AsString(bytes);
+                Py_DECREF(bytes);
+            }
+    #else
+            msg = PyString_AsString(str);
+    #endif
+            Py_DECREF(str);
+        }
+        Py_XDECREF(type);
+        Py_XDECREF(value);
+        Py_XDECREF(traceback);
+        PyErr_Clear();
+        return msg;
+    }
+
+    // FuncTypeCallback that calls Python functions: f(x, p) -> y
+    // and optionally df(x, p) -> (y, dy_dp, dy_dx).
+    // Arrays x and p are passed without copying, through the buffer protocol,
+    // as NumPy arrays if NumPy is available and as memoryviews otherwise.
+    // They are valid only during the call.
+    class PyFuncTypeCallback : public fityk::FuncTypeCallback
+    {
+    public:
+        PyFuncTypeCallback(const std::string& name,
+                           PyObject *func, PyObject *deriv)
+            : name_(name), func_(func), deriv_(deriv != Py_None ? deriv : NULL)
+        {
+            Py_INCREF(func_);
+            Py_XINCREF(deriv_);
+        }
+
+        ~PyFuncTypeCallback() { Py_DECREF(func_); Py_XDECREF(deriv_); }
+
+        void value(const realt* p, int n, const realt* x, realt* y)
+        {
+            PyObject *r = call(func_, p, n, x);
+            read_array(r, n, y, true, "value");
+            Py_DECREF(r);
+        }
+
+        bool value_deriv(const realt* p, int n, const realt* x, realt* y,
+                         realt* dy_dp, realt* dy_dx)
+        {
+            if (deriv_ == NULL)
+                return false;
+            PyObject *r = call(deriv_, p, n, x);
+            if (!PyTuple_Check(r) || PyTuple_Size(r) != 3) {
+                Py_DECREF(r);
+                throw fityk::ExecuteError(name_ + ": derivative function "
+                                    "should return (y, dy_dp, dy_dx).");
+            }
+            try {
+                read_array(PyTuple_GET_ITEM(r, 0), n, y, true, "value");
+                read_array(PyTuple_GET_ITEM(r, 1), n * np_, dy_dp, false,
+                           "dy_dp");
+                read_array(PyTuple_GET_ITEM(r, 2), n, dy_dx, false, "dy_dx");
+            }
+            catch (fityk::ExecuteError&) {
+                Py_DECREF(r);
+                throw;
+            }
+            Py_DECREF(r);
+            return true;
+        }
+
+        void set_param_count(int np) { np_ = np; }
+
+    private:
+        std::string name_;
+        PyObject *func_, *deriv_;
+        int np_;
+        // shapes must outlive memoryviews (in Python 2 they are not copied)
+        Py_ssize_t x_shape_, p_shape_;
+
+        // returns new reference to array-like object wrapping data
+        static PyObject* wrap(const realt* data, Py_ssize_t* shape)
+        {
+            Py_buffer buf;
+            memset(&buf, 0, sizeof(buf));
+            buf.buf = const_cast<realt*>(data);
+            buf.len = *shape * sizeof(realt);
+            buf.readonly = 1;
+            buf.itemsize = sizeof(realt);
+            buf.format = const_cast<char*>(_py_realt_format);
+            buf.ndim = 1;
+            buf.shape = shape;
+            PyObject *mv = PyMemoryView_FromBuffer(&buf);
+            PyObject *asarray = _py_numpy_func("asarray");
+            if (mv == NULL || asarray == NULL)
+                return mv;
+            PyObject *arr = PyObject_CallFunctionObjArgs(asarray, mv, NULL);
+            Py_DECREF(asarray);
+            Py_DECREF(mv);
+            return arr;
+        }
+
+        // calls f(x, p), returns new reference or throws ExecuteError
+        PyObject* call(PyObject *f, const realt* p, int n, const realt* x)
+        {
+            static const realt dummy = 0.;
+            x_shape_ = n;
+            p_shape_ = np_;
+            PyObject *xa = wrap(x, &x_shape_);
+            PyObject *pa = wrap(np_ > 0 ? p : &dummy, &p_shape_);
+            PyObject *r = NULL;
+            if (xa != NULL && pa != NULL)
+                r = PyObject_CallFunctionObjArgs(f, xa, pa, NULL);
+            Py_XDECREF(xa);
+            Py_XDECREF(pa);
+            if (r == NULL)
+                throw fityk::ExecuteError(name_ + ": " + _py_fetch_error());
+            return r;
+        }
+
+        // copies (or adds, if add is true) n numbers from obj to out;
+        // obj is a sequence or any object with the buffer protocol
+        void read_array(PyObject *obj, Py_ssize_t n, realt* out, bool add,
+                        const char* what)
+        {
+            // arrays of other types are converted by NumPy, if available
+            PyObject *ascontig = _py_numpy_func("ascontiguousarray");
+            PyObject *arr = NULL;
+            if (ascontig != NULL) {
+                arr = PyObject_CallFunction(ascontig, (char*) "Os", obj,
+                                            _py_realt_format);
+                Py_DECREF(ascontig);
+                if (arr == NULL)
+                    throw fityk::ExecuteError(name_ + ": " + what + ": "
+                                              + _py_fetch_error());
+            } else {
+                Py_INCREF(obj);
+                arr = obj;
+            }
+            Py_buffer view;
+            if (PyObject_CheckBuffer(arr) && PyObject_GetBuffer(arr, &view,
+                                    PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) == 0) {
+                bool ok = view.format != NULL &&
+                          strcmp(view.format, _py_realt_format) == 0;
+                if (ok && view.len == (Py_ssize_t) (n * sizeof(realt))) {
+                    const realt *data = static_cast<const realt*>(view.buf);
+                    for (Py_ssize_t i = 0; i != n; ++i)
+                        out[i] = add ? out[i] + data[i] : data[i];
+                    PyBuffer_Release(&view);
+                    Py_DECREF(arr);
+                    return;
+                }
+                PyBuffer_Release(&view);
+                if (ok) {
+                    Py_DECREF(arr);
+                    char msg[64];
+                    sprintf(msg, " has %ld items, expected %ld",
+                            (long) (view.len / sizeof(realt)), (long) n);
+                    throw fityk::ExecuteError(name_ + ": " + what + msg);
+                }
+            }
+            PyErr_Clear();
+            // without NumPy: sequence of numbers
+            PyObject *seq = PySequence_Fast(arr, "");
+            Py_DECREF(arr);
+            if (seq == NULL || PySequence_Fast_GET_SIZE(seq) != n) {
+                Py_XDECREF(seq);
+                PyErr_Clear();
+                char msg[64];
+                sprintf(msg, " should be a sequence of %ld numbers.", (long) n);
+                throw fityk::ExecuteError(name_ + ": " + what + msg);
+            }
+            for (Py_ssize_t i = 0; i != n; ++i) {
+                double v = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seq, i));
+                out[i] = add ? out[i] + v : v;
+            }
+            Py_DECREF(seq);
+            if (PyErr_Occurred())
+                throw fityk::ExecuteError(name_ + ": " + what + ": "
+                                          + _py_fetch_error());
+        }
+    };
+    %}
+
+    %extend fityk::Fityk {
+        /// define function type calculated in Python; see define_py_type
+        /// in the documentation of the Python bindings
+        void define_py_type(const std::string& name,
+                            const std::string& params,
+                            PyObject *pyfunc, PyObject *pyderiv=Py_None,
+                            int traits=0, const std::string& defvals="")
+                                                throw(fityk::ExecuteError) {
+            PyFuncTypeCallback *cb = new PyFuncTypeCallback(name, pyfunc,
+                                                            pyderiv);
+            cb->set_param_count(params.empty() ? 0 :
+                        (int) std::count(params.begin(), params.end(), ',')
+                        + 1);
+            self->define_callback_type(name, params, cb, traits, defvals);
+        }
+    }
+#endif
+
 %include "fityk.h"
 
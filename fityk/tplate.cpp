@@ -15,6 +15,7 @@
 #include "cparser.h"
 #include "eparser.h"
 #include "guess.h"
+#include "ast.h"
 
 using namespace std;
 
@@ -42,6 +43,22 @@ bool Tplate::is_coded() const
            create != NULL; // return false for empty Tplate
 }
 
+void Tplate::make_bytecode()
+{
+    // op_trees: derivatives with respect to all parameters and to x, value
+    assert(op_trees.size() == fargs.size() + 2);
+    vector<int> symbol_map = range_vector(0, fargs.size());
+    bytecode.clear_data();
+    int n = op_trees.size() - 1;
+    for (int i = 0; i < n; ++i) {
+        add_bytecode_from_tree(op_trees[i], symbol_map, bytecode);
+        bytecode.append_code(OP_PUT_DERIV);
+        bytecode.append_code(i);
+    }
+    value_offset = bytecode.code().size();
+    add_bytecode_from_tree(op_trees.back(), symbol_map, bytecode);
+}
+
 vector<string> Tplate::get_missing_default_values() const
 {
     vector<string> gkeys;
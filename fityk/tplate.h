@@ -10,6 +10,7 @@
 
 #include "common.h" // DISALLOW_COPY_AND_ASSIGN
 #include "vm.h" // VMData
+#include "plugin_api.h" // FitykPluginType
 
 namespace fityk {
 
@@ -47,11 +48,21 @@ struct FITYK_API Tplate
     create_type create;
     std::vector<Component> components; // CompoundFunction, SplitFunction
     std::vector<OpTree*> op_trees;     // CustomFunction
+    // CustomFunction, bytecode made from op_trees, shared by all functions
+    // of this type; OP_SYMBOL is followed by the index of parameter
+    VMData bytecode;
+    int value_offset; // CustomFunction, where the value code in bytecode starts
     const char* docs_fragment;
+    const FitykPluginType* plugin_type; // PluginFunction only
+    std::string plugin_path; // PluginFunction only, file with plugin_type
+    boost::shared_ptr<FuncTypeCallback> callback; // CallbackFunction only
 
+    Tplate() : traits(0), create(NULL), value_offset(0), docs_fragment(NULL),
+               plugin_type(NULL) {}
     std::string as_formula() const;
     bool is_coded() const;
     std::vector<std::string> get_missing_default_values() const;
+    void make_bytecode(); // CustomFunction only, sets bytecode from op_trees
 };
 
 // takes keyword args and returns positional args for given function.
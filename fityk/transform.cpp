@@ -6,6 +6,7 @@
 #include "transform.h"
 #include "logic.h"
 #include "data.h"
+#include "fft.h"
 
 using namespace std;
 
@@ -95,6 +96,142 @@ void shirley_bg(vector<Point> &pp)
         pp[i].y = B[i];
 }
 
+// returns the step in x, throws if x is not evenly spaced
+realt get_fixed_step(vector<Point> const& pp, const string& fname)
+{
+    const int n = pp.size();
+    if (n < 2)
+        throw ExecuteError(fname + ": at least 2 points are required");
+    realt h = (pp.back().x - pp.front().x) / (n - 1);
+    // the same tolerance as in Data::find_step()
+    for (int i = 1; i < n - 1; ++i)
+        if (fabs(pp[i].x - pp[0].x - i * h) > 1e-4 * fabs(h))
+            throw ExecuteError(fname + ": x must be evenly spaced");
+    return h;
+}
+
+// sigma of a sum of all points
+realt total_sigma(vector<Point> const& pp)
+{
+    realt ss = 0;
+    v_foreach (Point, i, pp)
+        ss += i->sigma * i->sigma;
+    return sqrt(ss);
+}
+
+enum FourierPart { kFourierRe, kFourierIm, kFourierAmp };
+
+realt fourier_part(const cplx& c, FourierPart part)
+{
+    return part == kFourierRe ? c.real()
+                              : (part == kFourierIm ? c.imag() : abs(c));
+}
+
+// discrete Fourier transform, x of the result is frequency,
+// sorted from -1/(2h) to 1/(2h)
+void fourier_transform(vector<Point> &pp, FourierPart part)
+{
+    const int n = pp.size();
+    realt h = get_fixed_step(pp, "fft");
+    vector<cplx> a(n);
+    for (int i = 0; i < n; ++i)
+        a[i] = pp[i].y;
+    fft(a, false);
+    realt sigma = total_sigma(pp);
+    const int kmin = -(n / 2);
+    for (int i = 0; i < n; ++i) {
+        int k = kmin + i;
+        pp[i] = Point(k / (n * h), fourier_part(a[(k + n) % n], part), sigma);
+    }
+}
+
+// inverse of fourier_transform(), x of the result starts from 0
+void inverse_fourier_transform(vector<Point> &re, vector<Point> const& im,
+                               FourierPart part)
+{
+    const int n = re.size();
+    if (size(im) != n)
+        throw ExecuteError("ifft: real and imaginary parts differ in size");
+    realt df = get_fixed_step(re, "ifft");
+    int k0 = iround(-re[0].x / df); // index of frequency 0
+    if (k0 < 0 || k0 >= n || fabs(re[k0].x) > 1e-4 * fabs(df))
+        throw ExecuteError("ifft: frequency 0 not found");
+    vector<cplx> a(n);
+    for (int i = 0; i < n; ++i)
+        a[(i - k0 + n) % n] = cplx(re[i].y, im[i].y);
+    fft(a, true);
+    realt sigma = total_sigma(re) / n;
+    for (int i = 0; i < n; ++i)
+        re[i] = Point(i / (n * df), fourier_part(a[i], part) / n, sigma);
+}
+
+// Fourier transform of y extended with its mirror image:
+// periodic signal without a jump at the ends
+void mirrored_fft(vector<Point> const& pp, vector<cplx>& a)
+{
+    const int n = pp.size();
+    a.resize(2 * n);
+    for (int i = 0; i < n; ++i)
+        a[i] = a[2*n-1-i] = pp[i].y;
+    fft(a, false);
+}
+
+void mirrored_ifft(vector<cplx>& a, vector<Point> &pp)
+{
+    fft(a, true);
+    for (size_t i = 0; i < pp.size(); ++i)
+        pp[i].y = a[i].real() / a.size();
+}
+
+// removes frequencies higher than fcut
+void lowpass_filter(vector<Point> &pp, realt fcut)
+{
+    realt h = get_fixed_step(pp, "lowpass");
+    vector<cplx> a;
+    mirrored_fft(pp, a);
+    const int m = a.size();
+    for (int k = 0; k < m; ++k)
+        if (min(k, m - k) > fcut * m * fabs(h))
+            a[k] = 0.;
+    mirrored_ifft(a, pp);
+}
+
+// Wiener deconvolution, kern is the instrument function (zero outside
+// of its points), nsr - noise-to-signal ratio
+void wiener_deconvolution(vector<Point> &pp, vector<Point> const& kern,
+                          realt nsr)
+{
+    realt h = get_fixed_step(pp, "deconvolve");
+    if (kern.size() < 2)
+        throw ExecuteError("deconvolve: at least 2 points are required");
+    if (nsr < 0)
+        throw ExecuteError("deconvolve: noise-to-signal ratio can't be < 0");
+    vector<cplx> a;
+    mirrored_fft(pp, a);
+    // the kernel is sampled with the same step, negative offsets wrap around
+    const int m = a.size();
+    vector<cplx> w(m, 0.);
+    realt sum = 0;
+    int kmin = max(-(m - 1) / 2, (int) ceil(kern.front().x / h));
+    int kmax = min(m / 2, (int) floor(kern.back().x / h));
+    for (int k = kmin; k <= kmax; ++k) {
+        realt t = find_extrapolated_y(kern, k * h);
+        w[(k + m) % m] = t;
+        sum += t;
+    }
+    if (sum == 0.)
+        throw ExecuteError("deconvolve: the instrument function has zero area");
+    for (int k = 0; k < m; ++k)
+        w[k] /= sum;
+    fft(w, false);
+    for (int k = 0; k < m; ++k) {
+        double d = norm(w[k]) + double(nsr);
+        // if nsr == 0, frequencies absent in the kernel can't be restored
+        a[k] = (d != 0. ? a[k] * conj(w[k]) / d : cplx(0.));
+    }
+    mirrored_ifft(a, pp);
+}
+
 } // anonymous namespace
 
 namespace fityk {
@@ -202,6 +339,47 @@ void run_data_transform(const DataKeeper& dk, const VMData& vm, Data* data_out)
                 shirley_bg(stackPtr->points);
                 break;
 
+            case OP_DT_FFT_RE:
+            case OP_DT_FFT_IM:
+            case OP_DT_FFT_AMP:
+                if (stackPtr->is_num)
+                    throw ExecuteError(op2str(*i) + " is defined only for @n");
+                fourier_transform(stackPtr->points,
+                                  *i == OP_DT_FFT_RE ? kFourierRe :
+                                  (*i == OP_DT_FFT_IM ? kFourierIm
+                                                      : kFourierAmp));
+                break;
+
+            case OP_DT_IFFT_RE:
+            case OP_DT_IFFT_IM:
+                stackPtr -= 1;
+                if (stackPtr->is_num || (stackPtr+1)->is_num)
+                    throw ExecuteError(op2str(*i) + " is defined only for "
+                                       "(@n, @m)");
+                inverse_fourier_transform(stackPtr->points,
+                                          (stackPtr+1)->points,
+                                          *i == OP_DT_IFFT_RE ? kFourierRe
+                                                              : kFourierIm);
+                break;
+
+            case OP_DT_LOWPASS:
+                stackPtr -= 1;
+                if (stackPtr->is_num || !(stackPtr+1)->is_num)
+                    throw ExecuteError(op2str(*i) + " is defined only for "
+                                       "(@n, number)");
+                lowpass_filter(stackPtr->points, (stackPtr+1)->num);
+                break;
+
+            case OP_DT_DECONVOLVE:
+                stackPtr -= 2;
+                if (stackPtr->is_num || (stackPtr+1)->is_num
+                        || !(stackPtr+2)->is_num)
+                    throw ExecuteError(op2str(*i) + " is defined only for "
+                                       "(@n, @m, number)");
+                wiener_deconvolution(stackPtr->points, (stackPtr+1)->points,
+                                     (stackPtr+2)->num);
+                break;
+
             case OP_AND:
                 // do nothing
                 break;
@@ -225,7 +403,7 @@ void run_data_transform(const DataKeeper& dk, const VMData& vm, Data* data_out)
     assert(stackPtr == stack);
 
     if (!stackPtr->is_num) {
-        data_out->set_points(stackPtr->points);
+        data_out->take_points(stackPtr->points);
         data_out->set_title(stackPtr->title);
     } else if (stackPtr->num == 0.)
         data_out->clear();
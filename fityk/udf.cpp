@@ -72,9 +72,10 @@ void CompoundFunction::init()
     }
 }
 
-void CompoundFunction::update_var_indices(vector<Variable*> const& variables)
+void CompoundFunction::update_var_indices(vector<Variable*> const& variables,
+                                          const VarIndex* index)
 {
-    Function::update_var_indices(variables);
+    Function::update_var_indices(variables, index);
     for (int i = 0; i < nv(); ++i) {
         const Variable* orig = variables[used_vars_.get_idx(i)];
         intern_variables_[i]->set_original(orig);
@@ -206,8 +207,7 @@ CustomFunction::CustomFunction(const Settings* settings,
                                const vector<string> &vars)
     : Function(settings, fname, tp, vars),
       // don't use nv() here, it's not set until init()
-      derivatives_(vars.size()+1),
-      value_offset_(0)
+      derivatives_(vars.size()+1)
 {
 }
 
@@ -215,38 +215,23 @@ CustomFunction::~CustomFunction()
 {
 }
 
-void CustomFunction::update_var_indices(const vector<Variable*>& variables)
+void CustomFunction::update_var_indices(const vector<Variable*>& variables,
+                                        const VarIndex* index)
 {
-    Function::update_var_indices(variables);
-
+    Function::update_var_indices(variables, index);
     assert(used_vars().get_count() + 2 == (int) tp_->op_trees.size());
-    // we put function's parameter index rather than variable index after
-    //  OP_SYMBOL, it is handled in this way in more_precomputations()
-    vector<int> symbol_map = range_vector(0, used_vars().get_count());
-    vm_.clear_data();
-    int n = tp_->op_trees.size() - 1;
-    for (int i = 0; i < n; ++i) {
-        add_bytecode_from_tree(tp_->op_trees[i], symbol_map, vm_);
-        vm_.append_code(OP_PUT_DERIV);
-        vm_.append_code(i);
-    }
-    value_offset_ = vm_.code().size();
-    add_bytecode_from_tree(tp_->op_trees.back(), symbol_map, vm_);
-}
-
-void CustomFunction::more_precomputations()
-{
-    substituted_vm_ = vm_;
-    substituted_vm_.replace_symbols(av_);
 }
 
+// The bytecode is shared by all functions of the same type (it's stored in
+// Tplate) and reads values of parameters directly from av_,
+// so there is nothing to precompute when parameters change.
 void CustomFunction::calculate_value_in_range(const vector<realt> &xx,
                                               vector<realt> &yy,
                                               int first, int last) const
 {
     for (int i = first; i < last; ++i)
-        yy[i] += run_code_for_custom_func_value(substituted_vm_, xx[i],
-                                                value_offset_);
+        yy[i] += run_code_for_custom_func_value(tp_->bytecode, xx[i], av_,
+                                                tp_->value_offset);
 }
 
 void CustomFunction::calculate_value_deriv_in_range(const vector<realt> &xx,
@@ -257,7 +242,8 @@ void CustomFunction::calculate_value_deriv_in_range(const vector<realt> &xx,
 {
     int dyn = dy_da.size() / xx.size();
     for (int i = first; i < last; ++i) {
-        realt y = run_code_for_custom_func(substituted_vm_, xx[i],derivatives_);
+        realt y = run_code_for_custom_func(tp_->bytecode, xx[i], av_,
+                                           derivatives_);
 
         if (!in_dx) {
             yy[i] += y;
@@ -274,11 +260,10 @@ void CustomFunction::calculate_value_deriv_in_range(const vector<realt> &xx,
 
 string CustomFunction::get_bytecode() const
 {
-    const VMData& s = substituted_vm_;
-    vector<int> der_code(s.code().begin(), s.code().begin() + value_offset_);
-    vector<int> val_code(s.code().begin() + value_offset_, s.code().end());
-    return "code with symbols: " + vm2str(vm_)
-        + "\nderivatives: " + vm2str(der_code, s.numbers())
+    const VMData& s = tp_->bytecode;
+    vector<int> der_code(s.code().begin(), s.code().begin() + tp_->value_offset);
+    vector<int> val_code(s.code().begin() + tp_->value_offset, s.code().end());
+    return "derivatives: " + vm2str(der_code, s.numbers())
         + "\nvalue: " + vm2str(val_code, s.numbers());
 }
 
@@ -332,9 +317,10 @@ void SplitFunction::init()
     intern_variables_.push_back(v);
 }
 
-void SplitFunction::update_var_indices(vector<Variable*> const& variables)
+void SplitFunction::update_var_indices(vector<Variable*> const& variables,
+                                          const VarIndex* index)
 {
-    Function::update_var_indices(variables);
+    Function::update_var_indices(variables, index);
     for (int i = 0; i < nv(); ++i) {
         const Variable* orig = variables[used_vars_.get_idx(i)];
         intern_variables_[i]->set_original(orig);
@@ -354,7 +340,8 @@ void SplitFunction::calculate_value_in_range(const vector<realt> &xx,
                                              int first, int last) const
 {
     realt xsplit = intern_variables_.back()->value();
-    int t = lower_bound(xx.begin(), xx.end(), xsplit) - xx.begin();
+    int t = lower_bound(xx.begin() + first, xx.begin() + last, xsplit)
+            - xx.begin();
     left_->calculate_value_in_range(xx, yy, first, t);
     right_->calculate_value_in_range(xx, yy, t, last);
 }
@@ -366,7 +353,8 @@ void SplitFunction::calculate_value_deriv_in_range(const vector<realt> &xx,
                                                    int first, int last) const
 {
     realt xsplit = intern_variables_.back()->value();
-    int t = lower_bound(xx.begin(), xx.end(), xsplit) - xx.begin();
+    int t = lower_bound(xx.begin() + first, xx.begin() + last, xsplit)
+            - xx.begin();
     left_-> calculate_value_deriv_in_range(xx, yy, dy_da, in_dx, first, t);
     right_-> calculate_value_deriv_in_range(xx, yy, dy_da, in_dx, t, last);
 }
@@ -38,7 +38,8 @@ public:
     bool get_fwhm(realt* a) const;
     bool get_area(realt* a) const;
     bool get_nonzero_range(double level, realt& left, realt& right) const;
-    void update_var_indices(const std::vector<Variable*>& variables);
+    void update_var_indices(const std::vector<Variable*>& variables,
+                            const VarIndex* index=NULL);
 
 protected:
     std::vector<Variable*> intern_variables_;
@@ -60,7 +61,6 @@ public:
                    const std::vector<std::string> &vars);
     ~CustomFunction();
 
-    void more_precomputations();
     void calculate_value_in_range(std::vector<realt> const &xx,
                                   std::vector<realt> &yy,
                                   int first, int last) const;
@@ -71,7 +71,8 @@ public:
                                         int first, int last) const;
     std::string get_current_formula(const std::string& x,
                                     const char *num_fmt) const;
-    void update_var_indices(std::vector<Variable*> const& variables);
+    void update_var_indices(std::vector<Variable*> const& variables,
+                            const VarIndex* index=NULL);
     std::string get_bytecode() const;
 
 
@@ -80,10 +81,6 @@ private:
     // declared as a member only as optimization, to avoid allocations
     mutable std::vector<realt> derivatives_;
 
-    VMData vm_;
-    VMData substituted_vm_; // made by substituting symbols with numbers in vm_
-    int value_offset_;
-
     DISALLOW_COPY_AND_ASSIGN(CustomFunction);
 };
 
@@ -117,7 +114,8 @@ public:
     bool get_fwhm(realt* a) const;
     bool get_area(realt* a) const;
     bool get_nonzero_range(double level, realt& left, realt& right) const;
-    void update_var_indices(const std::vector<Variable*>& variables);
+    void update_var_indices(const std::vector<Variable*>& variables,
+                            const VarIndex* index=NULL);
 
 private:
     std::vector<Variable*> intern_variables_;
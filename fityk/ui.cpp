@@ -124,12 +124,12 @@ string UserInterface::Cmd::str() const
 string UserInterface::get_history_summary() const
 {
     string s = S(cmd_count_) + " commands since the start of the program,";
-    if (cmd_count_ == size(cmds_))
+    if (cmd_count_ == (int) cmds_.size())
         s += " of which:";
     else
         s += "\nin last " + S(cmds_.size()) + " commands:";
     int n_ok = 0, n_execute_error = 0, n_syntax_error = 0;
-    for (vector<Cmd>::const_iterator i = cmds_.begin(); i != cmds_.end(); ++i)
+    for (deque<Cmd>::const_iterator i = cmds_.begin(); i != cmds_.end(); ++i)
         if (i->status == UiApi::kStatusOk)
             ++n_ok;
         else if (i->status == UiApi::kStatusExecuteError)
@@ -145,27 +145,54 @@ string UserInterface::get_history_summary() const
 
 
 UserInterface::UserInterface(BasicContext* ctx, CommandExecutor* ce)
-        : ctx_(ctx), cmd_executor_(ce), cmd_count_(0), dirty_plot_(false)
+        : ctx_(ctx), cmd_executor_(ce), cmd_count_(0), dirty_plot_(false),
+          log_file_(NULL), batch_depth_(0), last_batch_refresh_(0),
+          held_size_(0)
 {
 }
 
+FILE* UserInterface::get_log_file() const
+{
+    const string& logfile = ctx_->get_settings()->logfile;
+    if (logfile != log_filename_) {
+        close_log();
+        if (logfile.empty())
+            return NULL;
+        log_file_ = fopen(logfile.c_str(), "a");
+        if (log_file_ == NULL)
+            return NULL;
+        log_filename_ = logfile;
+        setvbuf(log_file_, NULL, _IOFBF, 65536);
+    }
+    return log_file_;
+}
+
+void UserInterface::close_log() const
+{
+    if (log_file_) {
+        fclose(log_file_);
+        log_file_ = NULL;
+    }
+    log_filename_.clear();
+}
+
 UiApi::Status UserInterface::exec_and_log(const string& c)
 {
     if (strip_string(c).empty())
         return UiApi::kStatusOk;
 
     // we want to log the input before the output
-    if (!ctx_->get_settings()->logfile.empty()) {
-        FILE* f = fopen(ctx_->get_settings()->logfile.c_str(), "a");
-        if (f) {
-            fprintf(f, "%s\n", c.c_str());
-            fclose(f);
-        }
-    }
+    FILE* f = get_log_file();
+    if (f)
+        fprintf(f, "%s\n", c.c_str());
 
     UiApi::Status r = execute_line_via_callback(c);
     cmds_.push_back(Cmd(c, r));
     ++cmd_count_;
+    int max_cmd = ctx_->get_settings()->max_cmd_history;
+    while (max_cmd > 0 && (int) cmds_.size() > max_cmd)
+        cmds_.pop_front();
+    flush_log();
     return r;
 }
 
@@ -186,7 +213,7 @@ UiApi::Status UserInterface::execute_line(const string& str)
         status = UiApi::kStatusExecuteError;
     }
 
-    if (dirty_plot_ && ctx_->get_settings()->autoplot)
+    if (dirty_plot_ && ctx_->get_settings()->autoplot && batch_depth_ == 0)
         draw_plot(UiApi::kRepaint);
 
     return status;
@@ -194,21 +221,22 @@ UiApi::Status UserInterface::execute_line(const string& str)
 
 void UserInterface::output_message(Style style, const string& s) const
 {
-    show_message(style, s);
+    show_or_hold(style, s);
 
-    if (!ctx_->get_settings()->logfile.empty() &&
-            ctx_->get_settings()->log_output) {
-        FILE* f = fopen(ctx_->get_settings()->logfile.c_str(), "a");
+    if (ctx_->get_settings()->log_output) {
+        FILE* f = get_log_file();
         if (f) {
             // insert "# " at the beginning of string and before every new line
-            fprintf(f, "# ");
+            string t = "# ";
             for (const char *p = s.c_str(); *p; p++) {
-                fputc(*p, f);
+                t += *p;
                 if (*p == '\n')
-                    fprintf(f, "# ");
+                    t += "# ";
             }
-            fprintf(f, "\n");
-            fclose(f);
+            t += '\n';
+            fwrite(t.c_str(), 1, t.size(), f);
+            if (style == kWarning)
+                fflush(f);
         }
     }
 
@@ -251,6 +279,77 @@ private:
 };
 
 
+// held output is shown earlier if it gets longer than this
+static const size_t kMaxHeldSize = 1 << 20;
+
+void UserInterface::show_or_hold(Style style, const string& s) const
+{
+    // warnings are shown immediately, after the messages before them
+    if (batch_depth_ > 0 && style != kWarning) {
+        held_messages_.push_back(make_pair(style, s));
+        held_size_ += s.size() + 1;
+        if (held_size_ > kMaxHeldSize)
+            show_held_messages();
+        return;
+    }
+    show_held_messages();
+    show_message(style, s);
+}
+
+// Held messages are shown as one message, to make it cheaper for the GUI.
+// Messages of different styles in one block are shown as normal output.
+void UserInterface::show_held_messages() const
+{
+    if (held_messages_.empty())
+        return;
+    Style style = held_messages_[0].first;
+    string text = held_messages_[0].second;
+    for (size_t i = 1; i < held_messages_.size(); ++i) {
+        if (held_messages_[i].first != style)
+            style = kNormal;
+        text += "\n" + held_messages_[i].second;
+    }
+    held_messages_.clear();
+    held_size_ = 0;
+    show_message(style, text);
+}
+
+bool UserInterface::begin_batch()
+{
+    if (batch_depth_ == 0) {
+        if (ctx_->get_settings()->script_refresh[0] == 'l'/*line*/)
+            return false;
+        last_batch_refresh_ = time(NULL);
+    }
+    ++batch_depth_;
+    return true;
+}
+
+void UserInterface::end_batch()
+{
+    assert(batch_depth_ > 0);
+    --batch_depth_;
+    if (batch_depth_ == 0)
+        refresh_batch();
+}
+
+void UserInterface::refresh_batch()
+{
+    show_held_messages();
+    if (dirty_plot_ && ctx_->get_settings()->autoplot)
+        draw_plot(UiApi::kRepaint);
+    last_batch_refresh_ = time(NULL);
+}
+
+// with script_refresh=period, refresh every refresh_period seconds
+void UserInterface::batch_line_done()
+{
+    const Settings* settings = ctx_->get_settings();
+    if (settings->script_refresh[0] == 'p'/*period*/ &&
+            time(NULL) - last_batch_refresh_ >= settings->refresh_period)
+        refresh_batch();
+}
+
 void UserInterface::exec_fityk_script(const string& filename)
 {
     user_interrupt = 0;
@@ -265,35 +364,47 @@ void UserInterface::exec_fityk_script(const string& filename)
         return;
     }
 
+    bool batch = begin_batch();
     int line_index = 0;
     char *line;
     string s;
-    while ((line = opener->read_line()) != NULL) {
-        ++line_index;
-        if (line[0] == '\0')
-            continue;
-        if (ctx_->get_verbosity() >= 0)
-            show_message (kQuoted, S(line_index) + "> " + line);
-        s += line;
-        if (*(s.end() - 1) == '\\') {
-            s.resize(s.size()-1);
-            continue;
-        }
-        if (s.find("_SCRIPT_DIR_/") != string::npos) {
-            string dir = get_directory(filename);
-            replace_all(s, "_EXECUTED_SCRIPT_DIR_/", dir); // old magic string
-            replace_all(s, "_SCRIPT_DIR_/", dir); // new magic string
-        }
-        Status r = execute_line(s);
-        if (r != kStatusOk &&
-                ctx_->get_settings()->on_error[0] != 'n' /*nothing*/)
-            break;
-        if (user_interrupt) {
-            mesg("Script stopped by signal INT.");
-            break;
+    try {
+        while ((line = opener->read_line()) != NULL) {
+            ++line_index;
+            if (line[0] == '\0')
+                continue;
+            if (ctx_->get_verbosity() >= 0)
+                show_or_hold(kQuoted, S(line_index) + "> " + line);
+            s += line;
+            if (*(s.end() - 1) == '\\') {
+                s.resize(s.size()-1);
+                continue;
+            }
+            if (s.find("_SCRIPT_DIR_/") != string::npos) {
+                string dir = get_directory(filename);
+                replace_all(s, "_EXECUTED_SCRIPT_DIR_/", dir); // old magic
+                replace_all(s, "_SCRIPT_DIR_/", dir); // new magic string
+            }
+            Status r = execute_line(s);
+            if (r != kStatusOk &&
+                    ctx_->get_settings()->on_error[0] != 'n' /*nothing*/)
+                break;
+            if (user_interrupt) {
+                mesg("Script stopped by signal INT.");
+                break;
+            }
+            s.clear();
+            if (batch)
+                batch_line_done();
         }
-        s.clear();
+    } catch (...) {
+        if (batch)
+            end_batch();
+        throw;
     }
+    if (batch)
+        end_batch();
+    flush_log();
     if (line == NULL && !s.empty())
         throw SyntaxError("unfinished line");
 }
@@ -301,22 +412,33 @@ void UserInterface::exec_fityk_script(const string& filename)
 
 void UserInterface::exec_stream(FILE *fp)
 {
+    bool batch = begin_batch();
     LineReader reader;
     char *line;
     string s;
-    while ((line = reader.next(fp)) != NULL) {
-        if (ctx_->get_verbosity() >= 0)
-            show_message(kQuoted, string("> ") + line);
-        s += line;
-        if (*(s.end() - 1) == '\\') {
-            s.resize(s.size()-1);
-            continue;
+    try {
+        while ((line = reader.next(fp)) != NULL) {
+            if (ctx_->get_verbosity() >= 0)
+                show_or_hold(kQuoted, string("> ") + line);
+            s += line;
+            if (*(s.end() - 1) == '\\') {
+                s.resize(s.size()-1);
+                continue;
+            }
+            Status r = execute_line(s);
+            if (r != kStatusOk)
+                break;
+            s.clear();
+            if (batch)
+                batch_line_done();
         }
-        Status r = execute_line(s);
-        if (r != kStatusOk)
-            break;
-        s.clear();
+    } catch (...) {
+        if (batch)
+            end_batch();
+        throw;
     }
+    if (batch)
+        end_batch();
     if (line == NULL && !s.empty())
         throw SyntaxError("unfinished line");
 }
@@ -332,13 +454,9 @@ void UserInterface::exec_string_as_script(const char* s)
             --end;
         if (end > start) { // skip blank lines
             string line(start, end);
-            if (!ctx_->get_settings()->logfile.empty()) {
-                FILE* f = fopen(ctx_->get_settings()->logfile.c_str(), "a");
-                if (f) {
-                    fprintf(f, "    %s\n", line.c_str());
-                    fclose(f);
-                }
-            }
+            FILE* f = get_log_file();
+            if (f)
+                fprintf(f, "    %s\n", line.c_str());
             if (ctx_->get_verbosity() >= 0)
                 show_message(kQuoted, "> " + line);
             Status r = execute_line(line);
@@ -349,6 +467,7 @@ void UserInterface::exec_string_as_script(const char* s)
             break;
         start = end + 1;
     }
+    flush_log();
 }
 
 void UserInterface::draw_plot(RepaintMode mode, const char* filename)
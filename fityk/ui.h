@@ -5,6 +5,8 @@
 #define FITYK_UI_H_
 
 #include <csignal> // sig_atomic_t
+#include <ctime> // time_t
+#include <deque>
 #include "common.h"
 #include "ui_api.h"
 
@@ -29,6 +31,7 @@ public:
     };
 
     UserInterface(BasicContext* ctx, CommandExecutor* ce);
+    ~UserInterface() { close_log(); }
 
     /// Redraw the plot.
     void draw_plot(RepaintMode mode, const char* filename=NULL);
@@ -62,6 +65,7 @@ public:
           { if (hint_ui_callback_) (*hint_ui_callback_)(key, value); }
 
     std::string get_input_from_user(const std::string& prompt) {
+        show_held_messages();
         return user_input_callback_ ? (*user_input_callback_)(prompt)
                                     : std::string();
     }
@@ -72,20 +76,50 @@ public:
     /// wait doing nothing for given number of seconds (can be fractional).
     void wait(float seconds) const;
 
-    const std::vector<Cmd>& cmds() const { return cmds_; }
+    /// the last max_cmd_history commands
+    const std::deque<Cmd>& cmds() const { return cmds_; }
     std::string get_history_summary() const;
 
+    /// Write buffered log to the file.
+    void flush_log() const { if (log_file_) fflush(log_file_); }
+    /// Flush and close the log file, it is re-opened when needed.
+    void close_log() const;
+
 private:
     BasicContext* ctx_;
     CommandExecutor* cmd_executor_;
-    int cmd_count_; //!=cmds_.size() if max_cmd was exceeded
-    std::vector<Cmd> cmds_;
+    int cmd_count_; //!=cmds_.size() if max_cmd_history was exceeded
+    std::deque<Cmd> cmds_; // the oldest commands are dropped from the front
     bool dirty_plot_;
+    // The log file is kept open and the output is buffered. It is flushed
+    // after each command, after warnings and when it's closed.
+    mutable FILE* log_file_;
+    mutable std::string log_filename_;
+    // Scripts run in batch mode (option script_refresh != line) don't show
+    // each message and don't redraw the plot after each line; messages
+    // are held and shown together with the redraw, see refresh_batch().
+    int batch_depth_; // > 0 when in batch mode (nested scripts are counted)
+    time_t last_batch_refresh_;
+    mutable std::vector<std::pair<Style, std::string> > held_messages_;
+    mutable size_t held_size_; // total length of held_messages_
+
+    /// returns the open log file or NULL if logging is off
+    FILE* get_log_file() const;
 
     /// show message to user
     void show_message(Style style, const std::string& s) const
         { if (show_message_callback_) (*show_message_callback_)(style, s); }
 
+    /// show message now or, in batch mode, add it to held_messages_
+    void show_or_hold(Style style, const std::string& s) const;
+    void show_held_messages() const;
+    /// returns true if the batch mode was entered
+    bool begin_batch();
+    void end_batch();
+    /// show held messages and redraw the plot if needed
+    void refresh_batch();
+    void batch_line_done();
+
     // It can finish the program (eg. if s=="quit").
     UiApi::Status execute_line_via_callback(const std::string& s);
 
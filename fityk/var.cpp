@@ -22,22 +22,34 @@ bool IndexedVars::depends_on(int idx, vector<Variable*> const &variables) const
     return false;
 }
 
-void IndexedVars::update_indices(vector<Variable*> const &variables)
+bool IndexedVars::update_indices(vector<Variable*> const &variables,
+                                 const VarIndex* index)
 {
     const int n = names_.size();
+    bool changed = (size(indices_) != n);
     indices_.resize(n);
     for (int v = 0; v < n; ++v) {
-        bool found = false;
-        for (int i = 0; i < size(variables); ++i) {
-            if (names_[v] == variables[i]->name) {
-                indices_[v] = i;
-                found = true;
-                break;
+        int found = -1;
+        if (index != NULL) {
+            VarIndex::const_iterator it = index->find(names_[v]);
+            if (it != index->end())
+                found = it->second;
+        } else {
+            for (int i = 0; i < size(variables); ++i) {
+                if (names_[v] == variables[i]->name) {
+                    found = i;
+                    break;
+                }
             }
         }
-        if (!found)
+        if (found == -1)
             throw ExecuteError("Undefined variable: $" + names_[v]);
+        if (indices_[v] != found) {
+            indices_[v] = found;
+            changed = true;
+        }
     }
+    return changed;
 }
 
 int IndexedVars::get_max_idx() const
@@ -77,10 +89,12 @@ Variable::~Variable()
     purge_all_elements(op_trees_);
 }
 
-void Variable::set_var_idx(vector<Variable*> const& variables)
+void Variable::set_var_idx(vector<Variable*> const& variables,
+                           const VarIndex* index)
 {
-    used_vars_.update_indices(variables);
-    if (gpos_ == -1) {
+    bool changed = used_vars_.update_indices(variables, index);
+    // bytecode is empty only before the first call
+    if (gpos_ == -1 && (changed || vm_.code().empty())) {
         /// (re-)create bytecode, required after update_indices()
         assert(used_vars_.indices().size() + 1 == op_trees_.size());
         vm_.clear_data();
@@ -133,14 +147,12 @@ void Variable::recalculate(vector<Variable*> const &variables,
         assert(0);
 }
 
-void Variable::erased_parameter(int k)
+void Variable::erased_parameters(const vector<int>& new_gpos)
 {
-    if (gpos_ != -1 && gpos_ > k)
-            --gpos_;
-    for (vector<ParMult>::iterator i = recursive_derivatives_.begin();
-                                        i != recursive_derivatives_.end(); ++i)
-        if (i->p > k)
-            -- i->p;
+    if (gpos_ >= 0)
+        gpos_ = new_gpos[gpos_];
+    vm_foreach (ParMult, i, recursive_derivatives_)
+        i->p = new_gpos[i->p];
 }
 
 bool Variable::is_constant() const
@@ -5,6 +5,7 @@
 #define FITYK_VAR_H_
 
 #include <assert.h>
+#include <boost/unordered_map.hpp>
 #include "common.h"
 #include "vm.h"
 
@@ -12,6 +13,10 @@ namespace fityk {
 struct OpTree;
 class Variable;
 
+/// maps names of variables to their positions in the vector of variables;
+/// kept by ModelManager to avoid linear searches in large models
+typedef boost::unordered_map<std::string, int> VarIndex;
+
 class FITYK_API IndexedVars
 {
 public:
@@ -34,7 +39,10 @@ public:
 
     void set_name(int n, const std::string &new_p)
                          { assert(is_index(n, names_)); names_[n] = new_p; }
-    void update_indices(const std::vector<Variable*>& variables);
+    /// finds positions of variables by name, using index if it's given;
+    /// returns true if any of the positions changed
+    bool update_indices(const std::vector<Variable*>& variables,
+                        const VarIndex* index=NULL);
 
 private:
     // variable names
@@ -74,9 +82,12 @@ public:
     void recalculate(const std::vector<Variable*> &variables,
                      const std::vector<realt> &parameters);
 
-    void erased_parameter(int k);
+    /// new_gpos[k] is the position of parameter k after some parameters
+    /// were removed
+    void erased_parameters(const std::vector<int>& new_gpos);
     bool is_visible() const { return true; } //for future use
-    void set_var_idx(const std::vector<Variable*> &variables);
+    void set_var_idx(const std::vector<Variable*> &variables,
+                     const VarIndex* index=NULL);
     const std::vector<ParMult>& recursive_derivatives() const
                                             { return recursive_derivatives_; }
     std::vector<OpTree*> const& get_op_trees() const { return op_trees_; }
@@ -110,6 +110,8 @@ string op2str(int op)
         OP_(NUMAREA) OP_(FINDX) OP_(FIND_EXTR)
         OP_(TILDE)
         OP_(DATASET) OP_(DT_SUM_SAME_X) OP_(DT_AVG_SAME_X) OP_(DT_SHIRLEY_BG)
+        OP_(DT_FFT_RE) OP_(DT_FFT_IM) OP_(DT_FFT_AMP)
+        OP_(DT_IFFT_RE) OP_(DT_IFFT_IM) OP_(DT_LOWPASS) OP_(DT_DECONVOLVE)
         OP_(OPEN_ROUND)  OP_(OPEN_SQUARE)
     }
     return S(op); // unreachable (if all OPs are listed above)
@@ -143,26 +145,6 @@ void VMData::append_number(realt d)
     numbers_.push_back(d);
 }
 
-void VMData::replace_symbols(const vector<realt>& vv)
-{
-    for (vector<int>::iterator op = code_.begin(); op < code_.end(); ++op) {
-        if (*op == OP_SYMBOL) {
-            *op = OP_NUMBER;
-            ++op;
-            realt value = vv[*op];
-            vector<realt>::iterator x =
-                    find(numbers_.begin(), numbers_.end(), value);
-            if (x != numbers_.end())
-                *op = x - numbers_.begin();
-            else {
-                *op = numbers_.size();
-                numbers_.push_back(value);
-            }
-        } else if (has_idx(*op))
-            ++op;
-    }
-}
-
 /// switches between non-negative and negative indices (a -> -1-a),
 /// the point of having negative indices is to avoid conflicts with opcodes.
 /// The same transformation is used in OpTree. 
@@ -654,11 +636,16 @@ void ExprCalculator::transform_data(vector<Point>& points)
 
     realt stack[16];
     realt* stackPtr = stack - 1; // will be ++'ed first
-    vector<Point> new_points = points;
+    // Usually new values depend only on the same point, then the copy
+    // (that can take gigabytes) is not needed.
+    vector<Point> copied;
+    if (!can_modify_in_place())
+        copied = points;
+    const vector<Point>& old_points = copied.empty() ? points : copied;
 
     // do the time-consuming overflow checking only for the first point
     v_foreach (int, i, vm_.code()) {
-        run_mutab_op(F_, vm_.numbers(), i, stackPtr, 0, points, new_points);
+        run_mutab_op(F_, vm_.numbers(), i, stackPtr, 0, old_points, points);
         if (stackPtr - stack >= 16)
             throw ExecuteError("stack overflow");
     }
@@ -667,9 +654,37 @@ void ExprCalculator::transform_data(vector<Point>& points)
     // the same for the rest of points, but without checks
     for (int n = 1; n != size(points); ++n)
         v_foreach (int, i, vm_.code())
-            run_mutab_op(F_, vm_.numbers(), i, stackPtr, n, points, new_points);
+            run_mutab_op(F_, vm_.numbers(), i, stackPtr, n, old_points, points);
+}
+
+bool ExprCalculator::can_modify_in_place() const
+{
+    const vector<int>& code = vm_.code();
+    bool assigned[4] = { false, false, false, false }; // X, Y, S, A
+    int prev = -1;
+    for (vector<int>::const_iterator i = code.begin(); i < code.end(); ++i) {
+        int op = *i;
+        if (op == OP_XINDEX)
+            return false;
+        if (op >= OP_PX && op <= OP_Pa && prev != OP_Pn)
+            return false;
+        if (op >= OP_Px && op <= OP_Pa && assigned[op - OP_Px])
+            return false;
+        if (op >= OP_ASSIGN_X && op <= OP_ASSIGN_A)
+            assigned[op - OP_ASSIGN_X] = true;
+        if (VMData::has_idx(op))
+            ++i;
+        prev = op;
+    }
+    return true;
+}
 
-    points.swap(new_points);
+bool ExprCalculator::is_thread_safe() const
+{
+    // OP_NUMAREA, OP_FINDX and OP_FIND_EXTR are followed by OP_FUNC/OP_SUM_F
+    return !vm_.has_op(OP_FUNC) && !vm_.has_op(OP_SUM_F) &&
+           !vm_.has_op(OP_SUM_Z) && !vm_.has_op(OP_RANDU) &&
+           !vm_.has_op(OP_RANDNORM);
 }
 
 realt ExprCalculator::calculate(int n, const vector<Point>& points) const
@@ -735,7 +750,9 @@ realt run_code_for_variable(const VMData& vm,
 }
 
 
+// OP_SYMBOL is followed by the index of function's parameter in symbols
 realt run_code_for_custom_func(const VMData& vm, realt x,
+                               const vector<realt> &symbols,
                                vector<realt> &derivatives)
 {
     realt stack[16];
@@ -744,6 +761,10 @@ realt run_code_for_custom_func(const VMData& vm, realt x,
         if (*i == OP_X) {
             STACK_OFFSET_CHANGE(+1);
             *stackPtr = x;
+        } else if (*i == OP_SYMBOL) {
+            STACK_OFFSET_CHANGE(+1);
+            ++i;
+            *stackPtr = symbols[*i];
         } else if (*i == OP_PUT_DERIV) {
             ++i;
             // the OP_PUT_DERIV opcode is followed by a number n,
@@ -759,6 +780,7 @@ realt run_code_for_custom_func(const VMData& vm, realt x,
 }
 
 realt run_code_for_custom_func_value(const VMData& vm, realt x,
+                                     const vector<realt> &symbols,
                                      int code_offset)
 {
     realt stack[16];
@@ -768,6 +790,10 @@ realt run_code_for_custom_func_value(const VMData& vm, realt x,
         if (*i == OP_X) {
             STACK_OFFSET_CHANGE(+1);
             *stackPtr = x;
+        } else if (*i == OP_SYMBOL) {
+            STACK_OFFSET_CHANGE(+1);
+            ++i;
+            *stackPtr = symbols[*i];
         } else
             run_func_op(vm.numbers(), i, stackPtr);
     }
@@ -101,6 +101,13 @@ enum Op
     OP_DT_SUM_SAME_X,
     OP_DT_AVG_SAME_X,
     OP_DT_SHIRLEY_BG,
+    OP_DT_FFT_RE,
+    OP_DT_FFT_IM,
+    OP_DT_FFT_AMP,
+    OP_DT_IFFT_RE,
+    OP_DT_IFFT_IM,
+    OP_DT_LOWPASS,
+    OP_DT_DECONVOLVE,
 
     // these two are not VM operators, but are handy to have here,
     // they and are used in implementation of shunting yard algorithm
@@ -121,7 +128,6 @@ public:
     void append_code(int op) { code_.push_back(op); }
     void append_number(realt d);
     void clear_data() { code_.clear(); numbers_.clear(); }
-    void replace_symbols(const std::vector<realt>& vv);
     void flip_indices();
     bool single_symbol() const {return code_.size()==2 && code_[0]==OP_SYMBOL;}
     bool has_op(int op) const;
@@ -157,6 +163,16 @@ public:
     /// transform data (X=..., Y=..., S=..., A=...)
     void transform_data(std::vector<Point>& points);
 
+    /// true if the code reads only the current point (x, y, s, a, X, Y, S, A
+    /// without index or with [n]) and reads lowercase x, y, s, a only before
+    /// assigning X, Y, S, A, so the points can be modified in place
+    bool can_modify_in_place() const;
+
+    /// true if the code can be run concurrently for different datasets:
+    /// %functions and F/Z use shared buffers and random numbers would
+    /// depend on the order of evaluation
+    bool is_thread_safe() const;
+
     const VMData& vm() const { return vm_; }
 
 protected:
@@ -168,8 +184,10 @@ realt run_code_for_variable(const VMData& vm,
                             const std::vector<Variable*> &variables,
                             std::vector<realt> &derivatives);
 realt run_code_for_custom_func(const VMData& vm, realt x,
+                               const std::vector<realt> &symbols,
                                std::vector<realt> &derivatives);
 realt run_code_for_custom_func_value(const VMData& vm, realt x,
+                                     const std::vector<realt> &symbols,
                                      int code_offset);
 
 } // namespace fityk
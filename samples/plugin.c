@@ -0,0 +1,103 @@
+/* Example of plugin with compiled function type.
+ * Build it as a shared library, for example:
+ *   gcc -O2 -shared -fPIC -o sech2.so plugin.c -lm
+ * and load in Fityk:
+ *   define plugin 'sech2.so'
+ *   guess Sech2
+ */
+
+#include <math.h>
+#include <stddef.h>
+
+#include <fityk/plugin_api.h>
+
+/* acosh(sqrt(2)), makes hwhm the half width at half maximum */
+#define K 0.881373587019543
+
+/* Sech2(height, center, hwhm) = height / cosh(K*(x-center)/hwhm)^2 */
+
+static void sech2_value(const double* p, int n, const double* x, double* y)
+{
+    int i;
+    for (i = 0; i < n; ++i) {
+        double c = cosh(K * (x[i] - p[1]) / p[2]);
+        y[i] += p[0] / (c * c);
+    }
+}
+
+static void sech2_value_deriv(const double* p, int n, const double* x,
+                              double* y, double* dy_dp, double* dy_dx)
+{
+    int i;
+    for (i = 0; i < n; ++i) {
+        double t = K * (x[i] - p[1]) / p[2];
+        double c = cosh(t);
+        double s2 = 1. / (c * c);
+        double df_dt = -2 * p[0] * s2 * tanh(t);
+        y[i] += p[0] * s2;
+        dy_dp[3*i+0] = s2;
+        dy_dp[3*i+1] = -df_dt * K / p[2];
+        dy_dp[3*i+2] = -df_dt * t / p[2];
+        dy_dx[i] = df_dt * K / p[2];
+    }
+}
+
+static int sech2_nonzero_range(const double* p, double level,
+                               double* left, double* right)
+{
+    double w = 0;
+    if (level == 0)
+        return 0;
+    if (fabs(level) < fabs(p[0])) {
+        double c = sqrt(fabs(p[0] / level));
+        w = fabs(p[2]) / K * log(c + sqrt(c*c - 1)); /* acosh(c) */
+    }
+    *left = p[1] - w;
+    *right = p[1] + w;
+    return 1;
+}
+
+static int sech2_height(const double* p, double* result)
+{
+    *result = p[0];
+    return 1;
+}
+
+static int sech2_fwhm(const double* p, double* result)
+{
+    *result = 2 * fabs(p[2]);
+    return 1;
+}
+
+static int sech2_area(const double* p, double* result)
+{
+    *result = 2 * p[0] * fabs(p[2]) / K;
+    return 1;
+}
+
+static const FitykPluginType types[] = {
+    {
+        FITYK_PLUGIN_ABI_VERSION,
+        "Sech2",
+        "height,center,hwhm",
+        ",,",
+        "height/cosh(0.881373587019543*(x-center)/hwhm)^2",
+        FITYK_PLUGIN_PEAK,
+        sech2_value,
+        sech2_value_deriv,
+        sech2_nonzero_range,
+        NULL, /* center: parameter "center" is used */
+        sech2_height,
+        sech2_fwhm,
+        sech2_area
+    }
+};
+
+FITYK_PLUGIN_EXPORT
+const FitykPluginType* fityk_plugin_types(int abi_version, int* count)
+{
+    if (abi_version != FITYK_PLUGIN_ABI_VERSION)
+        return NULL;
+    *count = sizeof(types) / sizeof(types[0]);
+    return types;
+}
@@ -0,0 +1,123 @@
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include "fityk/fityk.h"
+#include "fityk/ui_api.h"
+
+#include "catch.hpp"
+
+using namespace std;
+using namespace fityk;
+
+static vector<string> shown;
+static int redraw_count = 0;
+
+static void collect_message(UiApi::Style /*style*/, const string& s)
+{
+    shown.push_back(s);
+}
+
+static void count_redraw(UiApi::RepaintMode /*mode*/, const char* /*fn*/)
+{
+    ++redraw_count;
+}
+
+static const char* script_name = "batch-test.fit";
+
+// runs script with given script_refresh mode, shown messages are in `shown'
+static void run_script(const char* mode, const char* script)
+{
+    FILE *f = fopen(script_name, "w");
+    REQUIRE(f != NULL);
+    fputs(script, f);
+    fclose(f);
+    boost::scoped_ptr<Fityk> ftk(new Fityk);
+    ftk->get_ui_api()->connect_show_message(collect_message);
+    ftk->get_ui_api()->connect_draw_plot(count_redraw);
+    ftk->execute(string("set script_refresh=") + mode);
+    ftk->execute("set refresh_period=0");
+    shown.clear();
+    redraw_count = 0;
+    ftk->execute(string("exec ") + script_name);
+    remove(script_name);
+}
+
+static string all_shown()
+{
+    string s;
+    for (size_t i = 0; i != shown.size(); ++i)
+        s += shown[i] + "\n";
+    return s;
+}
+
+// true if the strings appear in the output in this order
+static bool in_order(const char* a, const char* b, const char* c)
+{
+    string s = all_shown();
+    size_t pa = s.find(a), pb = s.find(b), pc = s.find(c);
+    return pa != string::npos && pb != string::npos && pc != string::npos
+           && pa < pb && pb < pc;
+}
+
+static const char* script =
+    "M=5\n"
+    "X=n\n"
+    "print 1+11\n"
+    "Y=x^2\n"
+    "print 2+22\n";
+
+static const char* failing_script =
+    "print 1+11\n"
+    "print $no_such_var\n"
+    "print 2+22\n";
+
+TEST_CASE("script-refresh-line", "") {
+    run_script("line", script);
+    // each line is echoed, output follows the line
+    REQUIRE(shown.size() == 7);
+    REQUIRE(in_order("> print 1+11", "12", "> print 2+22"));
+    REQUIRE(shown.back() == "24");
+    REQUIRE(redraw_count == 3); // after each line that changed data
+
+    run_script("line", failing_script);
+    REQUIRE(in_order("12", "> print $no_such_var", "no_such_var"));
+    REQUIRE(all_shown().find("2+22") == string::npos);
+}
+
+TEST_CASE("script-refresh-period", "") {
+    // with refresh_period=0 the output is shown after each line
+    run_script("period", script);
+    REQUIRE(shown.size() == 5);
+    REQUIRE(in_order("> print 1+11", "12", "> print 2+22"));
+    REQUIRE(shown.back() == "5> print 2+22\n24");
+    REQUIRE(redraw_count == 3);
+
+    run_script("period", failing_script);
+    REQUIRE(in_order("12", "> print $no_such_var", "no_such_var"));
+    REQUIRE(all_shown().find("2+22") == string::npos);
+}
+
+TEST_CASE("script-refresh-end", "") {
+    // all the output is shown at the end, as one message
+    run_script("end", script);
+    REQUIRE(shown.size() == 1);
+    REQUIRE(in_order("> print 1+11", "12", "> print 2+22"));
+    REQUIRE(redraw_count == 1);
+
+    // the error is shown immediately after the output held before it
+    run_script("end", failing_script);
+    REQUIRE(shown.size() == 2);
+    REQUIRE(shown[0] == "1> print 1+11\n12\n2> print $no_such_var");
+    REQUIRE(shown[1].find("no_such_var") != string::npos);
+    REQUIRE(all_shown().find("2+22") == string::npos);
+
+    // long output is not held until the end
+    string long_script;
+    for (int i = 0; i < 2000; ++i)
+        long_script += "print 3+33 # " + string(1000, 'x') + "\n";
+    run_script("end", long_script.c_str());
+    REQUIRE(shown.size() == 2);
+    REQUIRE(shown[0].size() < 1100000);
+}
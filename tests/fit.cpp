@@ -0,0 +1,272 @@
+
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include <boost/scoped_ptr.hpp>
+#include "fityk/fityk.h"
+#include "fityk/ui_api.h"
+#include "fityk/logic.h"
+#include "fityk/data.h"
+#include "fityk/fit.h"
+#include "fityk/common.h" // S()
+
+#include "catch.hpp"
+
+using namespace std;
+using namespace fityk;
+
+static string shown_messages;
+
+static void collect_message(UiApi::Style /*style*/, const string& s)
+{
+    shown_messages += s + "\n";
+}
+
+static bool has_message(const string& s)
+{
+    return shown_messages.find(s) != string::npos;
+}
+
+// two overlapping Gaussians, 2000 points, starting far from the minimum
+static Fityk* make_two_peaks()
+{
+    Fityk* ftk = new Fityk;
+    ftk->set_option_as_number("pseudo_random_seed", 1);
+    ftk->get_ui_api()->connect_show_message(collect_message);
+    vector<realt> x, y, sigma;
+    for (int i = 0; i < 2000; ++i) {
+        double xi = i * 0.01;
+        double t1 = (xi - 8) / 1.2, t2 = (xi - 11) / 0.8;
+        x.push_back(xi);
+        y.push_back(5 * exp(-M_LN2 * t1 * t1) + 3 * exp(-M_LN2 * t2 * t2));
+        sigma.push_back(0.1);
+    }
+    ftk->load_data(0, x, y, sigma);
+    ftk->execute("F = Gaussian(~4, ~7.5, ~1) + Gaussian(~2, ~11.5, ~1)");
+    return ftk;
+}
+
+TEST_CASE("screening-polish", "option screening_polish") {
+    boost::scoped_ptr<Fityk> a(make_two_peaks());
+    a->execute("set fitting_method=nelder_mead_simplex, screening_stride=8");
+    a->execute("set screening_polish=0");
+    a->execute("fit 60");
+    realt wssr_rough = a->get_wssr();
+
+    boost::scoped_ptr<Fityk> b(make_two_peaks());
+    b->execute("set fitting_method=nelder_mead_simplex, screening_stride=8");
+    b->execute("fit 60");
+    // L-M refinement on all points gets much closer to the minimum (0)
+    REQUIRE(b->get_wssr() < 0.1 * wssr_rough);
+}
+
+TEST_CASE("resume-screening", "fit +N with screening_stride") {
+    boost::scoped_ptr<Fityk> ftk(make_two_peaks());
+    ftk->execute("set fitting_method=nelder_mead_simplex, screening_stride=8");
+    ftk->execute("set screening_polish=0");
+    ftk->execute("fit 60");
+    realt wssr1 = ftk->get_wssr();
+    shown_messages.clear();
+    ftk->execute("fit +60");
+    REQUIRE(!has_message("starting anew"));
+    realt wssr2 = ftk->get_wssr();
+    REQUIRE(wssr2 <= wssr1);
+
+    // WSSR values saved in the simplex depend on the stride
+    ftk->execute("set screening_stride=4");
+    shown_messages.clear();
+    ftk->execute("fit +60");
+    REQUIRE(has_message("starting anew"));
+
+    // the state is saved also when the result is refined with L-M
+    ftk->execute("set screening_polish=1");
+    ftk->execute("fit 60");
+    shown_messages.clear();
+    ftk->execute("fit +60");
+    REQUIRE(!has_message("starting anew"));
+}
+
+TEST_CASE("resume-lm", "fit N; fit +M continues like fit N+M") {
+    boost::scoped_ptr<Fityk> a(make_two_peaks());
+    a->execute("set fitting_method=levenberg_marquardt");
+    // the initial WSSR is one evaluation, so fit 4 makes 3 iterations
+    a->execute("fit 4");
+    a->execute("fit +5");
+
+    boost::scoped_ptr<Fityk> b(make_two_peaks());
+    b->execute("set fitting_method=levenberg_marquardt");
+    b->execute("fit 8");
+
+    vector<realt> pa = a->all_parameters();
+    vector<realt> pb = b->all_parameters();
+    REQUIRE(pa.size() == pb.size());
+    for (size_t i = 0; i != pa.size(); ++i)
+        REQUIRE(pa[i] == Approx(pb[i]));
+    REQUIRE(a->get_wssr() == Approx(b->get_wssr()));
+
+    // after convergence the derivatives must be recomputed on resuming
+    a->execute("fit");
+    realt wssr1 = a->get_wssr();
+    vector<realt> p1 = a->all_parameters();
+    a->execute("fit +5");
+    REQUIRE(a->get_wssr() <= wssr1);
+    vector<realt> p2 = a->all_parameters();
+    for (size_t i = 0; i != p1.size(); ++i)
+        REQUIRE(p2[i] == Approx(p1[i]));
+}
+
+// straight line with Gaussian noise (sigma 0.3), fitted
+static Fityk* make_fitted_line()
+{
+    Fityk* ftk = new Fityk;
+    ftk->set_option_as_number("verbosity", -1);
+    ftk->set_option_as_number("pseudo_random_seed", 3);
+    vector<realt> x, y, sigma;
+    for (int i = 0; i < 100; ++i) {
+        x.push_back(i * 0.1);
+        y.push_back(2 + 3 * i * 0.1);
+        sigma.push_back(0.3);
+    }
+    ftk->load_data(0, x, y, sigma);
+    ftk->execute("Y = y + randnormal(0, 0.3)");
+    ftk->execute("F = Linear(~1, ~1)");
+    ftk->execute("fit");
+    return ftk;
+}
+
+static vector<realt> get_ys(Fityk* ftk)
+{
+    vector<realt> ys;
+    const vector<Point>& p = ftk->get_data(0);
+    for (size_t i = 0; i != p.size(); ++i)
+        ys.push_back(p[i].y);
+    return ys;
+}
+
+TEST_CASE("error-samples", "bootstrap and Monte Carlo errors") {
+    boost::scoped_ptr<Fityk> ftk(make_fitted_line());
+    Full* priv = ftk->priv();
+    vector<Data*> datas(1, priv->dk.data(0));
+    vector<realt> a0 = ftk->all_parameters();
+    vector<realt> y0 = get_ys(ftk.get());
+    int history_size = priv->fit_manager()->get_param_history_size();
+    vector<double> err = priv->get_fit()->get_standard_errors(datas);
+    for (int mc = 0; mc < 2; ++mc) {
+        vector<vector<realt> > samples = ftk->get_error_samples(300, mc);
+        REQUIRE(samples.size() == 300);
+        for (size_t j = 0; j != a0.size(); ++j) {
+            realt mean = 0, var = 0;
+            for (size_t n = 0; n != samples.size(); ++n)
+                mean += samples[n][j] / samples.size();
+            for (size_t n = 0; n != samples.size(); ++n)
+                var += (samples[n][j] - mean) * (samples[n][j] - mean);
+            realt sd = sqrt(var / (samples.size() - 1));
+            REQUIRE(fabs(mean - a0[j]) < 0.3 * err[j]);
+            REQUIRE(sd == Approx(err[j]).epsilon(0.15));
+        }
+    }
+    // the fitted data and parameters are not changed
+    REQUIRE(ftk->all_parameters() == a0);
+    REQUIRE(get_ys(ftk.get()) == y0);
+    REQUIRE(ftk->get_data(0).size() == 100);
+    REQUIRE(priv->fit_manager()->get_param_history_size() == history_size);
+}
+
+TEST_CASE("profile-limits", "profile-likelihood confidence limits") {
+    boost::scoped_ptr<Fityk> ftk(make_fitted_line());
+    Full* priv = ftk->priv();
+    vector<Data*> datas(1, priv->dk.data(0));
+    vector<realt> a0 = ftk->all_parameters();
+    vector<realt> y0 = get_ys(ftk.get());
+    vector<double> conf = priv->get_fit()->get_confidence_limits(datas, 95);
+    vector<realt> prof = priv->get_fit()->get_profile_limits(datas, 95);
+    REQUIRE(prof.size() == 2 * a0.size());
+    // for a linear model both methods give the same intervals
+    for (size_t j = 0; j != a0.size(); ++j) {
+        REQUIRE(a0[j] - prof[2*j] == Approx(conf[j]).epsilon(1e-3));
+        REQUIRE(prof[2*j+1] - a0[j] == Approx(conf[j]).epsilon(1e-3));
+    }
+    REQUIRE(ftk->all_parameters() == a0);
+    REQUIRE(get_ys(ftk.get()) == y0);
+}
+
+TEST_CASE("multistart", "fit multistart keeps the best minimum") {
+    boost::scoped_ptr<Fityk> ftk(new Fityk);
+    ftk->set_option_as_number("verbosity", -1);
+    ftk->set_option_as_number("pseudo_random_seed", 1);
+    vector<realt> x, y, sigma;
+    for (int i = 0; i < 400; ++i) {
+        double t = (i / 20. - 8) / 0.5;
+        x.push_back(i / 20.);
+        y.push_back(5 * exp(-M_LN2 * t * t));
+        sigma.push_back(1);
+    }
+    ftk->load_data(0, x, y, sigma);
+    ftk->execute("F = Gaussian(~1 [0.5:10], ~3 [0:16], ~0.5 [0.3:1])");
+    // L-M started far from the peak gets stuck
+    ftk->execute("fit");
+    realt stuck_wssr = ftk->get_wssr();
+    REQUIRE(stuck_wssr > 100);
+    const ParameterHistoryMgr* hm = ftk->priv()->fit_manager();
+    int history_size = hm->get_param_history_size();
+
+    // the first run starts from the stuck parameters again
+    ftk->execute("fit multistart 20");
+    REQUIRE(ftk->get_wssr() < 1e-6);
+    REQUIRE(ftk->get_variable("_2")->value() == Approx(8.));
+    // only the result is added, the starting point was already there
+    REQUIRE(hm->get_param_history_size() == history_size + 1);
+    ftk->execute("fit undo");
+    REQUIRE(ftk->get_wssr() == Approx(stuck_wssr));
+}
+
+TEST_CASE("param-history", "items stored as differences are restored") {
+    boost::scoped_ptr<Fityk> ftk(new Fityk);
+    ftk->set_option_as_number("verbosity", -1);
+    const int n_par = 20;
+    for (int i = 0; i < n_par; ++i)
+        ftk->execute("$v" + S(i) + " = ~" + S(i));
+    FitManager* fm = ftk->priv()->fit_manager();
+    // without limit and with a limit that drops keyframes
+    for (int max_items = 0; max_items <= 50; max_items += 50) {
+        ftk->set_option_as_number("max_param_history", max_items);
+        fm->clear_param_history();
+        srand(max_items + 1);
+        vector<vector<realt> > expected;
+        vector<realt> aa = ftk->all_parameters();
+        for (int n = 0; n < 300; ++n) {
+            int r = rand() % 10;
+            if (r == 0) { // the same as the previous item, not stored
+                REQUIRE(fm->push_param_history(aa) == expected.empty());
+                if (expected.empty())
+                    expected.push_back(aa);
+                continue;
+            }
+            // a few parameters or all of them are changed
+            int n_changed = (r < 3 ? n_par : 1 + rand() % 3);
+            for (int i = 0; i < n_changed; ++i)
+                aa[r < 3 ? i : rand() % n_par] = rand() % 1000 / 10.;
+            if (!expected.empty() && aa == expected.back())
+                continue;
+            REQUIRE(fm->push_param_history(aa));
+            expected.push_back(aa);
+        }
+        if (max_items > 0 && (int) expected.size() > max_items)
+            expected.erase(expected.begin(), expected.end() - max_items);
+        int size = expected.size();
+        REQUIRE(fm->get_param_history_size() == size);
+        for (int n = 0; n < size; ++n)
+            REQUIRE(fm->get_item(n) == expected[n]);
+
+        // undo down to the oldest kept item
+        fm->load_param_history(-1, false);
+        REQUIRE(ftk->all_parameters() == expected.back());
+        for (int n = size - 2; n >= 0; --n) {
+            ftk->execute("fit undo");
+            REQUIRE(ftk->all_parameters() == expected[n]);
+        }
+        REQUIRE_THROWS_AS(ftk->execute("fit undo"), ExecuteError);
+        ftk->execute("fit redo");
+        REQUIRE(ftk->all_parameters() == expected[1]);
+    }
+}
@@ -4,6 +4,9 @@
 #include "fityk/logic.h"
 #include "fityk/data.h"
 #include "fityk/fit.h"
+#include "fityk/model.h"
+#include "fityk/mgr.h"
+#include "fityk/func.h"
 
 #include "catch.hpp"
 
@@ -84,6 +87,109 @@ TEST_CASE("gradient", "test Fit::compute_wssr_gradient()") {
     REQUIRE(grad[2] == Approx(grad_again[2]));
 }
 
+// compares derivatives of the model convolved with R with numerical ones,
+// and values with values calculated point by point
+static void check_convolved_derivs(Full* priv, const vector<realt>& x)
+{
+    const Model* model = priv->dk.get_model(0);
+    vector<realt> a = priv->mgr.parameters();
+    const int na = a.size();
+    vector<realt> xx = x;
+    vector<realt> y(x.size(), 0.);
+    vector<realt> dy_da(x.size() * (na+1));
+    model->compute_model_with_derivs(xx, y, dy_da);
+    for (size_t i = 0; i < x.size(); ++i)
+        REQUIRE(fabs(y[i] - model->value(x[i])) < 1e-6);
+    for (int k = 0; k < na; ++k) {
+        realt h = 1e-6 * max(fabs(a[k]), 1.);
+        vector<realt> y_less(x.size(), 0.), y_more(x.size(), 0.);
+        vector<realt> a2 = a;
+        a2[k] = a[k] - h;
+        priv->mgr.use_external_parameters(a2);
+        xx = x;
+        model->compute_model(xx, y_less);
+        a2[k] = a[k] + h;
+        priv->mgr.use_external_parameters(a2);
+        xx = x;
+        model->compute_model(xx, y_more);
+        for (size_t i = 0; i < x.size(); ++i) {
+            realt num = (y_more[i] - y_less[i]) / (2 * h);
+            REQUIRE(fabs(dy_da[i*(na+1)+k] - num) < 5e-5);
+        }
+    }
+    priv->mgr.use_parameters();
+}
+
+TEST_CASE("convolution", "test model convolved with R") {
+    boost::scoped_ptr<Fityk> ftk(new Fityk);
+    Full* priv = ftk->priv();
+    ftk->set_option_as_number("verbosity", -1);
+    for (int i = 0; i <= 400; ++i)
+        priv->dk.data(0)->add_one_point(-5 + i * 0.025, 0, 1);
+    // Gaussians convolved: hwhm^2 = 0.3^2 + 0.4^2, area is preserved
+    ftk->execute("F = Gaussian(~1, ~0.2, ~0.3)");
+    ftk->execute("R = Gaussian(1, 0, ~0.4)");
+    REQUIRE(ftk->calculate_expr("F(0.2)") == Approx(0.6).epsilon(1e-5));
+    REQUIRE(ftk->calculate_expr("F(0.7)") == Approx(0.3).epsilon(1e-5));
+    // a single point is convolved in the same way as the whole dataset
+    vector<realt> xx = priv->dk.data(0)->get_xx(), yy(xx.size(), 0.);
+    priv->dk.data(0)->model()->compute_model(xx, yy);
+    for (int i = 190; i < 210; ++i)
+        REQUIRE(priv->dk.data(0)->model()->value(xx[i])
+                == Approx(yy[i]).epsilon(1e-12));
+
+    ftk->execute("Z = Constant(~0.05)");
+    // evenly spaced x, FFT is used for the long kernel
+    check_convolved_derivs(priv, priv->dk.data(0)->get_xx());
+    vector<realt> uneven;
+    for (int i = 0; i < 40; ++i)
+        uneven.push_back(-2 + 0.1 * i + 0.001 * i * i);
+    check_convolved_derivs(priv, uneven);
+}
+
+// with function_cutoff, functions are found using their support ranges,
+// which are re-sorted when the parameters change
+TEST_CASE("support-ranges", "test Model::get_ff_in_range()") {
+    boost::scoped_ptr<Fityk> ftk(new Fityk);
+    Full* priv = ftk->priv();
+    ftk->set_option_as_number("verbosity", -1);
+    ftk->set_option_as_number("function_cutoff", 1e-3);
+    for (int i = 0; i <= 400; ++i)
+        priv->dk.data(0)->add_one_point(i * 0.05, 0, 1);
+    ftk->execute("%a = Gaussian(~1, ~5, ~0.5)");
+    ftk->execute("%b = Gaussian(~2, ~10, ~0.5)");
+    ftk->execute("%c = Gaussian(~3, ~15, ~0.5)");
+    ftk->execute("F = %a + %b + %c");
+    const Model* model = priv->dk.get_model(0);
+    REQUIRE(model->get_ff_in_range(4.9, 5.1) == vector<int>(1, 0));
+    REQUIRE(model->get_ff_in_range(9.9, 10.1) == vector<int>(1, 1));
+
+    // only values change, %a is moved past %b
+    vector<realt> a = priv->mgr.parameters();
+    REQUIRE(a[1] == 5.);
+    a[1] = 12.;
+    priv->mgr.put_new_parameters(a);
+    REQUIRE(model->get_ff_in_range(4.9, 5.1).empty());
+    REQUIRE(model->get_ff_in_range(11.9, 12.1) == vector<int>(1, 0));
+    REQUIRE(model->get_ff_in_range(9.9, 10.1) == vector<int>(1, 1));
+    vector<int> both;
+    both.push_back(0);
+    both.push_back(1);
+    REQUIRE(model->get_ff_in_range(10.5, 11.5) == both);
+
+    vector<realt> xx = priv->dk.data(0)->get_xx(), yy(xx.size(), 0.);
+    model->compute_model(xx, yy);
+    const char* names[] = { "a", "b", "c" };
+    for (size_t i = 0; i != xx.size(); ++i) {
+        realt y = 0;
+        for (int j = 0; j != 3; ++j)
+            y += priv->mgr.find_function(names[j])->calculate_value(xx[i]);
+        REQUIRE(fabs(yy[i] - y) < 1e-3);
+    }
+    REQUIRE(yy[240] == Approx(1.)); // x=12
+    REQUIRE(yy[200] == Approx(2.)); // x=10
+}
+
 //----------- + some unrelated random tests
 
 TEST_CASE("set-throws", "test Fityk::set_throws()") {
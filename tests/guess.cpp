@@ -1,5 +1,6 @@
 
 #include <stdio.h>
+#include <math.h>
 #include <boost/scoped_ptr.hpp>
 #include "fityk/logic.h"
 #include "fityk/guess.h"
@@ -83,3 +84,58 @@ TEST_CASE("linear-guess", "test Guess::estimate_linear_parameters()") {
     REQUIRE(lin_est[0] == Approx(norris::cert_b1));
     REQUIRE(lin_est[1] == Approx(norris::cert_b0));
 }
+
+TEST_CASE("all-peaks-guess", "test Guess::estimate_all_peaks_parameters()") {
+    boost::scoped_ptr<Full> ftk(new Full);
+    Data *data = ftk->dk.data(0);
+    const double center[] = { 4., 9., 14. };
+    const double height[] = { 100., 60., 30. };
+    const double hwhm[] = { 0.3, 0.5, 0.2 };
+    for (int i = 0; i < 400; ++i) {
+        double x = i / 20.;
+        double y = 0;
+        for (int j = 0; j < 3; ++j) {
+            double t = (x - center[j]) / hwhm[j];
+            y += height[j] * exp(-M_LN2 * t * t);
+        }
+        data->add_one_point(x, y, 1);
+    }
+    Guess g(ftk->get_settings());
+    g.set_data(ftk->dk.data(0), RealRange(), -1);
+    vector<vector<double> > peaks = g.estimate_all_peaks_parameters();
+    REQUIRE(peaks.size() == 3);
+    for (int j = 0; j < 3; ++j) {
+        REQUIRE(fabs(peaks[j][0] - center[j]) < 0.05);
+        REQUIRE(fabs(peaks[j][1] - height[j]) < 0.1 * height[j]);
+        REQUIRE(fabs(peaks[j][2] - hwhm[j]) < 0.25 * hwhm[j]);
+    }
+}
+
+TEST_CASE("guess-all-kwargs", "each peak from guess all gets own variables") {
+    boost::scoped_ptr<Fityk> ftk(new Fityk);
+    ftk->set_option_as_number("verbosity", -1);
+    vector<realt> x, y, sigma;
+    for (int i = 0; i < 400; ++i) {
+        double xi = i / 20.;
+        double t1 = (xi - 4) / 0.3, t2 = (xi - 9) / 0.5, t3 = (xi - 14) / 0.2;
+        x.push_back(xi);
+        y.push_back(100 * exp(-M_LN2 * t1 * t1) + 60 * exp(-M_LN2 * t2 * t2)
+                    + 30 * exp(-M_LN2 * t3 * t3));
+        sigma.push_back(1);
+    }
+    ftk->load_data(0, x, y, sigma);
+    ftk->execute("guess all Gaussian(hwhm=~0.2*2)");
+    vector<Func*> ff = ftk->all_functions();
+    REQUIRE(ff.size() == 3);
+    // each peak has height, center and the ~0.2 as simple variables
+    REQUIRE(ftk->all_parameters().size() == 9);
+    for (int i = 0; i < 3; ++i) {
+        REQUIRE(ff[i]->get_param_value("hwhm") == Approx(0.4));
+        for (int j = 0; j < i; ++j)
+            REQUIRE(ff[i]->var_name("hwhm") != ff[j]->var_name("hwhm"));
+    }
+    ftk->execute("$" + ff[0]->var_name("hwhm") + " = 1");
+    REQUIRE(ff[0]->get_param_value("hwhm") == Approx(1.));
+    REQUIRE(ff[1]->get_param_value("hwhm") == Approx(0.4));
+    REQUIRE(ff[2]->get_param_value("hwhm") == Approx(0.4));
+}
@@ -0,0 +1,178 @@
+
+#include <math.h>
+#include <boost/scoped_ptr.hpp>
+#include "fityk/logic.h"
+#include "fityk/mgr.h"
+#include "fityk/func.h"
+#include "fityk/plugin.h"
+
+#include "catch.hpp"
+
+using namespace std;
+using namespace fityk;
+
+// Gaussian(height, center, hwhm) implemented as plugin
+static void pg_value(const double* p, int n, const double* x, double* y)
+{
+    for (int i = 0; i < n; ++i) {
+        double t = (x[i] - p[1]) / p[2];
+        y[i] += p[0] * exp(-M_LN2 * t * t);
+    }
+}
+
+static void pg_value_deriv(const double* p, int n, const double* x,
+                           double* y, double* dy_dp, double* dy_dx)
+{
+    for (int i = 0; i < n; ++i) {
+        double t = (x[i] - p[1]) / p[2];
+        double ex = exp(-M_LN2 * t * t);
+        double dcenter = 2 * M_LN2 * p[0] * ex * t / p[2];
+        y[i] += p[0] * ex;
+        dy_dp[3*i+0] = ex;
+        dy_dp[3*i+1] = dcenter;
+        dy_dp[3*i+2] = dcenter * t;
+        dy_dx[i] = -dcenter;
+    }
+}
+
+static int pg_area(const double* p, double* result)
+{
+    *result = p[0] * fabs(p[2]) * sqrt(M_PI / M_LN2);
+    return 1;
+}
+
+static const FitykPluginType plugin_gauss = {
+    FITYK_PLUGIN_ABI_VERSION, "PlugGauss", "height,center,hwhm", ",,", NULL,
+    FITYK_PLUGIN_PEAK, pg_value, pg_value_deriv, NULL, NULL, NULL, NULL,
+    pg_area
+};
+
+TEST_CASE("plugin-function", "function type registered from C ABI") {
+    boost::scoped_ptr<Fityk> fik(new Fityk);
+    fik->set_option_as_number("verbosity", -1);
+    Full* priv = fik->priv();
+    vector<string> names = define_plugin_types(priv->get_tpm(),
+                          make_plugin_tplates(&plugin_gauss, 1, "test-only"));
+    REQUIRE(names.size() == 1);
+    // already defined types from the same plugin are skipped
+    names = define_plugin_types(priv->get_tpm(),
+                          make_plugin_tplates(&plugin_gauss, 1, "test-only"));
+    REQUIRE(names.empty());
+
+    fik->execute("%p = PlugGauss(~3.1, ~0.2, ~0.7)");
+    fik->execute("%g = Gaussian(~3.1, ~0.2, ~0.7)");
+    REQUIRE(fik->calculate_expr("%p.Center") == Approx(0.2));
+    REQUIRE(fik->calculate_expr("%p.Area") ==
+            Approx(fik->calculate_expr("%g.Area")));
+    // not provided by plugin
+    REQUIRE_THROWS_AS(fik->calculate_expr("%p.Height"), ExecuteError);
+
+    const Function* p = priv->mgr.find_function("p");
+    const Function* g = priv->mgr.find_function("g");
+    vector<realt> x;
+    for (int i = 0; i < 40; ++i)
+        x.push_back(-2 + 0.1 * i);
+    int dyn = priv->mgr.parameters().size() + 1;
+    vector<realt> yp(x.size(), 0.), yg(x.size(), 0.);
+    vector<realt> dp(x.size() * dyn, 0.), dg(x.size() * dyn, 0.);
+    p->calculate_value_deriv(x, yp, dp);
+    // %p and %g use different variables, so the derivatives are shifted
+    g->calculate_value_deriv(x, yg, dg);
+    for (size_t i = 0; i != x.size(); ++i) {
+        REQUIRE(yp[i] == Approx(yg[i]));
+        REQUIRE(p->calculate_value(x[i]) == Approx(yg[i]));
+        for (int k = 0; k != 3; ++k)
+            REQUIRE(dp[dyn*i+k] == Approx(dg[dyn*i+k+3]));
+        REQUIRE(dp[dyn*i+dyn-1] == Approx(dg[dyn*i+dyn-1]));
+    }
+}
+
+TEST_CASE("plugin-errors", "") {
+    FitykPluginType t = plugin_gauss;
+    t.abi_version = FITYK_PLUGIN_ABI_VERSION + 1;
+    REQUIRE_THROWS_AS(make_plugin_tplates(&t, 1, "t"), ExecuteError);
+    t = plugin_gauss;
+    t.name = "lowercase";
+    REQUIRE_THROWS_AS(make_plugin_tplates(&t, 1, "t"), ExecuteError);
+    t = plugin_gauss;
+    t.defvals = ",";
+    REQUIRE_THROWS_AS(make_plugin_tplates(&t, 1, "t"), ExecuteError);
+
+    boost::scoped_ptr<Fityk> fik(new Fityk);
+    fik->set_option_as_number("verbosity", -1);
+    REQUIRE_THROWS_AS(fik->execute("define plugin 'no-such-plugin.so'"),
+                      ExecuteError);
+}
+
+// the same Gaussian, calculated by callback
+struct GaussCallback : public FuncTypeCallback
+{
+    bool with_deriv;
+    int calls;
+    GaussCallback(bool d) : with_deriv(d), calls(0) {}
+    virtual void value(const realt* p, int n, const realt* x, realt* y) {
+        ++calls;
+        pg_value(p, n, x, y);
+    }
+    virtual bool value_deriv(const realt* p, int n, const realt* x, realt* y,
+                             realt* dy_dp, realt* dy_dx) {
+        if (!with_deriv)
+            return false;
+        ++calls;
+        pg_value_deriv(p, n, x, y, dy_dp, dy_dx);
+        return true;
+    }
+};
+
+TEST_CASE("callback-function", "function type calculated by callback") {
+    boost::scoped_ptr<Fityk> fik(new Fityk);
+    fik->set_option_as_number("verbosity", -1);
+    GaussCallback *cb1 = new GaussCallback(true);
+    GaussCallback *cb2 = new GaussCallback(false);
+    fik->define_callback_type("CbGauss", "height,center,hwhm", cb1, 2);
+    fik->define_callback_type("CbNumGauss", "height,center,hwhm", cb2, 2,
+                              ",,");
+    REQUIRE_THROWS_AS(fik->define_callback_type("CbGauss", "a",
+                                                new GaussCallback(true)),
+                      ExecuteError);
+    REQUIRE_THROWS_AS(fik->define_callback_type("CbWrong", "a,b",
+                                                new GaussCallback(true),
+                                                0, "1"),
+                      ExecuteError);
+
+    fik->execute("%c = CbGauss(~3.1, ~0.2, ~0.7)");
+    fik->execute("%n = CbNumGauss(~3.1, ~0.2, ~0.7)");
+    fik->execute("%g = Gaussian(~3.1, ~0.2, ~0.7)");
+    Full* priv = fik->priv();
+    const Function* c = priv->mgr.find_function("c");
+    const Function* n = priv->mgr.find_function("n");
+    const Function* g = priv->mgr.find_function("g");
+    vector<realt> x;
+    for (int i = 0; i < 40; ++i)
+        x.push_back(-2 + 0.1 * i);
+    int dyn = priv->mgr.parameters().size() + 1;
+    vector<realt> yc(x.size(), 0.), yn(x.size(), 0.), yg(x.size(), 0.);
+    vector<realt> dc(x.size() * dyn, 0.), dn(x.size() * dyn, 0.),
+                  dg(x.size() * dyn, 0.);
+    cb1->calls = 0;
+    c->calculate_value_deriv(x, yc, dc);
+    // one call for all points
+    REQUIRE(cb1->calls == 1);
+    n->calculate_value_deriv(x, yn, dn);
+    g->calculate_value_deriv(x, yg, dg);
+    for (size_t i = 0; i != x.size(); ++i) {
+        REQUIRE(yc[i] == Approx(yg[i]));
+        REQUIRE(yn[i] == Approx(yg[i]));
+        for (int k = 0; k != 3; ++k) {
+            REQUIRE(dc[dyn*i+k] == Approx(dg[dyn*i+k+6]));
+            REQUIRE(fabs(dn[dyn*i+k+3] - dg[dyn*i+k+6]) < 1e-6);
+        }
+        REQUIRE(dc[dyn*i+dyn-1] == Approx(dg[dyn*i+dyn-1]));
+        REQUIRE(fabs(dn[dyn*i+dyn-1] - dg[dyn*i+dyn-1]) < 1e-6);
+    }
+
+    // types defined by callbacks are not saved
+    string script = fik->get_info("state");
+    REQUIRE(script.find("define CbGauss") == string::npos);
+    REQUIRE(script.find("# CbGauss is calculated") != string::npos);
+}
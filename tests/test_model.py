@@ -135,7 +135,7 @@ class TestBoxConstraints(unittest.TestCase):
         self.ftk.set_option_as_number("verbosity", -1)
         self.ftk.load_data(0, xx, yy, [1]*len(xx), "line")
         self.ftk.execute("F = Linear(~0, ~0[:2.5])")
-        self.methods = ["mpfit"]
+        self.methods = ["mpfit", "levenberg_marquardt"]
         if self.ftk.get_info("compiler"):
             self.methods += ["nlopt_lbfgs", "nlopt_nm", "nlopt_bobyqa",
                              "nlopt_sbplx"]
@@ -155,6 +155,46 @@ class TestBoxConstraints(unittest.TestCase):
             self.assertAlmostEqual(self.fit(m), 3.0)
 
 
+class TestPythonType(unittest.TestCase):
+    def setUp(self):
+        self.ftk = fityk.Fityk()
+        self.ftk.set_option_as_number("verbosity", -1)
+        self.calls = 0
+
+    def lorentz(self, x, p):
+        self.calls += 1
+        return [p[0] / (1 + ((xi - p[1]) / p[2])**2) for xi in x]
+
+    def test_value(self):
+        self.ftk.define_py_type("PyLor", "height,center,hwhm", self.lorentz)
+        self.ftk.execute("%p = PyLor(~2, ~1, ~0.5)")
+        self.ftk.execute("%q = Lorentzian(~2, ~1, ~0.5)")
+        for x in (-1, 0.3, 1, 2.7):
+            self.assertAlmostEqual(self.ftk.calculate_expr("%%p(%g)" % x),
+                                   self.ftk.calculate_expr("%%q(%g)" % x))
+
+    def test_fit(self):
+        self.ftk.define_py_type("PyLor", "height,center,hwhm", self.lorentz,
+                                None, 2)
+        self.ftk.load_data(0, [0.1*i for i in range(40)],
+                           [3 / (1 + ((0.1*i - 2.1) / 0.4)**2)
+                            for i in range(40)], [])
+        self.ftk.execute("guess PyLor")
+        self.calls = 0
+        self.ftk.execute("fit")
+        # one call per evaluation, not per point
+        self.assertTrue(0 < self.calls < 40 * 50)
+        self.assertAlmostEqual(self.ftk.calculate_expr("%_1.center"), 2.1,
+                               places=4)
+
+    def test_error(self):
+        def bad(x, p):
+            raise ValueError("bad value")
+        self.ftk.define_py_type("PyBad", "a", bad)
+        self.assertRaises(fityk.ExecuteError, self.ftk.execute,
+                          "%b = PyBad(1); print %b(0)")
+
+
 
 if __name__ == '__main__':
     unittest.main()
@@ -90,8 +90,9 @@ def has_nlopt():
     return "NLopt" in ftk.get_info("compiler")
 
 
-def run(data_name, fit_method, easy=True):
-    uses_gradient = (fit_method in ("mpfit", "levenberg_marquardt"))
+def run(data_name, fit_method, easy=True, streamed=False):
+    uses_gradient = (fit_method in ("mpfit", "levenberg_marquardt",
+                                    "trust_region", "variable_projection"))
     if uses_gradient:
         tolerance = { "wssr": 1e-10, "param": 4e-7, "err": 5e-3 }
     else:
@@ -125,6 +126,8 @@ def run(data_name, fit_method, easy=True):
     if fit_method == "mpfit":
         ftk.execute("set ftol_rel=1e-18")
         ftk.execute("set xtol_rel=1e-18")
+        if streamed: # use mpfit_streamed() even for small data
+            ftk.execute("set mpfit_max_jacobian=0")
     if fit_method == "genetic_algorithms":
         ftk.execute("set max_wssr_evaluations=5e5")
     elif not uses_gradient:
@@ -191,6 +194,15 @@ mpfit_fails = ["MGH17", "BoxBOD", "MGH10", "MGH09", "Bennett5"]  #, "ENSO"
 nm_fails =    ["MGH17", "BoxBOD", "ENSO", "Eckerle4", "MGH09", "Bennett5"]
 nl_nm_fails = ["MGH17", "BoxBOD", "MGH10", "ENSO"]
 
+# trust_region was checked only on these datasets so far
+tr_datasets = ["MGH09", "BoxBOD", "Rat42", "MGH10"]
+tr_fails    = ["BoxBOD", "MGH10", "MGH09"]
+# the same for variable_projection
+vp_datasets = ["MGH09", "BoxBOD", "Rat42", "MGH10"]
+vp_fails    = ["MGH10", "MGH09"]
+# and for mpfit with the streamed Jacobian (mpfit_max_jacobian=0)
+mpfit_streamed_datasets = ["MGH09", "BoxBOD", "Rat42", "MGH10"]
+
 
 class TestSequenceFunctions(unittest.TestCase):
     def setUp(self):
@@ -206,6 +218,22 @@ class TestSequenceFunctions(unittest.TestCase):
             self.assertIs(run(data_name, "levenberg_marquardt", False),
                           data_name not in lm_fails)
 
+    def test_trust_region(self):
+        for data_name in tr_datasets:
+            self.assertTrue(run(data_name, "trust_region", easy=True))
+            self.assertIs(run(data_name, "trust_region", easy=False),
+                          data_name not in tr_fails)
+
+    def test_mpfit_streamed(self):
+        for data_name in mpfit_streamed_datasets:
+            self.assertTrue(run(data_name, "mpfit", easy=True, streamed=True))
+
+    def test_variable_projection(self):
+        for data_name in vp_datasets:
+            self.assertTrue(run(data_name, "variable_projection", easy=True))
+            self.assertIs(run(data_name, "variable_projection", easy=False),
+                          data_name not in vp_fails)
+
     def test_nelder_mead(self):
         for data_name in datasets:
             ## Lanczos* converge slowly with gradient-less methods, avoid
@@ -33,6 +33,15 @@ class TestTransform(unittest.TestCase):
         #print self.x
         #print self.y
 
+    def test_add_points(self):
+        self.ftk.add_points([10, 11], [1, 2], [1, 1])      # appended
+        self.ftk.add_points([-10, 10.5], [3, 4], [1, 1])   # inserted
+        xx, yy, ss = get_data_as_lists(self.ftk)
+        self.assertEqual(xx, sorted(self.x + [10, 11, -10, 10.5]))
+        self.assertEqual(yy[0], 3)
+        self.assertEqual(yy[-3:], [1, 4, 2])
+        self.assert_expr("M", len(self.x) + 4)
+
     def assert_expr(self, expr, val, places=None):
         expr_val = self.ftk.calculate_expr(expr)
         if places is None:
@@ -83,6 +92,52 @@ class TestTransform(unittest.TestCase):
         self.assertEqual(yy[3], 1.2)
         self.assertEqual(yy[-2], 12.34)
 
+    def test_fft(self):
+        self.ftk.execute("@+ = fft_re(@0); @+ = fft_im(@0)")
+        re = self.ftk.get_data(1)
+        self.assertEqual(len(re), len(self.x))
+        # the point at frequency 0 is the sum of y
+        zero = [p.y for p in re if p.x == 0]
+        self.assertAlmostEqual(zero[0], sum(self.y), places=10)
+        self.ftk.execute("@+ = ifft_re(@1, @2)")
+        yy = [p.y for p in self.ftk.get_data(3)]
+        for a, b in zip(yy, self.y):
+            self.assertAlmostEqual(a, b, places=10)
+
+    def test_lowpass(self):
+        # the cut-off above the highest frequency changes nothing
+        self.ftk.execute("@0 = lowpass(@0, 10)")
+        xx, yy, ss = get_data_as_lists(self.ftk)
+        for a, b in zip(yy, self.y):
+            self.assertAlmostEqual(a, b, places=10)
+
+    def test_all_datasets(self):
+        self.ftk.execute("@+ = @0; @+ = @0")
+        self.ftk.execute("@1: Y = 2*y")
+        self.ftk.execute("@*: Y = y - max(y), S = 2")
+        self.ftk.execute("@*: delete(x > 3)")
+        for n, factor in enumerate([1, 2, 1]):
+            data = self.ftk.get_data(n)
+            ymax = factor * max(self.y)
+            expected = [(x, factor*y - ymax)
+                        for x, y in zip(self.x, self.y) if x <= 3]
+            self.assertEqual([(p.x, p.y) for p in data], expected)
+            self.assertEqual(set(p.sigma for p in data), set([2]))
+
+    def test_all_datasets_error(self):
+        # F[0] exists only in @0, so the command fails for @1,
+        # and as in sequential execution @0 is changed and @2 is not
+        self.ftk.execute("@+ = @0; @+ = @0")
+        self.ftk.execute("@0 @1: F = Constant(a=1)")
+        self.ftk.execute("@1: F = 0")
+        self.assertRaises(fityk.ExecuteError, self.ftk.execute,
+                          "@*: Y = y + F[0].a")
+        yy = [p.y for p in self.ftk.get_data(0)]
+        self.assertEqual(yy, [y + 1 for y in self.y])
+        for n in (1, 2):
+            yy = [p.y for p in self.ftk.get_data(n)]
+            self.assertEqual(yy, self.y)
+
     def test_xy_swap(self):
         self.ftk.execute("X=y, Y=x") # swap & sort!
         xx, yy, ss = get_data_as_lists(self.ftk)
@@ -91,6 +146,20 @@ class TestTransform(unittest.TestCase):
         self.assertEqual(yy, [xymap[x] for x in xx])
         self.assertEqual(ss, self.sigma)
 
+    def test_old_values(self):
+        # lowercase letters refer to values before the transformation
+        self.ftk.execute("Y = y[n-1] + y[n+1], S = Y - y")
+        xx, yy, ss = get_data_as_lists(self.ftk)
+        M = len(self.y)
+        expected = [self.y[max(n-1, 0)] + self.y[min(n+1, M-1)]
+                    for n in range(M)]
+        self.assertEqual(yy, expected)
+        self.assertEqual(ss, [e - y for e, y in zip(expected, self.y)])
+        self.ftk.execute("delete(y < y[n-1])")
+        xx, yy, ss = get_data_as_lists(self.ftk)
+        self.assertEqual(yy, [y for n, y in enumerate(expected)
+                              if n == 0 or y >= expected[n-1]])
+
 
 class TestFuncProperties(unittest.TestCase):
     def setUp(self):
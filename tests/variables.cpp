@@ -0,0 +1,83 @@
+
+#include <math.h>
+#include <boost/scoped_ptr.hpp>
+#include "fityk/fityk.h"
+#include "fityk/common.h" // S()
+
+#include "catch.hpp"
+
+using namespace std;
+using namespace fityk;
+
+static realt expr(Fityk* ftk, const string& s)
+{
+    return ftk->calculate_expr(s);
+}
+
+TEST_CASE("sort-variables", "functions use variables moved by sorting") {
+    boost::scoped_ptr<Fityk> ftk(new Fityk);
+    ftk->set_option_as_number("verbosity", -1);
+    ftk->execute("$p = ~1");
+    ftk->execute("$r = ~2");
+    ftk->execute("%z = Gaussian($p, $r, $p*$r)");
+    // $r now depends on a newer variable, variables are re-sorted;
+    // %z used to keep stale indices and its auto-variable was deleted
+    REQUIRE_NOTHROW(ftk->execute("$r = ~3 * $p"));
+    REQUIRE(expr(ftk.get(), "%z(3)") == Approx(1.));
+    REQUIRE(expr(ftk.get(), "%z.hwhm") == Approx(3.));
+
+    ftk->execute("$p = ~2");
+    // height 2, center 6, hwhm 12
+    REQUIRE(expr(ftk.get(), "%z(3)") == Approx(2 * exp(-M_LN2 / 16)));
+    REQUIRE_THROWS_AS(ftk->execute("$p = $r"), ExecuteError);
+    REQUIRE(expr(ftk.get(), "%z.center") == Approx(6.));
+}
+
+TEST_CASE("many-variables", "redefining, copying and deleting variables") {
+    boost::scoped_ptr<Fityk> ftk(new Fityk);
+    ftk->set_option_as_number("verbosity", -1);
+    const int n = 200;
+    for (int i = 0; i < n; ++i) {
+        ftk->execute("$w" + S(i) + " = ~" + S(i));
+        ftk->execute("%f" + S(i) + " = Gaussian(~1, $w" + S(i) + ", ~1)");
+    }
+    REQUIRE(ftk->all_variables().size() == 3 * n);
+    REQUIRE(ftk->all_functions().size() == n);
+
+    // each $w depends on a newer variable
+    for (int i = 0; i < n; ++i) {
+        ftk->execute("$v" + S(i) + " = ~2");
+        ftk->execute("$w" + S(i) + " = $v" + S(i) + " * " + S(i));
+    }
+    for (int i = 0; i < n; ++i)
+        REQUIRE(expr(ftk.get(), "%f" + S(i) + ".center") == Approx(2. * i));
+    ftk->execute("$v7 = ~0.5");
+    REQUIRE(expr(ftk.get(), "%f7.center") == Approx(3.5));
+    REQUIRE_THROWS_AS(ftk->execute("delete $v9"), ExecuteError);
+
+    // functions are renamed by copying and deleting the original
+    for (int i = 0; i < n; i += 2) {
+        ftk->execute("%g" + S(i) + " = copy(%f" + S(i) + ")");
+        ftk->execute("delete %f" + S(i));
+    }
+    REQUIRE(ftk->all_functions().size() == n);
+    REQUIRE_THROWS_AS(expr(ftk.get(), "%f0.center"), ExecuteError);
+    REQUIRE(expr(ftk.get(), "%g10.center") == Approx(20.));
+    REQUIRE(expr(ftk.get(), "%f11.center") == Approx(22.));
+    ftk->execute("%g10.height = ~4");
+    REQUIRE(expr(ftk.get(), "%g10.height") == Approx(4.));
+
+    ftk->execute("delete %f*");
+    REQUIRE(ftk->all_functions().size() == n / 2);
+    REQUIRE(expr(ftk.get(), "%g12(24)") == Approx(1.));
+    ftk->execute("delete %*");
+    ftk->execute("delete $*");
+    REQUIRE(ftk->all_functions().empty());
+    REQUIRE(ftk->all_variables().empty());
+    REQUIRE(ftk->all_parameters().empty());
+
+    // names can be reused
+    ftk->execute("$w3 = ~5");
+    ftk->execute("%f3 = Gaussian(~1, $w3, ~1)");
+    REQUIRE(expr(ftk.get(), "%f3.center") == Approx(5.));
+}
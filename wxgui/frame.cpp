@@ -1450,9 +1450,10 @@ void FFrame::OnNewLuaScript(wxCommandEvent&)
 void FFrame::OnNewHistoryScript(wxCommandEvent&)
 {
     wxString history = fityk::fityk_version_line + wxString("\n");
-    v_foreach(UserInterface::Cmd, c, ftk->ui()->cmds()) {
+    const std::deque<UserInterface::Cmd>& cmds = ftk->ui()->cmds();
+    for (std::deque<UserInterface::Cmd>::const_iterator c = cmds.begin();
+                                                    c != cmds.end(); ++c)
         history += s2wx(c->str()) + "\n";
-    }
     show_editor("", history);
 }
 
@@ -42,10 +42,12 @@ BEGIN_EVENT_TABLE(ListWithColors, wxListView)
 END_EVENT_TABLE()
 
 ListWithColors::ListWithColors(wxWindow *parent, wxWindowID id,
-                               vector<pair<string,int> > const& columns_)
+                               vector<pair<string,int> > const& columns_,
+                               ListRowSource* row_source)
     : wxListView(parent, id, wxDefaultPosition, wxDefaultSize,
-                 wxLC_REPORT|wxLC_HRULES|wxLC_VRULES),
-      columns(columns_), sidebar(0)
+                 wxLC_REPORT|wxLC_HRULES|wxLC_VRULES
+                 | (row_source ? wxLC_VIRTUAL : 0)),
+      columns(columns_), row_source_(row_source), sidebar(0)
 {
     for (size_t i = 0; i < columns.size(); ++i)
         if (columns[i].second != 0)
@@ -87,6 +89,54 @@ void ListWithColors::populate(vector<string> const& data,
     Thaw();
 }
 
+void ListWithColors::update_rows(long count, vector<long> const& changed,
+                                 wxImageList* image_list, int active)
+{
+    assert(row_source_ != NULL);
+    row_valid_.resize(count, false);
+    list_data.resize(count * columns.size());
+    v_foreach (long, i, changed)
+        row_valid_[*i] = false;
+    if (image_list)
+        AssignImageList(image_list, wxIMAGE_LIST_SMALL);
+    if (GetItemCount() != count || image_list) {
+        SetItemCount(count);
+        Refresh();
+    } else if (!changed.empty())
+        // only the visible part of the range is redrawn
+        RefreshItems(changed.front(), changed.back());
+    if (active >= 0 && active < count)
+        Focus(active);
+}
+
+wxString ListWithColors::OnGetItemText(long item, long column) const
+{
+    if (row_source_ == NULL || item >= (long) row_valid_.size())
+        return wxEmptyString;
+    string* cells = &list_data[item * columns.size()];
+    if (!row_valid_[item]) {
+        row_source_->get_row(item, cells);
+        row_valid_[item] = true;
+    }
+    return s2wx(cells[data_column(column)]);
+}
+
+int ListWithColors::OnGetItemImage(long item) const
+{
+    if (row_source_ == NULL || item >= (long) row_valid_.size())
+        return -1;
+    return row_source_->get_image(item);
+}
+
+// returns index in columns of the col-th visible column
+int ListWithColors::data_column(long col) const
+{
+    for (size_t i = 0; i < columns.size(); ++i)
+        if (columns[i].second != 0 && col-- == 0)
+            return i;
+    return 0;
+}
+
 void ListWithColors::OnColumnMenu(wxListEvent&)
 {
     wxMenu popup_menu;
@@ -119,8 +169,9 @@ void ListWithColors::OnShowColumn(wxCommandEvent &event)
     bool show = event.IsChecked();
     if (show) {
         InsertColumn(col, s2wx(columns[n].first));
-        for (int i = 0; i < GetItemCount(); ++i)
-            SetItem(i, col, s2wx(list_data[i*columns.size()+n]));
+        if (row_source_ == NULL)
+            for (int i = 0; i < GetItemCount(); ++i)
+                SetItem(i, col, s2wx(list_data[i*columns.size()+n]));
     } else
         DeleteColumn(col);
     columns[n].second = show;
@@ -160,10 +211,11 @@ BEGIN_EVENT_TABLE(ListPlusText, ProportionalSplitter)
 END_EVENT_TABLE()
 
 ListPlusText::ListPlusText(wxWindow *parent, wxWindowID id, wxWindowID list_id,
-                           vector<pair<string,int> > const& columns_)
+                           vector<pair<string,int> > const& columns_,
+                           ListRowSource* row_source)
 : ProportionalSplitter(parent, id, 0.75)
 {
-    list = new ListWithColors(this, list_id, columns_);
+    list = new ListWithColors(this, list_id, columns_, row_source);
     inf = new wxTextCtrl(this, -1, wxT(""), wxDefaultPosition, wxDefaultSize,
                          wxTE_RICH|wxTE_READONLY|wxTE_MULTILINE);
 }
@@ -15,14 +15,38 @@
 
 class SideBar;
 
+/// Calculates rows of ListWithColors in virtual mode (wxLC_VIRTUAL).
+/// Rows are calculated only when they are shown, and cached by the list
+/// until update_rows() marks them as changed.
+class ListRowSource
+{
+public:
+    virtual ~ListRowSource() {}
+    /// sets cells[0..ncol-1] of row n (also cells of hidden columns)
+    virtual void get_row(long n, std::string* cells) const = 0;
+    /// index of the row's icon in the image list, -1 if none
+    virtual int get_image(long n) const = 0;
+};
+
 class ListWithColors : public wxListView
 {
 public:
+    /// if row_source is given, the list is virtual and takes ownership
+    /// of row_source
     ListWithColors(wxWindow *parent, wxWindowID id,
-                   std::vector<std::pair<std::string,int> > const& columns_);
+                   std::vector<std::pair<std::string,int> > const& columns_,
+                   ListRowSource* row_source = NULL);
+    ~ListWithColors() { delete row_source_; }
     void populate(std::vector<std::string> const& data,
                   wxImageList* image_list = 0,
                   int active = -2);
+    /// used in virtual mode instead of populate(); changed are sorted
+    /// indices of rows that must be calculated again
+    void update_rows(long count, std::vector<long> const& changed,
+                     wxImageList* image_list = 0,
+                     int active = -2);
+    virtual wxString OnGetItemText(long item, long column) const;
+    virtual int OnGetItemImage(long item) const;
     void OnColumnMenu(wxListEvent &event);
     void OnRightDown(wxMouseEvent &event);
     void OnShowColumn(wxCommandEvent &event);
@@ -33,8 +57,13 @@ public:
     DECLARE_EVENT_TABLE()
 private:
     std::vector<std::pair<std::string,int> > columns;
-    std::vector<std::string> list_data;
+    // in virtual mode it is a cache, valid only in rows with row_valid_ set
+    mutable std::vector<std::string> list_data;
+    mutable std::vector<bool> row_valid_;
+    ListRowSource* row_source_;
     SideBar *sidebar;
+
+    int data_column(long col) const;
 };
 
 class ListPlusText : public ProportionalSplitter
@@ -44,7 +73,8 @@ public:
     wxTextCtrl* inf;
 
     ListPlusText(wxWindow *parent, wxWindowID id, wxWindowID list_id,
-                 std::vector<std::pair<std::string,int> > const& columns_);
+                 std::vector<std::pair<std::string,int> > const& columns_,
+                 ListRowSource* row_source = NULL);
 
     void OnSwitchInfo(wxCommandEvent &event);
     void split(double prop) { SplitHorizProp(list, inf, prop); }
@@ -462,9 +462,14 @@ void MainPlot::draw_peaks(wxDC& dc, const Model* model, bool set_pen)
         xx[i] = xs.val(i);
         xx[i] += model->zero_shift(xx[i]);
     }
-    for (int k = 0; k < (int) idx.size(); k++) {
+    // only functions that are not negligible in the visible range
+    if (n == 0)
+        return;
+    vector<int> visible = model->get_ff_in_range(min(xx[0], xx[n-1]),
+                                                 max(xx[0], xx[n-1]));
+    v_foreach (int, k, visible) {
         fill(yy.begin(), yy.end(), 0.);
-        const Function* f = ftk->mgr.get_function(idx[k]);
+        const Function* f = ftk->mgr.get_function(idx[*k]);
         int from=0, to=n-1;
         realt left, right;
         if (f->get_nonzero_range(level, left, right)) {
@@ -472,7 +477,7 @@ void MainPlot::draw_peaks(wxDC& dc, const Model* model, bool set_pen)
             to = min(to, xs.px(right));
         }
         if (set_pen)
-            dc.SetPen(wxPen(peakCol[k % max_peak_cols], pen_width));
+            dc.SetPen(wxPen(peakCol[*k % max_peak_cols], pen_width));
         f->calculate_value(xx, yy);
         for (int i = from; i <= to; ++i)
             YY[i] = ys.px_d(yy[i]);
@@ -72,6 +72,160 @@ enum {
     ID_VP_EDIT
 };
 
+//===============================================================
+//                 rows of function and variable lists
+//===============================================================
+
+// Rows are compared with the state from the previous update and only
+// changed rows are calculated again (and only when they are shown).
+class FuncListRows : public ListRowSource
+{
+public:
+    int image_colors; // number of function colors in the image list
+
+    FuncListRows() : image_colors(-1) {}
+    void update(Model const* model, vector<long>& changed);
+    virtual void get_row(long n, string* cells) const;
+    virtual int get_image(long n) const;
+
+private:
+    struct Row
+    {
+        // a new function can be allocated at the address of a deleted one,
+        // so the pointer alone doesn't identify the function
+        const Function* func;
+        const Tplate* tp;
+        string name;
+        vector<realt> av;
+        int color_id; // index in @n.F, -1 if in @n.Z, -2 if not in model
+
+        Row() : func(NULL), tp(NULL), color_id(-3) {}
+    };
+    vector<Row> rows_;
+};
+
+void FuncListRows::update(Model const* model, vector<long>& changed)
+{
+    vector<Function*> const& functions = ftk->mgr.functions();
+    vector<int> color_ids(functions.size(), -2);
+    vector<int> const& ffi = model->get_ff().idx;
+    vector<int> const& zzi = model->get_zz().idx;
+    for (int i = size(zzi) - 1; i >= 0; --i)
+        color_ids[zzi[i]] = -1;
+    for (int i = size(ffi) - 1; i >= 0; --i)
+        color_ids[ffi[i]] = i;
+
+    rows_.resize(functions.size());
+    for (int i = 0; i < size(functions); ++i) {
+        const Function* fun = functions[i];
+        Row& row = rows_[i];
+        if (row.func != fun || row.tp != fun->tp().get()
+                || row.name != fun->name || row.av != fun->av()
+                || row.color_id != color_ids[i]) {
+            row.func = fun;
+            row.tp = fun->tp().get();
+            row.name = fun->name;
+            row.av = fun->av();
+            row.color_id = color_ids[i];
+            changed.push_back(i);
+        }
+    }
+}
+
+void FuncListRows::get_row(long n, string* cells) const
+{
+    if (n >= size(ftk->mgr.functions()))
+        return;
+    Function const* fun = ftk->mgr.get_function(n);
+    cells[0] = fun->name;
+    cells[1] = fun->tp()->name;
+    realt a;
+    cells[2] = fun->get_center(&a) ? S(a) : S("-");
+    cells[3] = fun->get_area(&a)   ? S(a) : S("-");
+    cells[4] = fun->get_height(&a) ? S(a) : S("-");
+    cells[5] = fun->get_fwhm(&a)   ? S(a) : S("-");
+}
+
+// the image list is: unused, zshift, colors of functions in @n.F
+int FuncListRows::get_image(long n) const
+{
+    if (n >= size(rows_))
+        return -1;
+    return rows_[n].color_id + 2;
+}
+
+
+class VarListRows : public ListRowSource
+{
+public:
+    void update(vector<long>& changed);
+    virtual void get_row(long n, string* cells) const;
+    virtual int get_image(long) const { return -1; }
+
+private:
+    struct Row
+    {
+        const Variable* var;
+        string name;
+        realt value;
+        int gpos;
+        int used; // number of variables used in the formula
+        int frefs, vrefs; // references from functions and variables
+
+        Row() : var(NULL), value(0.), gpos(-3), used(-1),
+                frefs(-1), vrefs(-1) {}
+    };
+    vector<Row> rows_;
+};
+
+void VarListRows::update(vector<long>& changed)
+{
+    //  count references first
+    vector<Variable*> const& variables = ftk->mgr.variables();
+    vector<int> var_vrefs(variables.size(), 0), var_frefs(variables.size(), 0);
+    v_foreach (Variable*, i, variables) {
+        for (int j = 0; j != (*i)->used_vars().get_count(); ++j)
+            var_vrefs[(*i)->used_vars().get_idx(j)]++;
+    }
+    v_foreach (Function*, i, ftk->mgr.functions()) {
+        for (int j = 0; j != (*i)->used_vars().get_count(); ++j)
+            var_frefs[(*i)->used_vars().get_idx(j)]++;
+    }
+
+    rows_.resize(variables.size());
+    for (int i = 0; i < size(variables); ++i) {
+        const Variable* var = variables[i];
+        Row& row = rows_[i];
+        if (row.var != var || row.name != var->name
+                || row.value != var->value() || row.gpos != var->gpos()
+                || row.used != var->used_vars().get_count()
+                || row.frefs != var_frefs[i] || row.vrefs != var_vrefs[i]) {
+            row.var = var;
+            row.name = var->name;
+            row.value = var->value();
+            row.gpos = var->gpos();
+            row.used = var->used_vars().get_count();
+            row.frefs = var_frefs[i];
+            row.vrefs = var_vrefs[i];
+            changed.push_back(i);
+        }
+    }
+}
+
+void VarListRows::get_row(long n, string* cells) const
+{
+    if (n >= size(rows_) || n >= size(ftk->mgr.variables()))
+        return;
+    const Row& row = rows_[n];
+    const Variable* var = ftk->mgr.get_variable(n);
+    cells[0] = var->name;
+    cells[1] = S(row.frefs) + "+" + S(row.vrefs) + " / "
+               + S(var->used_vars().get_count());
+    cells[2] = S(var->value());
+    cells[3] = var->get_formula(ftk->mgr.parameters());
+}
+
+
 //===============================================================
 //                           SideBar
 //===============================================================
@@ -226,7 +380,8 @@ SideBar::SideBar(wxWindow *parent, wxWindowID id)
     fdata.push_back( pair<string,int>("Area", 0) );
     fdata.push_back( pair<string,int>("Height", 0) );
     fdata.push_back( pair<string,int>("FWHM", 0) );
-    f = new ListPlusText(func_page, -1, ID_FP_LIST, fdata);
+    func_rows_ = new FuncListRows;
+    f = new ListPlusText(func_page, -1, ID_FP_LIST, fdata, func_rows_);
     f->list->set_side_bar(this);
     func_sizer->Add(f, 1, wxEXPAND|wxALL, 1);
     wxBoxSizer *func_buttons_sizer = new wxBoxSizer(wxHORIZONTAL);
@@ -259,7 +414,8 @@ SideBar::SideBar(wxWindow *parent, wxWindowID id)
                                      pair<string,int>("#/#", 72),
                                      pair<string,int>("value", 70),
                                      pair<string,int>("formula", 0) );
-    v = new ListPlusText(var_page, -1, ID_VP_LIST, vdata);
+    var_rows_ = new VarListRows;
+    v = new ListPlusText(var_page, -1, ID_VP_LIST, vdata, var_rows_);
     v->list->set_side_bar(this);
     var_sizer->Add(v, 1, wxEXPAND|wxALL, 1);
     wxBoxSizer *var_buttons_sizer = new wxBoxSizer(wxHORIZONTAL);
@@ -526,12 +682,8 @@ void SideBar::update_func_list(bool nondata_changed)
     MainPlot const* mplot = frame->get_main_plot();
     wxColour const& bg_col = mplot->get_bg_color();
 
-    //functions
-    static vector<int> func_col_id;
-    static int old_func_size;
-    vector<string> func_data;
-    vector<int> new_func_col_id;
     Model const* model = ftk->dk.get_model(frame->get_focused_data_index());
+    int old_func_size = f->list->GetItemCount();
     int func_size = ftk->mgr.functions().size();
     if (active_function_ == -1)
         active_function_ = func_size - 1;
@@ -547,73 +699,31 @@ void SideBar::update_func_list(bool nondata_changed)
     else
         active_function_name_ = "";
 
-    int pos = -1;
-    for (int i = 0; i < func_size; ++i) {
-        if (i == active_function_)
-            pos = new_func_col_id.size();
-        Function const* fun = ftk->mgr.get_function(i);
-        func_data.push_back(fun->name);
-        func_data.push_back(fun->tp()->name);
-        realt a;
-        func_data.push_back(fun->get_center(&a) ? S(a) : S("-"));
-        func_data.push_back(fun->get_area(&a)   ? S(a) : S("-"));
-        func_data.push_back(fun->get_height(&a) ? S(a) : S("-"));
-        func_data.push_back(fun->get_fwhm(&a)   ? S(a) : S("-"));
-        vector<int> const& ffi = model->get_ff().idx;
-        vector<int> const& zzi = model->get_zz().idx;
-        vector<int>::const_iterator in_ff = find(ffi.begin(), ffi.end(), i);
-        int color_id = -2;
-        if (in_ff != ffi.end())
-            color_id = in_ff - ffi.begin();
-        else if (find(zzi.begin(), zzi.end(), i) != zzi.end())
-            color_id = -1;
-        new_func_col_id.push_back(color_id);
-    }
+    vector<long> changed;
+    func_rows_->update(model, changed);
+
+    // images are shared by rows with the same color
     wxImageList* func_images = 0;
-    if (nondata_changed || func_col_id != new_func_col_id) {
-        func_col_id = new_func_col_id;
+    int ff_size = model->get_ff().idx.size();
+    if (nondata_changed || ff_size > func_rows_->image_colors) {
         func_images = new wxImageList(16, 16);
-        v_foreach (int, i, func_col_id) {
-            if (*i == -2)
-                func_images->Add(wxBitmap(unused_xpm));
-            else if (*i == -1)
-                func_images->Add(wxBitmap(zshift_xpm));
-            else
-                func_images->Add(make_color_bitmap16(mplot->get_func_color(*i),
-                                                     bg_col));
-        }
+        func_images->Add(wxBitmap(unused_xpm));
+        func_images->Add(wxBitmap(zshift_xpm));
+        for (int i = 0; i < ff_size; ++i)
+            func_images->Add(make_color_bitmap16(mplot->get_func_color(i),
+                                                 bg_col));
+        func_rows_->image_colors = ff_size;
     }
-    old_func_size = func_size;
     skipOnFuncFocusChanged_ = true;
-    f->list->populate(func_data, func_images, pos);
+    f->list->update_rows(func_size, changed, func_images, active_function_);
     skipOnFuncFocusChanged_ = false;
 }
 
 void SideBar::update_var_list()
 {
-    vector<string> var_data;
-    //  count references first
-    vector<Variable*> const& variables = ftk->mgr.variables();
-    vector<int> var_vrefs(variables.size(), 0), var_frefs(variables.size(), 0);
-    v_foreach (Variable*, i, variables) {
-        for (int j = 0; j != (*i)->used_vars().get_count(); ++j)
-            var_vrefs[(*i)->used_vars().get_idx(j)]++;
-    }
-    v_foreach (Function*, i, ftk->mgr.functions()) {
-        for (int j = 0; j != (*i)->used_vars().get_count(); ++j)
-            var_frefs[(*i)->used_vars().get_idx(j)]++;
-    }
-
-    for (int i = 0; i < size(variables); ++i) {
-        const Variable* var = variables[i];
-        var_data.push_back(var->name);           //name
-        string refs = S(var_frefs[i]) + "+" + S(var_vrefs[i]) + " / "
-                      + S(var->used_vars().get_count());
-        var_data.push_back(refs); //refs
-        var_data.push_back(S(var->value())); //value
-        var_data.push_back(var->get_formula(ftk->mgr.parameters()));  //formula
-    }
-    v->list->populate(var_data);
+    vector<long> changed;
+    var_rows_->update(changed);
+    v->list->update_rows(ftk->mgr.variables().size(), changed);
 }
 
 int SideBar::get_focused_data() const
@@ -722,8 +832,12 @@ void SideBar::activate_function(int n)
         skipOnFuncFocusChanged_ = true;
         f->list->Focus(n);
         skipOnFuncFocusChanged_ = false;
-        for (int i = 0; i != f->list->GetItemCount(); ++i)
-            f->list->Select(i, i == n);
+        for (int i = f->list->GetFirstSelected(); i != -1;
+                                            i = f->list->GetNextSelected(i))
+            if (i != n)
+                f->list->Select(i, false);
+        if (n >= 0)
+            f->list->Select(n, true);
     }
 }
 
@@ -924,7 +1038,7 @@ vector<string> SideBar::get_selected_func() const
     vector<string> dd;
     for (int i = f->list->GetFirstSelected(); i != -1;
                                             i = f->list->GetNextSelected(i))
-        dd.push_back(wx2s(f->list->GetItemText(i)));
+        dd.push_back(ftk->mgr.get_function(i)->name);
     //if (dd.empty() && f->list->GetItemCount() > 0) {
     //    int n = f->list->GetFocusedItem();
     //    dd.push_back(ftk->mgr.get_function(n == -1 ? 0 : n)->xname);
@@ -949,10 +1063,8 @@ void SideBar::OnFuncFocusChanged(wxListEvent&)
     int n = f->list->GetFocusedItem();
     if (n == -1)
         active_function_ = -1;
-    else {
-        string name = wx2s(f->list->GetItemText(n));
-        active_function_ = ftk->mgr.find_function_nr(name);
-    }
+    else
+        active_function_ = n < size(ftk->mgr.functions()) ? n : -1;
     do_activate_function();
 }
 
@@ -988,14 +1100,15 @@ void SideBar::on_parameter_lock_clicked(int n, int state)
         exec(vname + " = {" + vname + "}");
     else { // state == 2
         nb->SetSelection(2); // "variables" page
-        wxString vname_no_prefix = s2wx(vname.substr(1));
-        for (int i = 0; i != v->list->GetItemCount(); ++i) {
-            if (v->list->GetItemText(i) == vname_no_prefix) {
-                v->list->Select(i, true);
-                v->list->EnsureVisible(i);
-                v->list->Focus(i);
-            } else
+        int k = ftk->mgr.find_variable_nr(vname.substr(1));
+        for (int i = v->list->GetFirstSelected(); i != -1;
+                                            i = v->list->GetNextSelected(i))
+            if (i != k)
                 v->list->Select(i, false);
+        if (k >= 0 && k < v->list->GetItemCount()) {
+            v->list->Select(k, true);
+            v->list->EnsureVisible(k);
+            v->list->Focus(k);
         }
     }
 }
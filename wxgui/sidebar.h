@@ -18,6 +18,8 @@ class GradientDlg;
 class FancyRealCtrl;
 class ListPlusText;
 class DataListPlusText;
+class FuncListRows;
+class VarListRows;
 namespace fityk { class Function; }
 
 class SideBar : public ProportionalSplitter, public ParameterPanelObserver
@@ -97,6 +99,8 @@ private:
     ParameterPanel *param_panel_;
     DataListPlusText *d;
     ListPlusText *f, *v;
+    FuncListRows *func_rows_; // owned by f->list
+    VarListRows *var_rows_; // owned by v->list
     wxChoice *data_look;
     wxSpinCtrl *shiftup_sc, *dpsize_sc;
     wxCheckBox *dpline_cb, *dpsigma_cb;
@@ -39,6 +39,7 @@ private:
     void OnSystemFontCheckbox(wxCommandEvent& event);
     void OnFontChange(wxFontPickerEvent& event);
     void OnColor(wxColourPickerEvent& event);
+    void OnMaxLength(wxSpinEvent& event);
 };
 
 
@@ -99,7 +100,8 @@ END_EVENT_TABLE()
 
 OutputWin::OutputWin (wxWindow *parent, wxWindowID id)
     : wxTextCtrl(parent, id, wxT(""), wxDefaultPosition, wxDefaultSize,
-                 wxTE_MULTILINE|wxTE_RICH|wxNO_BORDER|wxTE_READONLY)
+                 wxTE_MULTILINE|wxTE_RICH|wxNO_BORDER|wxTE_READONLY),
+      max_length_(1048576)
 {}
 
 void OutputWin::add_initial_text()
@@ -126,6 +128,7 @@ void OutputWin::read_settings(wxConfigBase *cf)
         cfg_read_color(cf, wxT("warn"), wxColour(220, 50, 47));
 
     cf->SetPath(wxT("/OutputWin"));
+    max_length_ = cf->Read(wxT("maxLength"), 1048576L);
     wxFont font = cfg_read_font(cf, wxT("font"), wxNullFont);
     SetDefaultStyle(wxTextAttr(bg_color_, bg_color_, font));
     SetBackgroundColour(bg_color_);
@@ -143,15 +146,18 @@ void OutputWin::save_settings(wxConfigBase *cf) const
     cfg_write_color (cf, wxT("input"), text_color_[UserInterface::kInput]);
     cfg_write_color (cf, wxT("bg"), bg_color_);
     cf->SetPath(wxT("/OutputWin"));
+    cf->Write(wxT("maxLength"), max_length_);
     cfg_write_font (cf, wxT("font"), GetDefaultStyle().GetFont());
 }
 
 void OutputWin::append_text (UserInterface::Style style, const wxString& str)
 {
-    const int max_len = 1048576;
-    const int delta = 262144;
-    if (GetLastPosition() > max_len)
-        Remove(0, delta);
+    if (GetLastPosition() > max_length_) {
+        // remove the oldest quarter of the text, up to the end of line
+        long end = GetLastPosition() - max_length_ * 3 / 4;
+        int nl = GetRange(end, end + 1024).Find('\n');
+        Remove(0, nl == wxNOT_FOUND ? end : end + nl + 1);
+    }
 
     SetDefaultStyle (wxTextAttr (text_color_[style]));
     AppendText (str);
@@ -272,6 +278,11 @@ OutputWinConfDlg::OutputWinConfDlg(wxWindow* parent, wxWindowID id,
                                     ow_->text_color_[UserInterface::kWarning]);
     gsizer->Add(cp_warning_, cl);
 
+    gsizer->Add(new wxStaticText(this, -1, wxT("max. text size (kB)")), cr);
+    SpinCtrl *max_length_sc = new SpinCtrl(this, -1, ow_->max_length_ / 1024,
+                                           16, 1048576, 80);
+    gsizer->Add(max_length_sc, cl);
+
     hsizer->Add(gsizer, wxSizerFlags());
 
     preview_ = new wxTextCtrl(this, -1, wxT(""),
@@ -313,6 +324,8 @@ OutputWinConfDlg::OutputWinConfDlg(wxWindow* parent, wxWindowID id,
             (wxObjectEventFunction) &OutputWinConfDlg::OnColor);
     Connect(cp_warning_->GetId(), wxEVT_COMMAND_COLOURPICKER_CHANGED,
             (wxObjectEventFunction) &OutputWinConfDlg::OnColor);
+    Connect(max_length_sc->GetId(), wxEVT_COMMAND_SPINCTRL_UPDATED,
+            (wxObjectEventFunction) &OutputWinConfDlg::OnMaxLength);
 }
 
 void OutputWinConfDlg::OnSystemFontCheckbox(wxCommandEvent& event)
@@ -349,6 +362,11 @@ void OutputWinConfDlg::OnColor(wxColourPickerEvent& event)
     show_preview();
 }
 
+void OutputWinConfDlg::OnMaxLength(wxSpinEvent& event)
+{
+    ow_->max_length_ = event.GetPosition() * 1024L;
+}
+
 void OutputWinConfDlg::show_preview()
 {
     const wxColour& output = ow_->text_color_[UserInterface::kNormal];
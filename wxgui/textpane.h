@@ -23,6 +23,7 @@ private:
     wxColour text_color_[4];
     wxColour bg_color_;
     wxString selection_; // string passed to OnEditLine()
+    long max_length_; // the oldest text is removed when it gets longer
 
     void add_initial_text();
     void set_bg_color(wxColour const &color);